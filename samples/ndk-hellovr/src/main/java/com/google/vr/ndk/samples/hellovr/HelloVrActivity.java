@@ -99,7 +99,8 @@ public class HelloVrActivity extends Activity {
             getClass().getClassLoader(),
             this.getApplicationContext(),
             getAssets(),
-            gvrLayout.getGvrApi().getNativeGvrContext());
+            gvrLayout.getGvrApi().getNativeGvrContext(),
+            getCacheDir().getAbsolutePath());
 
     // Add the GLSurfaceView to the GvrLayout.
     surfaceView = new GLSurfaceView(this);
@@ -171,6 +172,16 @@ public class HelloVrActivity extends Activity {
     gvrLayout.onResume();
     surfaceView.onResume();
     surfaceView.queueEvent(resumeNativeRunnable);
+    // The GPU budget of a frame follows the display, which may run at 72 or
+    // 75 Hz rather than 60 Hz.
+    final float refreshRate = getWindowManager().getDefaultDisplay().getRefreshRate();
+    surfaceView.queueEvent(
+        new Runnable() {
+          @Override
+          public void run() {
+            nativeSetDisplayRefreshRate(nativeApp, refreshRate);
+          }
+        });
   }
 
   @Override
@@ -184,6 +195,19 @@ public class HelloVrActivity extends Activity {
     nativeApp = 0;
   }
 
+  @Override
+  public void onTrimMemory(final int level) {
+    super.onTrimMemory(level);
+    // The native app releases GL resources, so this runs on the GL thread.
+    surfaceView.queueEvent(
+        new Runnable() {
+          @Override
+          public void run() {
+            nativeOnTrimMemory(nativeApp, level);
+          }
+        });
+  }
+
   @Override
   public void onBackPressed() {
     super.onBackPressed();
@@ -224,7 +248,8 @@ public class HelloVrActivity extends Activity {
       ClassLoader appClassLoader,
       Context context,
       AssetManager assetManager,
-      long nativeGvrContext);
+      long nativeGvrContext,
+      String cacheDir);
 
   private native void nativeOnDestroy(long nativeApp);
 
@@ -237,4 +262,8 @@ public class HelloVrActivity extends Activity {
   private native void nativeOnPause(long nativeApp);
 
   private native void nativeOnResume(long nativeApp);
+
+  private native void nativeOnTrimMemory(long nativeApp, int level);
+
+  private native void nativeSetDisplayRefreshRate(long nativeApp, float refreshRate);
 }
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "audio_player.h"  // NOLINT
+
+#include <utility>
+
+#include "util.h"  // NOLINT
+
+namespace ndk_hello_vr {
+
+constexpr int AudioPlayer::kVoiceCount;
+
+AudioPlayer::AudioPlayer(gvr::AudioApi* audio_api,
+                         std::vector<const char*> sound_files)
+    : audio_api_(audio_api),
+      sound_files_(std::move(sound_files)),
+      has_head_view_(false),
+      stopping_(false),
+      looping_voice_count_(0),
+      next_once_voice_(0) {
+  for (gvr::AudioSourceId& source : sources_) {
+    source = gvr::kInvalidSourceId;
+  }
+  thread_ = std::thread(&AudioPlayer::WorkerLoop, this);
+}
+
+AudioPlayer::~AudioPlayer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+}
+
+int AudioPlayer::PlayLooping(const char* sound_file,
+                             const gvr::Vec3f& position) {
+  int voice;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (looping_voice_count_ == kVoiceCount) {
+      LOGE("No voice left for %s", sound_file);
+      return -1;
+    }
+    voice = looping_voice_count_++;
+  }
+  Post({Command::kPlayLooping, voice, sound_file, position});
+  return voice;
+}
+
+void AudioPlayer::PlayOnce(const char* sound_file) {
+  int voice;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int once_voice_count = kVoiceCount - looping_voice_count_;
+    if (once_voice_count == 0) {
+      LOGE("No voice left for %s", sound_file);
+      return;
+    }
+    voice = looping_voice_count_ + next_once_voice_ % once_voice_count;
+    next_once_voice_ = (next_once_voice_ + 1) % once_voice_count;
+  }
+  Post({Command::kPlayOnce, voice, sound_file, {0.0f, 0.0f, 0.0f}});
+}
+
+void AudioPlayer::SetPosition(int voice, const gvr::Vec3f& position) {
+  if (voice >= 0) {
+    Post({Command::kSetPosition, voice, nullptr, position});
+  }
+}
+
+void AudioPlayer::SetHeadPose(const gvr::Mat4f& head_view) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Only the latest pose matters, so it replaces one that wasn't used yet.
+    head_view_ = head_view;
+    has_head_view_ = true;
+  }
+  condition_.notify_one();
+}
+
+void AudioPlayer::Pause() {
+  Post({Command::kPause, -1, nullptr, {0.0f, 0.0f, 0.0f}});
+}
+
+void AudioPlayer::Resume() {
+  Post({Command::kResume, -1, nullptr, {0.0f, 0.0f, 0.0f}});
+}
+
+void AudioPlayer::Post(const Command& command) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(command);
+  }
+  condition_.notify_one();
+}
+
+void AudioPlayer::WorkerLoop() {
+  for (const char* sound_file : sound_files_) {
+    if (!audio_api_->PreloadSoundfile(sound_file)) {
+      LOGE("Could not preload %s", sound_file);
+    }
+  }
+
+  while (true) {
+    gvr::Mat4f head_view;
+    bool has_head_view;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] {
+        return stopping_ || has_head_view_ || !pending_.empty();
+      });
+      if (stopping_) {
+        break;
+      }
+      running_.swap(pending_);
+      head_view = head_view_;
+      has_head_view = has_head_view_;
+      has_head_view_ = false;
+    }
+
+    for (const Command& command : running_) {
+      Run(command);
+    }
+    running_.clear();
+    if (has_head_view) {
+      audio_api_->SetHeadPose(head_view);
+    }
+    audio_api_->Update();
+  }
+}
+
+void AudioPlayer::Run(const Command& command) {
+  gvr::AudioSourceId& source =
+      command.voice >= 0 ? sources_[command.voice] : sources_[0];
+  switch (command.type) {
+    case Command::kPlayLooping:
+    case Command::kPlayOnce: {
+      if (source != gvr::kInvalidSourceId &&
+          audio_api_->IsSourceIdValid(source)) {
+        audio_api_->StopSound(source);
+      }
+      const bool looping = command.type == Command::kPlayLooping;
+      source = looping ? audio_api_->CreateSoundObject(command.sound_file)
+                       : audio_api_->CreateStereoSound(command.sound_file);
+      if (source == gvr::kInvalidSourceId) {
+        LOGE("Could not create a source for %s", command.sound_file);
+        break;
+      }
+      if (looping) {
+        audio_api_->SetSoundObjectPosition(source, command.position.x,
+                                           command.position.y,
+                                           command.position.z);
+      }
+      audio_api_->PlaySound(source, looping);
+      break;
+    }
+    case Command::kSetPosition:
+      if (source != gvr::kInvalidSourceId) {
+        audio_api_->SetSoundObjectPosition(source, command.position.x,
+                                           command.position.y,
+                                           command.position.z);
+      }
+      break;
+    case Command::kPause:
+      audio_api_->Pause();
+      break;
+    case Command::kResume:
+      audio_api_->Resume();
+      break;
+  }
+}
+
+}  // namespace ndk_hello_vr
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_BENCHMARK_REPORT_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_BENCHMARK_REPORT_H_  // NOLINT
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame_profiler.h"  // NOLINT
+
+namespace ndk_hello_vr {
+
+// Collects the per-frame measurements of a benchmark run and summarizes them
+// as percentiles in one line of JSON, for scripts that compare runs.
+//
+// The report looks like
+//   {"frames":600,"cpu_frame_us":{"p50":2100,"p90":2800,"p99":4100,
+//    "max":6000},...,"draw_calls":{...},"gl_calls":{...},"cpu_kb":{...},
+//    "gpu_kb":{...}}
+// with one entry per CPU phase and GPU pass. GPU passes without results,
+// e.g. on drivers without timer queries, are left out.
+class BenchmarkReport {
+ public:
+  BenchmarkReport();
+
+  void Clear();
+
+  // Adds the timings of one frame. Frames whose GPU results are still
+  // pending should be added once FrameProfiler has filled them in.
+  void AddTimings(const FrameTimings& timings);
+
+  // Adds the number of draw calls and of GL state calls passed on by
+  // GlStateCache in one frame.
+  void AddCounts(size_t draw_calls, uint32_t gl_calls);
+
+  // Adds the CPU and GPU memory recorded by ResourceRegistry in one frame.
+  void AddMemory(size_t cpu_bytes, size_t gpu_bytes);
+
+  size_t GetFrameCount() const { return cpu_frame_us_.size(); }
+
+  std::string ToJson() const;
+
+  // Writes ToJson() to |path|.
+  bool Write(const std::string& path) const;
+
+ private:
+  // Appends "name":{"p50":...} for |values|, sorting them.
+  static void AppendPercentiles(const char* name, std::vector<int64_t> values,
+                                std::string* json);
+
+  std::vector<int64_t> cpu_frame_us_;
+  std::vector<int64_t> cpu_phase_us_[FrameTimings::kCpuPhaseCount];
+  std::vector<int64_t> gpu_pass_us_[FrameTimings::kMaxGpuPasses];
+  std::vector<int64_t> draw_calls_;
+  std::vector<int64_t> gl_calls_;
+  std::vector<int64_t> cpu_kb_;
+  std::vector<int64_t> gpu_kb_;
+};
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_BENCHMARK_REPORT_H_  // NOLINT
@@ -0,0 +1,282 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "draw_list.h"  // NOLINT
+
+#include <GLES3/gl3.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "gl_state_cache.h"     // NOLINT
+#include "resource_registry.h"  // NOLINT
+#include "simd_math.h"          // NOLINT
+#include "util.h"               // NOLINT
+
+namespace ndk_hello_vr {
+
+namespace {
+
+constexpr size_t kFloatsPerMatrix = 16;
+// The model matrix, followed by the texture layer.
+constexpr size_t kFloatsPerInstance = kFloatsPerMatrix + 1;
+
+// Transforms the bounding sphere of the mesh of |item| into world space. The
+// radius is scaled by the largest scale of the model matrix.
+void GetWorldBoundingSphere(const DrawItem& item, float world_center[3],
+                            float* radius) {
+  const gvr::Vec3f& center = item.mesh->GetBoundingSphereCenter();
+  const gvr::Mat4f& model = item.model;
+  float max_scale_squared = 0.0f;
+  for (int row = 0; row < 3; ++row) {
+    world_center[row] = model.m[row][0] * center.x +
+                        model.m[row][1] * center.y +
+                        model.m[row][2] * center.z + model.m[row][3];
+    const float column_length_squared = model.m[0][row] * model.m[0][row] +
+                                        model.m[1][row] * model.m[1][row] +
+                                        model.m[2][row] * model.m[2][row];
+    max_scale_squared = std::max(max_scale_squared, column_length_squared);
+  }
+  *radius =
+      item.mesh->GetBoundingSphereRadius() * std::sqrt(max_scale_squared);
+}
+
+// Computes the depth of |item| in front of the viewer, using the bounding
+// sphere of its mesh. Items whose sphere contains the viewer, such as the
+// room, enclose everything else, so they get the depth of their far side.
+float GetViewDepth(const DrawItem& item, const gvr::Mat4f& head_view) {
+  float world_center[3];
+  float radius;
+  GetWorldBoundingSphere(item, world_center, &radius);
+
+  float view_center[3];
+  for (int row = 0; row < 3; ++row) {
+    view_center[row] = head_view.m[row][0] * world_center[0] +
+                       head_view.m[row][1] * world_center[1] +
+                       head_view.m[row][2] * world_center[2] +
+                       head_view.m[row][3];
+  }
+  const float distance_squared = view_center[0] * view_center[0] +
+                                 view_center[1] * view_center[1] +
+                                 view_center[2] * view_center[2];
+  const float depth = -view_center[2];
+  return distance_squared < radius * radius ? depth + radius : depth;
+}
+
+// Returns true if |a| and |b| can be drawn by one instanced draw call.
+bool CanMerge(const DrawItem& a, const DrawItem& b) {
+  return a.set_uniforms == nullptr && b.set_uniforms == nullptr &&
+         a.program == b.program && a.texture == b.texture &&
+         a.mesh == b.mesh && a.blend_mode == b.blend_mode;
+}
+
+// Orders items by everything that prevents merging, then front to back.
+bool StateThenDepthLess(const DrawItem* a, float a_depth, const DrawItem* b,
+                        float b_depth) {
+  if (a->program != b->program) return a->program < b->program;
+  if (a->texture != b->texture) return a->texture < b->texture;
+  if (a->mesh != b->mesh) return a->mesh < b->mesh;
+  return a_depth < b_depth;
+}
+
+void SetBlendMode(BlendMode blend_mode) {
+  GlStateCache& gl_state = GetGlStateCache();
+  switch (blend_mode) {
+    case BlendMode::kOpaque:
+      gl_state.SetCapability(GL_BLEND, false);
+      break;
+    case BlendMode::kAlpha:
+      gl_state.SetCapability(GL_BLEND, true);
+      gl_state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      break;
+    case BlendMode::kPremultipliedAlpha:
+      gl_state.SetCapability(GL_BLEND, true);
+      gl_state.BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+      break;
+  }
+}
+
+}  // anonymous namespace
+
+DrawList::DrawList()
+    : use_instancing_(false), instance_buffer_(0), culled_item_count_(0) {}
+
+DrawList::~DrawList() {
+  if (instance_buffer_ != 0) {
+    glDeleteBuffers(1, &instance_buffer_);
+  }
+}
+
+void DrawList::Initialize(bool use_instancing) {
+  use_instancing_ = use_instancing;
+  // A new context has none of the old objects, so this does not delete them.
+  instance_buffer_ = 0;
+  if (use_instancing_) {
+    glGenBuffers(1, &instance_buffer_);
+  }
+}
+
+void DrawList::Clear() {
+  items_.clear();
+  culled_item_count_ = 0;
+}
+
+void DrawList::Add(const DrawItem& item) { items_.push_back(item); }
+
+void DrawList::Cull(const ViewFrustum& frustum) {
+  const auto invisible = [&frustum](const DrawItem& item) {
+    float center[3];
+    float radius;
+    GetWorldBoundingSphere(item, center, &radius);
+    return !frustum.IsSphereVisible({center[0], center[1], center[2]},
+                                    radius);
+  };
+  const auto end = std::remove_if(items_.begin(), items_.end(), invisible);
+  culled_item_count_ += items_.end() - end;
+  items_.erase(end, items_.end());
+}
+
+void DrawList::Prepare(const gvr::Mat4f& head_view) {
+  opaque_.clear();
+  blended_.clear();
+  batches_.clear();
+  instance_data_.clear();
+  ResourceRegistry& registry = GetResourceRegistry();
+  for (const DrawItem& item : items_) {
+    registry.MarkUsed(item.texture);
+    registry.MarkUsed(item.mesh);
+    // Evicted meshes are left out until their reload is uploaded.
+    if (!item.mesh->IsLoaded()) {
+      continue;
+    }
+    SortedItem sorted = {&item, GetViewDepth(item, head_view)};
+    if (item.blend_mode == BlendMode::kOpaque) {
+      opaque_.push_back(sorted);
+    } else {
+      blended_.push_back(sorted);
+    }
+  }
+
+  // Group mergeable opaque items, then order the groups front to back.
+  std::sort(opaque_.begin(), opaque_.end(),
+            [](const SortedItem& a, const SortedItem& b) {
+              return StateThenDepthLess(a.item, a.depth, b.item, b.depth);
+            });
+  AddBatches(opaque_);
+  std::stable_sort(
+      batches_.begin(), batches_.end(),
+      [](const Batch& a, const Batch& b) { return a.depth < b.depth; });
+
+  std::stable_sort(blended_.begin(), blended_.end(),
+                   [](const SortedItem& a, const SortedItem& b) {
+                     return a.depth > b.depth;
+                   });
+  AddBatches(blended_);
+
+  if (use_instancing_ && !instance_data_.empty()) {
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+    // Respecifying the whole buffer lets the driver hand out new storage
+    // instead of waiting for the previous frame's draws.
+    glBufferData(GL_ARRAY_BUFFER, instance_data_.size() * sizeof(float),
+                 instance_data_.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+}
+
+void DrawList::AddBatches(const std::vector<SortedItem>& sorted) {
+  for (const SortedItem& sorted_item : sorted) {
+    const DrawItem& item = *sorted_item.item;
+    if (use_instancing_ && !batches_.empty() &&
+        CanMerge(*batches_.back().first_item, item)) {
+      ++batches_.back().instance_count;
+    } else {
+      const Batch batch = {
+          &item,
+          static_cast<GLsizei>(instance_data_.size() / kFloatsPerInstance), 1,
+          sorted_item.depth};
+      batches_.push_back(batch);
+    }
+    const size_t offset = instance_data_.size();
+    instance_data_.resize(offset + kFloatsPerInstance);
+    TransposeMat4(&item.model.m[0][0], &instance_data_[offset]);
+    instance_data_[offset + kFloatsPerMatrix] =
+        static_cast<float>(item.texture_layer);
+  }
+}
+
+void DrawList::Draw(const float* view_projection, GLsizei view_count) const {
+  GlStateCache& gl_state = GetGlStateCache();
+  const DrawProgram* current_program = nullptr;
+  const TexturedMesh* current_mesh = nullptr;
+  for (const Batch& batch : batches_) {
+    const DrawItem& item = *batch.first_item;
+    if (item.program != current_program) {
+      gl_state.UseProgram(item.program->program);
+      if (view_projection != nullptr) {
+        glUniformMatrix4fv(item.program->view_projection_uniform, view_count,
+                           GL_FALSE, view_projection);
+      }
+      current_program = item.program;
+    }
+    SetBlendMode(item.blend_mode);
+    item.texture->Bind();
+    if (item.set_uniforms != nullptr) {
+      item.set_uniforms(item.uniform_data);
+    }
+
+    if (item.mesh != current_mesh || use_instancing_) {
+      item.mesh->Bind();
+      current_mesh = item.mesh;
+    }
+    if (use_instancing_) {
+      // The pointers are part of the mesh's vertex array object, so they are
+      // set again for every batch.
+      glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+      const size_t offset =
+          batch.first_instance * kFloatsPerInstance * sizeof(float);
+      const GLsizei stride = kFloatsPerInstance * sizeof(float);
+      for (GLuint column = 0; column < 4; ++column) {
+        const GLuint location = kModelMatrixAttribLocation + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(
+            location, 4, GL_FLOAT, GL_FALSE, stride,
+            reinterpret_cast<const void*>(offset + column * 4 * sizeof(float)));
+        glVertexAttribDivisor(location, 1);
+      }
+      glEnableVertexAttribArray(kTextureLayerAttribLocation);
+      glVertexAttribPointer(kTextureLayerAttribLocation, 1, GL_FLOAT, GL_FALSE,
+                            stride,
+                            reinterpret_cast<const void*>(
+                                offset + kFloatsPerMatrix * sizeof(float)));
+      glVertexAttribDivisor(kTextureLayerAttribLocation, 1);
+    } else {
+      const float* model =
+          &instance_data_[batch.first_instance * kFloatsPerInstance];
+      for (GLuint column = 0; column < 4; ++column) {
+        glVertexAttrib4fv(kModelMatrixAttribLocation + column,
+                          model + column * 4);
+      }
+    }
+    item.mesh->DrawBound(batch.instance_count);
+  }
+  if (current_mesh != nullptr) {
+    current_mesh->Unbind();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  CheckGLError("DrawList::Draw");
+}
+
+}  // namespace ndk_hello_vr
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_FRAME_PROFILER_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_FRAME_PROFILER_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ndk_hello_vr {
+
+// The parts of OnDrawFrame that are timed on the CPU. Audio is updated on the
+// simulation thread, so it is not a phase of the frame.
+enum class CpuPhase : int {
+  kPose,
+  kControllers,
+  kDrawWorld,
+  kSubmit,
+  kCount,
+};
+
+// Timings of one frame, in nanoseconds. Phases that did not run are 0, and
+// GPU passes whose result is not known (yet) are -1.
+struct FrameTimings {
+  static constexpr int kCpuPhaseCount = static_cast<int>(CpuPhase::kCount);
+  static constexpr int kMaxGpuPasses = 2;
+
+  int64_t frame_index;
+  int64_t cpu_frame_ns;
+  int64_t cpu_phase_ns[kCpuPhaseCount];
+  int64_t gpu_pass_ns[kMaxGpuPasses];
+};
+
+// Measures where each frame spends its time.
+//
+// CPU phases are timed with ScopedCpuTimer, and GPU passes with
+// GL_EXT_disjoint_timer_query when the context supports it. GPU results
+// arrive a few frames late and are filled into the frame they belong to.
+//
+// The timings of the last kHistorySize frames are kept in a ring buffer that
+// can be read from any thread without locking. When systrace is capturing,
+// the CPU phases also show up as ATrace sections and the frame totals as
+// counters.
+//
+// Apart from the readers, everything must be called on the GL thread.
+class FrameProfiler {
+ public:
+  static constexpr int kHistorySize = 64;
+  // The GPU timings of a frame are filled in this many frames after it
+  // completes, or never.
+  static constexpr int kGpuResultFrames = 4;
+
+  // Times a CPU phase of the current frame from construction to destruction.
+  // Phases that are timed more than once in a frame are summed.
+  class ScopedCpuTimer {
+   public:
+    ScopedCpuTimer(FrameProfiler* profiler, CpuPhase phase);
+    ~ScopedCpuTimer();
+
+   private:
+    FrameProfiler* profiler_;
+    CpuPhase phase_;
+    int64_t start_ns_;
+
+    ScopedCpuTimer(const ScopedCpuTimer&) = delete;
+    ScopedCpuTimer& operator=(const ScopedCpuTimer&) = delete;
+  };
+
+  FrameProfiler();
+  ~FrameProfiler();
+
+  // Creates the GPU queries if the context supports timer queries.
+  void InitializeGl();
+
+  void BeginFrame();
+  void EndFrame();
+
+  // Returns the index of the frame that is being recorded, or of the last one
+  // until the next BeginFrame().
+  int64_t GetFrameIndex() const { return current_.frame_index; }
+
+  // Times the GPU work of a render pass, e.g. of one Frame::BindBuffer().
+  // Passes cannot be nested.
+  void BeginGpuPass(int pass);
+  void EndGpuPass();
+
+  // Copies the timings of the frame |frames_ago| frames before the last
+  // completed one. Safe to call from any thread.
+  //
+  // @return false if that frame is not in the history.
+  bool GetTimings(int frames_ago, FrameTimings* timings) const;
+
+ private:
+  // The values of FrameTimings, flattened so that they can be atomics.
+  static constexpr int kValueCount = 2 + FrameTimings::kCpuPhaseCount +
+                                     FrameTimings::kMaxGpuPasses;
+
+  // A seqlock protects each slot: the sequence is odd while the slot is
+  // being written, and readers retry if it changed while they were copying.
+  struct Slot {
+    std::atomic<uint32_t> sequence;
+    std::atomic<int64_t> values[kValueCount];
+  };
+
+  // Timer queries are recycled after this many frames, which gives the GPU
+  // that long to finish a frame before its results are dropped.
+  static constexpr int kQueryFrames = kGpuResultFrames;
+
+  struct QuerySet {
+    GLuint queries[FrameTimings::kMaxGpuPasses];
+    bool used[FrameTimings::kMaxGpuPasses];
+    int64_t frame_index;
+  };
+
+  void WriteSlot(const FrameTimings& timings);
+  // Returns false if the slot of |frame_index| holds a different frame.
+  bool ReadSlot(int64_t frame_index, FrameTimings* timings) const;
+  void ReadBackGpuTimings(QuerySet* query_set);
+
+  Slot history_[kHistorySize];
+  std::atomic<int64_t> completed_frames_;
+
+  // State of the frame that is being recorded.
+  FrameTimings current_;
+  int64_t frame_start_ns_;
+  int active_gpu_pass_;
+
+  bool gpu_timing_supported_;
+  QuerySet query_sets_[kQueryFrames];
+  PFNGLGENQUERIESEXTPROC gen_queries_;
+  PFNGLDELETEQUERIESEXTPROC delete_queries_;
+  PFNGLBEGINQUERYEXTPROC begin_query_;
+  PFNGLENDQUERYEXTPROC end_query_;
+  PFNGLGETQUERYOBJECTUIVEXTPROC get_query_object_uiv_;
+  PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_object_ui64v_;
+
+  FrameProfiler(const FrameProfiler&) = delete;
+  FrameProfiler& operator=(const FrameProfiler&) = delete;
+};
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_FRAME_PROFILER_H_  // NOLINT
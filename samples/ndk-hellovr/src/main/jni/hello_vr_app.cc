@@ -20,9 +20,12 @@
 #include <android/log.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <chrono>  // NOLINT
 #include <cmath>
 
-#include "util.h"  // NOLINT
+#include "gl_state_cache.h"  // NOLINT
+#include "program_cache.h"   // NOLINT
+#include "util.h"            // NOLINT
 #include "vr/gvr/capi/include/gvr_types.h"
 #include "vr/gvr/capi/include/gvr_version.h"
 
@@ -51,33 +54,116 @@ static constexpr float kDefaultSafetyRingRadius = 1.0f;
 
 static constexpr int kCoordsPerVertex = 3;
 
-static constexpr uint64_t kPredictionTimeWithoutVsyncNanos = 50000000;
+// Upper bound on the texture data uploaded per frame while textures are still
+// loading, which keeps each upload well inside a frame.
+static constexpr size_t kTextureUploadBytesPerFrame = 4 * 1024 * 1024;
+
+// The GPU memory that meshes and textures may use before the least recently
+// drawn ones are evicted; see ResourceRegistry.
+static constexpr size_t kResourceBudgetBytes = 64 * 1024 * 1024;
+
+// Levels of ComponentCallbacks2.onTrimMemory(). From the first, the decoded
+// image cache is dropped; from the second, also everything that the current
+// frame does not draw.
+static constexpr int kTrimMemoryRunningModerate = 5;
+static constexpr int kTrimMemoryRunningLow = 10;
+
+// Refresh rate assumed until the activity reports the display's own.
+static constexpr float kDefaultRefreshRate = 60.0f;
 
 // Angle threshold for determining whether the controller is pointing at the
 // object.
 static constexpr float kAngleLimit = 0.2f;
 
+// The simulation runs at this rate, independently of the display.
+static constexpr int64_t kSimulationTickNanos = 1000000000 / 120;
+
 // Sound file in APK assets.
 static constexpr const char* kObjectSoundFile = "audio/HelloVR_Loop.ogg";
 static constexpr const char* kSuccessSoundFile = "audio/HelloVR_Activation.ogg";
 
 static constexpr int kTargetMeshCount = 3;
 
+// The textures of each target mesh, when it is not selected and when it is.
+// On OpenGL ES 3.0 the pair is packed into an array texture with these
+// layers, so that the selection state is a per-instance attribute.
+static constexpr int kNotSelectedLayer = 0;
+static constexpr int kSelectedLayer = 1;
+static constexpr const char* kTargetTextureFiles[kTargetMeshCount][2] = {
+    {"Icosahedron_Blue_BakedDiffuse.png",
+     "Icosahedron_Pink_BakedDiffuse.png"},
+    {"QuadSphere_Blue_BakedDiffuse.png", "QuadSphere_Pink_BakedDiffuse.png"},
+    {"TriSphere_Blue_BakedDiffuse.png", "TriSphere_Pink_BakedDiffuse.png"},
+};
+
+// Objects are culled against views that are this much wider than the eyes'
+// fields of view, in degrees, so that the newer pose from late latching does
+// not reveal culled objects at the edges.
+static constexpr float kCullingMarginDegrees = 5.0f;
+
+// Whether to render the middle of each eye into a separate buffer at the
+// recommended resolution, and the rest of the view at a lower resolution. The
+// lens distortion discards much of the detail in the periphery anyway, so this
+// saves fill rate that the render scale alone cannot.
+static constexpr bool kFoveatedRendering = false;
+// The width and height of the fovea, as a fraction of those of the whole
+// view in tangent space.
+static constexpr float kFoveaSize = 0.5f;
+// The resolution of the periphery, as a fraction of the recommended one in
+// each dimension.
+static constexpr float kPeripheryResolutionScale = 0.5f;
+
+// The swap chain holds the scene, the reticle and optionally the fovea.
+static constexpr int kReticleBufferIndex = 1;
+static constexpr int kFoveaBufferIndex = 2;
+// The first two viewports are for the scene, one for each eye. The fovea
+// comes next, and the reticle comes last so that it is composited on top.
+static constexpr int kFoveaViewportIndex = 2;
+static constexpr int kReticleViewportIndex = kFoveatedRendering ? 4 : 2;
+
+// Whether to draw a graph of the recent CPU and GPU frame times. The timings
+// are recorded, and sent to systrace when it is capturing, either way.
+static constexpr bool kShowProfilerOverlay = false;
+
+// Whether to read the head pose again right before submitting the frame, and
+// to patch it into the view matrices of the draws that have already been
+// issued. Needs multiview and GL_EXT_buffer_storage; see ViewUniforms.
+static constexpr bool kLateLatchHeadPose = true;
+
+// Benchmark runs, for comparing builds and devices with the same head motion.
+// kRecord appends the head pose of every frame to kPoseTraceFile in the cache
+// directory, saving it whenever the app pauses. kReplay plays that trace back
+// once, in place of head tracking, as soon as the meshes are loaded, and then
+// writes percentiles of the frame timings and counts to kBenchmarkReportFile
+// next to it. Controller input and GVR properties other than the floor height
+// baked into the poses are not replayed. kMicro instead times the math and
+// mesh parsing routines at startup and writes kMicroBenchmarkReportFile; see
+// RunMicroBenchmarks().
+enum class BenchmarkMode { kOff, kRecord, kReplay, kMicro };
+static constexpr BenchmarkMode kBenchmarkMode = BenchmarkMode::kOff;
+static constexpr const char* kPoseTraceFile = "pose_trace.bin";
+static constexpr const char* kBenchmarkReportFile = "benchmark.json";
+static constexpr const char* kMicroBenchmarkReportFile =
+    "micro_benchmarks.json";
+
 // Each shader has two variants: a single-eye ES 2.0 variant, and a multiview
 // ES 3.0 variant.  The multiview vertex shaders use transforms defined by
 // arrays of mat4 uniforms, using gl_ViewID_OVR to determine the array index.
 
-// Simple shaders to render .obj files without any lighting.
+// Simple shaders to render .obj files without any lighting. The model matrix
+// is an attribute so that copies of a mesh can be drawn with instancing; see
+// DrawList.
 constexpr const char* kObjVertexShaders[] = {
     R"glsl(
-    uniform mat4 u_MVP;
+    uniform mat4 u_VP;
+    attribute mat4 a_Model;
     attribute vec4 a_Position;
     attribute vec2 a_UV;
     varying vec2 v_UV;
 
     void main() {
       v_UV = a_UV;
-      gl_Position = u_MVP * a_Position;
+      gl_Position = u_VP * (a_Model * a_Position);
     })glsl",
     // The following shader is for multiview rendering.
     R"glsl(#version 300 es
@@ -85,15 +171,16 @@ constexpr const char* kObjVertexShaders[] = {
 
     layout(num_views=2) in;
 
-    uniform mat4 u_MVP[2];
+    )glsl" HELLOVR_VIEW_UNIFORMS_GLSL R"glsl(
+    in mat4 a_Model;
     in vec4 a_Position;
     in vec2 a_UV;
     out vec2 v_UV;
 
     void main() {
-      mat4 mvp = u_MVP[gl_ViewID_OVR];
+      mat4 vp = u_VP[gl_ViewID_OVR];
       v_UV = a_UV;
-      gl_Position = mvp * a_Position;
+      gl_Position = vp * (a_Model * a_Position);
     })glsl"};
 
 constexpr const char* kObjFragmentShaders[] = {
@@ -121,6 +208,56 @@ constexpr const char* kObjFragmentShaders[] = {
       FragColor = texture(u_Texture, vec2(v_UV.x, 1.0 - v_UV.y));
     })glsl"};
 
+// The same shaders for array textures, which pick their layer with a
+// per-instance attribute. Both variants require OpenGL ES 3.0.
+constexpr const char* kObjArrayVertexShaders[] = {
+    R"glsl(#version 300 es
+
+    uniform mat4 u_VP;
+    in mat4 a_Model;
+    in float a_TextureLayer;
+    in vec4 a_Position;
+    in vec2 a_UV;
+    out vec3 v_UV;
+
+    void main() {
+      v_UV = vec3(a_UV, a_TextureLayer);
+      gl_Position = u_VP * (a_Model * a_Position);
+    })glsl",
+    // The following shader is for multiview rendering.
+    R"glsl(#version 300 es
+    #extension GL_OVR_multiview2 : enable
+
+    layout(num_views=2) in;
+
+    )glsl" HELLOVR_VIEW_UNIFORMS_GLSL R"glsl(
+    in mat4 a_Model;
+    in float a_TextureLayer;
+    in vec4 a_Position;
+    in vec2 a_UV;
+    out vec3 v_UV;
+
+    void main() {
+      mat4 vp = u_VP[gl_ViewID_OVR];
+      v_UV = vec3(a_UV, a_TextureLayer);
+      gl_Position = vp * (a_Model * a_Position);
+    })glsl"};
+
+constexpr const char* kObjArrayFragmentShader =
+    R"glsl(#version 300 es
+
+    precision mediump float;
+    precision mediump sampler2DArray;
+    in vec3 v_UV;
+    out vec4 FragColor;
+    uniform sampler2DArray u_Texture;
+
+    void main() {
+      // The y coordinate of this sample's textures is reversed compared to
+      // what OpenGL expects, so we invert the y coordinate.
+      FragColor = texture(u_Texture, vec3(v_UV.x, 1.0 - v_UV.y, v_UV.z));
+    })glsl";
+
 constexpr const char* kReticleVertexShaders[] = {
     R"glsl(
     uniform mat4 u_MVP;
@@ -171,15 +308,68 @@ constexpr const char* kReticleFragmentShaders[] = {
       FragColor = vec4(alpha);
     })glsl"};
 
+gvr::Sizei ScaleSize(const gvr::Sizei& size, float scale) {
+  return {static_cast<int32_t>(size.width * scale),
+          static_cast<int32_t>(size.height * scale)};
+}
+
+// Returns the middle part of |fov| that the fovea covers.
+gvr::Rectf GetFoveaFov(const gvr::Rectf& fov) {
+  const auto shrink = [](float degrees) -> float {
+    const float radians = degrees * M_PI / 180.0f;
+    return std::atan(std::tan(radians) * kFoveaSize) * 180.0f / M_PI;
+  };
+  return {shrink(fov.left), shrink(fov.right), shrink(fov.bottom),
+          shrink(fov.top)};
+}
+
+// Returns the part of the fovea buffer that holds the view of |eye|. Without
+// multiview, the eyes are side by side like in the scene buffer.
+gvr::Rectf GetFoveaSourceUv(int eye, bool multiview) {
+  if (multiview) {
+    return {0.0f, 1.0f, 0.0f, 1.0f};
+  }
+  return eye == 0 ? gvr::Rectf{0.0f, 0.5f, 0.0f, 1.0f}
+                  : gvr::Rectf{0.5f, 1.0f, 0.0f, 1.0f};
+}
+
+gvr::Mat4f GetReticleModelMatrix() {
+  const float rs = 0.04f;  // Reticle scale.
+  return {{{rs, 0.0f, 0.0f, 0.0f},
+           {0.0f, rs, 0.0f, 0.0f},
+           {0.0f, 0.0f, rs, -kReticleDistance},
+           {0.0f, 0.0f, 0.0f, 1.0f}}};
+}
+
+gvr::Mat4f GetSafetyRingModelMatrix(float radius, float floor_height) {
+  return {{{radius, 0.0f, 0.0f, 0.0f},
+           {0.0f, radius, 0.0f, floor_height + kSafetyRingHeightDelta},
+           {0.0f, 0.0f, radius, 0.0f},
+           {0.0f, 0.0f, 0.0f, 1.0f}}};
+}
+
+// Estimates the bytes per pixel of a swap chain buffer: its color and depth
+// samples plus, if multisampled, the resolved color, for each layer. Copies
+// that GVR or the compositor keep are not counted.
+size_t GetBytesPerPixel(int samples, bool has_depth, int layers) {
+  const size_t sample_bytes = has_depth ? 4 + 2 : 4;
+  const size_t resolve_bytes = samples > 1 ? 4 : 0;
+  return (sample_bytes * samples + resolve_bytes) * layers;
+}
+
 }  // anonymous namespace
 
 HelloVrApp::HelloVrApp(JNIEnv* env, jobject asset_mgr_obj,
                        gvr_context* gvr_context,
-                       std::unique_ptr<gvr::AudioApi> gvr_audio_api)
+                       std::unique_ptr<gvr::AudioApi> gvr_audio_api,
+                       const std::string& cache_dir)
     : gvr_api_(gvr::GvrApi::WrapNonOwned(gvr_context)),
       gvr_audio_api_(std::move(gvr_audio_api)),
+      gl_context_(EGL_NO_CONTEXT),
       viewport_left_(gvr_api_->CreateBufferViewport()),
       viewport_right_(gvr_api_->CreateBufferViewport()),
+      reticle_viewport_(gvr_api_->CreateBufferViewport()),
+      fovea_viewport_(gvr_api_->CreateBufferViewport()),
       reticle_coords_({{
           -1.f,
           1.f,
@@ -203,22 +393,67 @@ HelloVrApp::HelloVrApp(JNIEnv* env, jobject asset_mgr_obj,
       target_object_meshes_(kTargetMeshCount),
       target_object_not_selected_textures_(kTargetMeshCount),
       target_object_selected_textures_(kTargetMeshCount),
+      target_object_textures_(kTargetMeshCount),
+      mesh_loader_(new MeshLoader(AAssetManager_fromJava(env, asset_mgr_obj))),
+      texture_loader_(new TextureLoader(env, asset_mgr_obj)),
+      meshes_loading_(false),
       cur_target_object_(RandomUniformInt(kTargetMeshCount)),
       reticle_program_(0),
       obj_program_(0),
       obj_position_param_(0),
       obj_uv_param_(0),
-      obj_modelview_projection_param_(0),
+      obj_draw_program_{0, -1},
+      use_texture_arrays_(false),
+      obj_array_program_(0),
+      obj_array_draw_program_{0, -1},
+      frame_budget_ns_(1e9f / kDefaultRefreshRate),
+      cache_dir_(cache_dir),
+      replay_start_frame_(-1),
+      frame_draw_calls_(0),
+      last_gl_calls_(0),
       reticle_position_param_(0),
       reticle_modelview_projection_param_(0),
       reticle_render_size_{128, 128},
-      audio_source_id_(-1),
-      success_source_id_(-1),
+      // Target object first appears directly in front of user.
+      model_target_(GetTranslationMatrix({0.0f, 1.5f, -kMinTargetDistance})),
+      model_reticle_(GetReticleModelMatrix()),
+      room_node_(scene_.AddNode(-1, GetTranslationMatrix({0.0f, 0.0f, 0.0f}))),
+      safety_ring_node_(scene_.AddNode(
+          -1, GetSafetyRingModelMatrix(kDefaultSafetyRingRadius,
+                                       kDefaultFloorHeight))),
+      target_node_(scene_.AddNode(-1, model_target_)),
+      controller_node_(
+          scene_.AddNode(-1, GetTranslationMatrix({0.0f, 0.0f, 0.0f}))),
+      reticle_node_(scene_.AddNode(controller_node_, model_reticle_)),
+      audio_player_(gvr_audio_api_.get(),
+                    {kObjectSoundFile, kSuccessSoundFile}),
+      target_voice_(-1),
       gvr_controller_api_(nullptr),
+      simulation_state_(
+          {model_target_, GetTranslationMatrix({0.0f, 0.0f, 0.0f}),
+           cur_target_object_, false}),
+      simulation_input_({gvr::Mat4f(), false}),
+      frame_simulation_(simulation_state_.Read()),
+      simulation_running_(false),
+      trigger_pending_(false),
       gvr_viewer_type_(gvr_api_->GetViewerType()),
       java_asset_mgr_(env->NewGlobalRef(asset_mgr_obj)),
       asset_mgr_(AAssetManager_fromJava(env, asset_mgr_obj)) {
   ResumeControllerApiAsNeeded();
+  RefreshEyeFromHeadMatrices();
+  GetProgramCache().SetDirectory(cache_dir);
+  if (kBenchmarkMode == BenchmarkMode::kReplay &&
+      !pose_trace_.Load(cache_dir_ + "/" + kPoseTraceFile)) {
+    LOGE("No pose trace to replay in %s.", cache_dir_.c_str());
+  }
+  if (kBenchmarkMode == BenchmarkMode::kMicro) {
+    RunMicroBenchmarks(asset_mgr_,
+                       cache_dir_ + "/" + kMicroBenchmarkReportFile);
+  }
+  // This runs once the sounds are preloaded, without delaying startup.
+  target_voice_ = audio_player_.PlayLooping(
+      kObjectSoundFile,
+      {model_target_.m[0][3], model_target_.m[1][3], model_target_.m[2][3]});
 
   LOGD("Built with GVR version: %s", GVR_SDK_VERSION_STRING);
   if (gvr_viewer_type_ == GVR_VIEWER_TYPE_CARDBOARD) {
@@ -231,73 +466,107 @@ HelloVrApp::HelloVrApp(JNIEnv* env, jobject asset_mgr_obj,
 }
 
 HelloVrApp::~HelloVrApp() {
-  // Join the audio initialization thread in case it still exists.
-  if (audio_initialization_thread_.joinable()) {
-    audio_initialization_thread_.join();
-  }
+  StopSimulation();
 }
 
 void HelloVrApp::OnSurfaceCreated(JNIEnv* env) {
+  // GLSurfaceView only calls this for a new context, so every GL object is
+  // created again. Those of a lost context went away with it and are not
+  // deleted; the meshes forget them so that nothing uses or evicts their
+  // names before they are uploaded again.
+  gl_context_ = eglGetCurrentContext();
+  room_.Forget();
+  for (TexturedMesh& mesh : target_object_meshes_) {
+    mesh.Forget();
+  }
+  safety_ring_.Forget();
+
   gvr_api_->InitializeGl();
+  // This is a new context, so nothing is known about its state.
+  GetGlStateCache().Invalidate();
   multiview_enabled_ = gvr_api_->IsFeatureSupported(GVR_FEATURE_MULTIVIEW);
   LOGD(multiview_enabled_ ? "Using multiview." : "Not using multiview.");
 
   int index = multiview_enabled_ ? 1 : 0;
-  const int reticle_vertex_shader =
-      LoadGLShader(GL_VERTEX_SHADER, kReticleVertexShaders[index]);
-  const int reticle_fragment_shader =
-      LoadGLShader(GL_FRAGMENT_SHADER, kReticleFragmentShaders[index]);
-  const int obj_vertex_shader =
-      LoadGLShader(GL_VERTEX_SHADER, kObjVertexShaders[index]);
-  const int obj_fragment_shader =
-      LoadGLShader(GL_FRAGMENT_SHADER, kObjFragmentShaders[index]);
-
-  obj_program_ = glCreateProgram();
-  glAttachShader(obj_program_, obj_vertex_shader);
-  glAttachShader(obj_program_, obj_fragment_shader);
-  glLinkProgram(obj_program_);
-  glUseProgram(obj_program_);
+  ProgramCache& program_cache = GetProgramCache();
+  obj_program_ = program_cache.CreateProgram(
+      kObjVertexShaders[index], kObjFragmentShaders[index],
+      {{kModelMatrixAttribLocation, "a_Model"}});
+  GetGlStateCache().UseProgram(obj_program_);
+  if (multiview_enabled_) {
+    view_uniforms_.Initialize();
+    if (kFoveatedRendering) {
+      fovea_view_uniforms_.Initialize();
+    }
+    ViewUniforms::AttachToProgram(obj_program_);
+  }
 
   CheckGLError("Obj program");
 
   obj_position_param_ = glGetAttribLocation(obj_program_, "a_Position");
   obj_uv_param_ = glGetAttribLocation(obj_program_, "a_UV");
-  obj_modelview_projection_param_ = glGetUniformLocation(obj_program_, "u_MVP");
+  obj_draw_program_.program = obj_program_;
+  obj_draw_program_.view_projection_uniform =
+      glGetUniformLocation(obj_program_, "u_VP");
 
   CheckGLError("Obj program params");
 
-  HELLOVR_CHECK(room_.Initialize(env, asset_mgr_, "CubeRoom.obj",
-                                 obj_position_param_, obj_uv_param_));
-  HELLOVR_CHECK(
-      room_tex_.Initialize(env, java_asset_mgr_, "CubeRoom_BakedDiffuse.png"));
-  HELLOVR_CHECK(target_object_meshes_[0].Initialize(
-      env, asset_mgr_, "Icosahedron.obj", obj_position_param_, obj_uv_param_));
-  HELLOVR_CHECK(target_object_not_selected_textures_[0].Initialize(
-      env, java_asset_mgr_, "Icosahedron_Blue_BakedDiffuse.png"));
-  HELLOVR_CHECK(target_object_selected_textures_[0].Initialize(
-      env, java_asset_mgr_, "Icosahedron_Pink_BakedDiffuse.png"));
-  HELLOVR_CHECK(target_object_meshes_[1].Initialize(
-      env, asset_mgr_, "QuadSphere.obj", obj_position_param_, obj_uv_param_));
-  HELLOVR_CHECK(target_object_not_selected_textures_[1].Initialize(
-      env, java_asset_mgr_, "QuadSphere_Blue_BakedDiffuse.png"));
-  HELLOVR_CHECK(target_object_selected_textures_[1].Initialize(
-      env, java_asset_mgr_, "QuadSphere_Pink_BakedDiffuse.png"));
-  HELLOVR_CHECK(target_object_meshes_[2].Initialize(
-      env, asset_mgr_, "TriSphere.obj", obj_position_param_, obj_uv_param_));
-  HELLOVR_CHECK(target_object_not_selected_textures_[2].Initialize(
-      env, java_asset_mgr_, "TriSphere_Blue_BakedDiffuse.png"));
-  HELLOVR_CHECK(target_object_selected_textures_[2].Initialize(
-      env, java_asset_mgr_, "TriSphere_Pink_BakedDiffuse.png"));
-  HELLOVR_CHECK(safety_ring_.Initialize(env, asset_mgr_, "SafetyRing.obj",
-                                        obj_position_param_, obj_uv_param_));
-  HELLOVR_CHECK(safety_ring_tex_.Initialize(env, java_asset_mgr_,
-                                            "SafetyRing_Alpha.png"));
-
-  reticle_program_ = glCreateProgram();
-  glAttachShader(reticle_program_, reticle_vertex_shader);
-  glAttachShader(reticle_program_, reticle_fragment_shader);
-  glLinkProgram(reticle_program_);
-  glUseProgram(reticle_program_);
+  // The array program shares the attribute locations of |obj_program_|, so
+  // that the meshes can be drawn with either.
+  use_texture_arrays_ = IsGLES3Context();
+  if (use_texture_arrays_) {
+    obj_array_program_ = program_cache.CreateProgram(
+        kObjArrayVertexShaders[index], kObjArrayFragmentShader,
+        {{kModelMatrixAttribLocation, "a_Model"},
+         {kTextureLayerAttribLocation, "a_TextureLayer"},
+         {obj_position_param_, "a_Position"},
+         {obj_uv_param_, "a_UV"}});
+    if (multiview_enabled_) {
+      ViewUniforms::AttachToProgram(obj_array_program_);
+    }
+    obj_array_draw_program_.program = obj_array_program_;
+    obj_array_draw_program_.view_projection_uniform =
+        glGetUniformLocation(obj_array_program_, "u_VP");
+    CheckGLError("Obj array program");
+  }
+
+  draw_list_.Initialize(IsGLES3Context());
+  profiler_.InitializeGl();
+  if (kShowProfilerOverlay) {
+    profiler_overlay_.Initialize(multiview_enabled_);
+  }
+
+  // The meshes are parsed in parallel and uploaded over the next frames.
+  mesh_loader_->Load("CubeRoom.mesh", obj_position_param_, obj_uv_param_,
+                     &room_);
+  room_tex_.Initialize(texture_loader_.get(), "CubeRoom_BakedDiffuse.png");
+  mesh_loader_->Load("Icosahedron.mesh", obj_position_param_, obj_uv_param_,
+                     &target_object_meshes_[0]);
+  mesh_loader_->Load("QuadSphere.mesh", obj_position_param_, obj_uv_param_,
+                     &target_object_meshes_[1]);
+  mesh_loader_->Load("TriSphere.mesh", obj_position_param_, obj_uv_param_,
+                     &target_object_meshes_[2]);
+  for (int i = 0; i < kTargetMeshCount; ++i) {
+    const char* const* files = kTargetTextureFiles[i];
+    if (use_texture_arrays_) {
+      target_object_textures_[i].InitializeArray(
+          texture_loader_.get(), {files[kNotSelectedLayer],
+                                  files[kSelectedLayer]});
+    } else {
+      target_object_not_selected_textures_[i].Initialize(
+          texture_loader_.get(), files[kNotSelectedLayer]);
+      target_object_selected_textures_[i].Initialize(texture_loader_.get(),
+                                                     files[kSelectedLayer]);
+    }
+  }
+  mesh_loader_->Load("SafetyRing.mesh", obj_position_param_, obj_uv_param_,
+                     &safety_ring_);
+  safety_ring_tex_.Initialize(texture_loader_.get(), "SafetyRing_Alpha.png");
+  meshes_loading_ = true;
+
+  reticle_program_ = program_cache.CreateProgram(
+      kReticleVertexShaders[index], kReticleFragmentShaders[index], {});
+  GetGlStateCache().UseProgram(reticle_program_);
 
   CheckGLError("Reticle program");
 
@@ -307,19 +576,10 @@ void HelloVrApp::OnSurfaceCreated(JNIEnv* env) {
 
   CheckGLError("Reticle program params");
 
-  // Target object first appears directly in front of user.
-  model_target_ = GetTranslationMatrix({0.0f, 1.5f, -kMinTargetDistance});
-
-  const float rs = 0.04f;  // Reticle scale.
-  model_reticle_ = {{{rs, 0.0f, 0.0f, 0.0f},
-                     {0.0f, rs, 0.0f, 0.0f},
-                     {0.0f, 0.0f, rs, -kReticleDistance},
-                     {0.0f, 0.0f, 0.0f, 1.0f}}};
-
-  // Because we are using 2X MSAA, we can render to half as many pixels and
-  // achieve similar quality.
-  render_size_ =
-      HalfPixelCount(gvr_api_->GetMaximumEffectiveRenderTargetSize());
+  recommended_render_size_ = GetRecommendedRenderSize();
+  render_size_ = recommended_render_size_;
+  fovea_render_size_ = GetFoveaRenderSize();
+  resolution_controller_.Reset();
   std::vector<gvr::BufferSpec> specs;
 
   specs.push_back(gvr_api_->CreateBufferSpec());
@@ -342,17 +602,32 @@ void HelloVrApp::OnSurfaceCreated(JNIEnv* env) {
   specs[1].SetColorFormat(GVR_COLOR_FORMAT_RGBA_8888);
   specs[1].SetDepthStencilFormat(GVR_DEPTH_STENCIL_FORMAT_NONE);
   specs[1].SetSamples(1);
+
+  if (kFoveatedRendering) {
+    specs.push_back(gvr_api_->CreateBufferSpec());
+    gvr::BufferSpec& fovea_spec = specs[kFoveaBufferIndex];
+    fovea_spec.SetColorFormat(GVR_COLOR_FORMAT_RGBA_8888);
+    fovea_spec.SetDepthStencilFormat(GVR_DEPTH_STENCIL_FORMAT_DEPTH_16);
+    fovea_spec.SetSamples(2);
+    if (multiview_enabled_) {
+      fovea_spec.SetMultiviewLayers(2);
+      fovea_spec.SetSize(
+          {fovea_render_size_.width / 2, fovea_render_size_.height});
+    } else {
+      fovea_spec.SetSize(fovea_render_size_);
+    }
+  }
   swapchain_.reset(new gvr::SwapChain(gvr_api_->CreateSwapChain(specs)));
+  const int layers = multiview_enabled_ ? 2 : 1;
+  swap_chain_bytes_per_pixel_ = {GetBytesPerPixel(2, true, layers),
+                                 GetBytesPerPixel(1, false, 1)};
+  if (kFoveatedRendering) {
+    swap_chain_bytes_per_pixel_.push_back(GetBytesPerPixel(2, true, layers));
+  }
+  TrackSwapChainMemory();
 
   viewport_list_.reset(
       new gvr::BufferViewportList(gvr_api_->CreateEmptyBufferViewportList()));
-
-  // Initialize audio engine and preload sample in a separate thread to avoid
-  // any delay during construction and app initialization. Only do this once.
-  if (!audio_initialization_thread_.joinable()) {
-    audio_initialization_thread_ =
-        std::thread(&HelloVrApp::LoadAndPlayTargetObjectSound, this);
-  }
 }
 
 void HelloVrApp::ResumeControllerApiAsNeeded() {
@@ -402,183 +677,498 @@ void HelloVrApp::ProcessControllerInput() {
   }
 }
 
+void HelloVrApp::UpdateSceneGraph() {
+  // Only nodes that are set to new values are recomputed, so the room never
+  // is after the first frame, and the ring only when the floor moves.
+  scene_.SetLocalTransform(target_node_, frame_simulation_.model_target);
+  scene_.SetLocalTransform(controller_node_,
+                           frame_simulation_.controller_matrix);
+  scene_.SetLocalTransform(
+      safety_ring_node_,
+      GetSafetyRingModelMatrix(frame_state_.safety_ring_radius,
+                               frame_state_.floor_height));
+  scene_.Update();
+}
+
 void HelloVrApp::UpdateReticlePosition() {
+  const gvr::Mat4f& model_reticle = scene_.GetWorldTransform(reticle_node_);
+  if (gvr_viewer_type_ == GVR_VIEWER_TYPE_DAYDREAM) {
+    modelview_reticle_ = MatrixMul(head_view_, model_reticle);
+  } else {
+    modelview_reticle_ = model_reticle;
+  }
+}
+
+void HelloVrApp::StartSimulation() {
+  if (!simulation_thread_.joinable()) {
+    simulation_running_ = true;
+    simulation_thread_ = std::thread(&HelloVrApp::RunSimulation, this);
+  }
+}
+
+void HelloVrApp::StopSimulation() {
+  if (simulation_thread_.joinable()) {
+    simulation_running_ = false;
+    simulation_thread_.join();
+  }
+}
+
+void HelloVrApp::RunSimulation() {
+  auto next_tick = std::chrono::steady_clock::now();
+  while (simulation_running_) {
+    const SimulationInput& input = simulation_input_.Read();
+    if (input.has_head_view) {
+      Simulate(input.head_view);
+    }
+    next_tick += std::chrono::nanoseconds(kSimulationTickNanos);
+    std::this_thread::sleep_until(next_tick);
+  }
+}
+
+void HelloVrApp::Simulate(const gvr::Mat4f& head_view) {
+  gvr::Mat4f controller_matrix = GetTranslationMatrix({0.0f, 0.0f, 0.0f});
+  gvr::Mat4f head_from_reticle = model_reticle_;
   if (gvr_viewer_type_ == GVR_VIEWER_TYPE_DAYDREAM) {
     ProcessControllerInput();
-    gvr::Mat4f controller_matrix =
+    controller_matrix =
         ControllerQuatToMatrix(gvr_controller_state_.GetOrientation());
-    modelview_reticle_ =
-        MatrixMul(head_view_, MatrixMul(controller_matrix, model_reticle_));
-  } else {
-    modelview_reticle_ = model_reticle_;
+    head_from_reticle =
+        MatrixMul(head_view, MatrixMul(controller_matrix, model_reticle_));
+  }
+
+  bool pointing_at_target = IsPointingAtTarget(head_view, head_from_reticle);
+  if (trigger_pending_.exchange(false) && pointing_at_target) {
+    audio_player_.PlayOnce(kSuccessSoundFile);
+    HideTarget();
+    pointing_at_target = IsPointingAtTarget(head_view, head_from_reticle);
   }
+
+  // Update audio head rotation in audio API.
+  audio_player_.SetHeadPose(head_view);
+
+  simulation_state_.Write({model_target_, controller_matrix,
+                           cur_target_object_, pointing_at_target});
 }
 
 void HelloVrApp::OnDrawFrame() {
+  profiler_.BeginFrame();
+  GetResourceRegistry().BeginFrame();
+  // This also uploads meshes that are reloaded after an eviction.
+  const bool meshes_pending = mesh_loader_->ProcessUploads();
+  if (meshes_loading_ && !meshes_pending) {
+    meshes_loading_ = false;
+    LOGD("Loaded %zu meshes.", mesh_loader_->GetUploadedCount());
+    GetResourceRegistry().LogTotals("loaded");
+  }
+  texture_loader_->ProcessUploads(kTextureUploadBytesPerFrame);
+  if (replay_start_frame_ < 0 && pose_trace_.GetFrameCount() > 0 &&
+      kBenchmarkMode == BenchmarkMode::kReplay && !meshes_loading_) {
+    // Start once the scene is complete, so that every run draws the same.
+    replay_start_frame_ = profiler_.GetFrameIndex();
+    LOGD("Replaying %zu frames.", pose_trace_.GetFrameCount());
+  }
+  frame_draw_calls_ = 0;
   PrepareFramebuffer();
   gvr::Frame frame = swapchain_->AcquireFrame();
+  pose_predictor_.OnFrameAcquired();
 
   // A client app does its rendering here.
-  gvr::ClockTimePoint target_time = gvr::GvrApi::GetTimePointNow();
-  target_time.monotonic_system_time_nanos += kPredictionTimeWithoutVsyncNanos;
   gvr::BufferViewport* viewport[2] = {
       &viewport_left_,
       &viewport_right_,
   };
-  // Note that neck model application is a no-op if the viewer supports 6DoF
-  // head tracking
-  head_view_ = gvr_api_->ApplyNeckModel(
-      gvr_api_->GetHeadSpaceFromStartSpaceTransform(target_time),
-      kNeckModelFactor);
-
-  gvr::Value floor_height;
-  // This may change when the floor height changes so it's computed every frame.
-  float ground_y = gvr_api_->GetCurrentProperties().Get(
-                       GVR_PROPERTY_TRACKING_FLOOR_HEIGHT, &floor_height)
-                       ? floor_height.f
-                       : kDefaultFloorHeight;
-  // Incorporate the floor height into the head_view
-  head_view_ =
-      MatrixMul(head_view_, GetTranslationMatrix({0.0f, ground_y, 0.0f}));
+  {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kPose);
+    UpdateFrameState(pose_predictor_.GetTargetTime());
+  }
+  // The simulation uses the newest pose for picking and audio.
+  simulation_input_.Write({head_view_, true});
 
   viewport_list_->SetToRecommendedBufferViewports();
 
-  gvr::BufferViewport reticle_viewport = gvr_api_->CreateBufferViewport();
-  reticle_viewport.SetSourceBufferIndex(1);
-  if (gvr_viewer_type_ == GVR_VIEWER_TYPE_CARDBOARD) {
-    // Do not reproject the reticle if it's head-locked.
-    reticle_viewport.SetReprojection(GVR_REPROJECTION_NONE);
-  }
+  reticle_viewport_.SetSourceBufferIndex(1);
+  // Do not reproject the reticle if it's head-locked.
+  reticle_viewport_.SetReprojection(
+      gvr_viewer_type_ == GVR_VIEWER_TYPE_CARDBOARD ? GVR_REPROJECTION_NONE
+                                                    : GVR_REPROJECTION_FULL);
   const gvr_rectf fullscreen = {0, 1, 0, 1};
-  reticle_viewport.SetSourceUv(fullscreen);
-  UpdateReticlePosition();
+  reticle_viewport_.SetSourceUv(fullscreen);
+  {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kControllers);
+    frame_simulation_ = simulation_state_.Read();
+  }
+  UpdateSceneGraph();
 
-  gvr::Mat4f modelview_room[2];
-
-  gvr::Value cylinder_radius;
-  float safety_ring_radius =
-      gvr_api_->GetCurrentProperties().Get(
-          GVR_PROPERTY_SAFETY_CYLINDER_ENTER_RADIUS, &cylinder_radius)
-          ? cylinder_radius.f
-          : kDefaultSafetyRingRadius;
-  gvr::Mat4f model_safety_ring = {
-      {{safety_ring_radius, 0.0f, 0.0f, 0.0f},
-       {0.0f, safety_ring_radius, 0.0f, ground_y + kSafetyRingHeightDelta},
-       {0.0f, 0.0f, safety_ring_radius, 0.0f},
-       {0.0f, 0.0f, 0.0f, 1.0f}}};
-  gvr::Mat4f modelview_safety_ring[2];
-
-  gvr::Mat4f eye_views[2];
   for (int eye = 0; eye < 2; ++eye) {
-    const gvr::Eye gvr_eye = eye == 0 ? GVR_LEFT_EYE : GVR_RIGHT_EYE;
-    const gvr::Mat4f eye_from_head = gvr_api_->GetEyeFromHeadMatrix(gvr_eye);
-    eye_views[eye] = MatrixMul(eye_from_head, head_view_);
-
     viewport_list_->GetBufferViewport(eye, viewport[eye]);
 
+    // Only the part of the buffer that matches the render scale is drawn.
     if (multiview_enabled_) {
-      viewport[eye]->SetSourceUv(fullscreen);
+      viewport[eye]->SetSourceUv(
+          resolution_controller_.ScaleSourceUv(fullscreen));
       viewport[eye]->SetSourceLayer(eye);
-      viewport_list_->SetBufferViewport(eye, *viewport[eye]);
+    } else {
+      viewport[eye]->SetSourceUv(
+          resolution_controller_.ScaleSourceUv(viewport[eye]->GetSourceUv()));
     }
-
-    reticle_viewport.SetTransform(MatrixMul(eye_from_head, modelview_reticle_));
-    reticle_viewport.SetTargetEye(gvr_eye);
-    // The first two viewports are for the 3D scene (one for each eye), the
-    // latter two viewports are for the reticle (one for each eye).
-    viewport_list_->SetBufferViewport(2 + eye, reticle_viewport);
-
-    modelview_target_[eye] = MatrixMul(eye_views[eye], model_target_);
-    modelview_room[eye] = eye_views[eye];
-    modelview_safety_ring[eye] = MatrixMul(eye_views[eye], model_safety_ring);
-
-    const gvr_rectf fov = viewport[eye]->GetSourceFov();
-
-    const gvr::Mat4f perspective =
-        PerspectiveMatrixFromView(fov, kZNear, kZFar);
-    modelview_projection_target_[eye] =
-        MatrixMul(perspective, modelview_target_[eye]);
-    modelview_projection_room_[eye] =
-        MatrixMul(perspective, modelview_room[eye]);
-    modelview_projection_safety_ring_[eye] =
-        MatrixMul(perspective, modelview_safety_ring[eye]);
-  }
-
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_CULL_FACE);
-  glDisable(GL_SCISSOR_TEST);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-  // Draw the world.
-  frame.BindBuffer(0);
-  // The clear color doesn't matter here because it's completely obscured by
-  // the room. However, the color buffer is still cleared because it may
-  // improve performance.
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    viewport_list_->SetBufferViewport(eye, *viewport[eye]);
+
+    if (kFoveatedRendering) {
+      // Start from the eye's viewport, so that only the source changes.
+      viewport_list_->GetBufferViewport(eye, &fovea_viewport_);
+      fovea_viewport_.SetSourceBufferIndex(kFoveaBufferIndex);
+      fovea_viewport_.SetSourceFov(GetFoveaFov(viewport[eye]->GetSourceFov()));
+      fovea_viewport_.SetSourceUv(GetFoveaSourceUv(eye, multiview_enabled_));
+      viewport_list_->SetBufferViewport(kFoveaViewportIndex + eye,
+                                        fovea_viewport_);
+    }
+  }
+  UpdateViewTransforms();
+
+  // Collect the world-space objects. They are sorted once and then drawn for
+  // each view.
+  draw_list_.Clear();
+  // Until the meshes are in, the frame only shows the reticle.
+  if (!meshes_loading_) {
+    SubmitTarget();
+    SubmitRoom();
+    if (frame_state_.show_safety_ring) {
+      SubmitSafetyRing();
+    }
+  }
+  draw_list_.Cull(GetCullingFrustum());
+  draw_list_.Prepare(head_view_);
+  // Only what this frame draws is safe from eviction, so nothing is evicted
+  // before the scene is complete.
+  if (!meshes_loading_) {
+    GetResourceRegistry().EnforceBudget(kResourceBudgetBytes);
+  }
   if (multiview_enabled_) {
-    DrawWorld(kMultiview);
-  } else {
-    DrawWorld(kLeftView);
-    DrawWorld(kRightView);
+    view_uniforms_.BeginFrame(eye_view_, projection_);
   }
-  frame.Unbind();
 
-  // Draw the reticle on a separate layer.
-  frame.BindBuffer(1);
-  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);  // Transparent background.
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  DrawReticle();
-  frame.Unbind();
+  GlStateCache& gl_state = GetGlStateCache();
+  gl_state.SetCapability(GL_DEPTH_TEST, true);
+  gl_state.SetCapability(GL_CULL_FACE, true);
+  gl_state.SetCapability(GL_SCISSOR_TEST, false);
+  gl_state.SetCapability(GL_BLEND, true);
+  gl_state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kDrawWorld);
+    // Draw the world.
+    //
+    // Every buffer is fully cleared after binding, so that a tiled GPU never
+    // loads its old contents, and its depth is discarded before unbinding, so
+    // that only the resolved color is stored. A clear only counts as full if
+    // the write masks are all on.
+    gl_state.DepthMask(true);
+    frame.BindBuffer(0);
+    profiler_.BeginGpuPass(0);
+    // The clear color doesn't matter here because it's completely obscured by
+    // the room. However, the color buffer is still cleared because it may
+    // improve performance.
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (multiview_enabled_) {
+      DrawWorld(kMultiview, kSceneLayer);
+    } else {
+      DrawWorld(kLeftView, kSceneLayer);
+      DrawWorld(kRightView, kSceneLayer);
+    }
+    DiscardDepthStencil();
+    frame.Unbind();
+
+    if (kFoveatedRendering) {
+      // The same items again, with the narrower projection of the fovea.
+      frame.BindBuffer(kFoveaBufferIndex);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      if (multiview_enabled_) {
+        fovea_view_uniforms_.BeginFrame(eye_view_, fovea_projection_);
+        DrawWorld(kMultiview, kFoveaLayer);
+      } else {
+        DrawWorld(kLeftView, kFoveaLayer);
+        DrawWorld(kRightView, kFoveaLayer);
+      }
+      DiscardDepthStencil();
+      frame.Unbind();
+    }
+    profiler_.EndGpuPass();
+
+    // Draw the reticle on a separate layer.
+    frame.BindBuffer(kReticleBufferIndex);
+    profiler_.BeginGpuPass(1);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);  // Transparent background.
+    // The reticle buffer has no depth, so there is nothing to discard.
+    glClear(GL_COLOR_BUFFER_BIT);
+    DrawReticle();
+    profiler_.EndGpuPass();
+    frame.Unbind();
+  }
 
-  // Submit frame.
-  frame.Submit(*viewport_list_, head_view_);
+  if (kLateLatchHeadPose && multiview_enabled_ &&
+      view_uniforms_.SupportsLateLatch()) {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kPose);
+    // The GPU has not run the draws yet, so they still pick up a newer pose.
+    // Submit() gets the same pose, which keeps reprojection consistent.
+    head_view_ = GetHeadView(pose_predictor_.GetTargetTime());
+    UpdateViewTransforms();
+    view_uniforms_.LateLatch(eye_view_, projection_);
+    if (kFoveatedRendering) {
+      fovea_view_uniforms_.LateLatch(eye_view_, fovea_projection_);
+    }
+  }
 
-  CheckGLError("onDrawFrame");
+  {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kSubmit);
+    // Submit frame.
+    pose_predictor_.OnFrameSubmitted();
+    frame.Submit(*viewport_list_, head_view_);
+    // The distortion renderer changes GL state behind the cache's back.
+    gl_state.Invalidate();
+  }
 
-  // Update audio head rotation in audio API.
-  gvr_audio_api_->SetHeadPose(head_view_);
-  gvr_audio_api_->Update();
+  CheckGLError("onDrawFrame");
+  profiler_.EndFrame();
+  UpdateBenchmark();
 }
 
 void HelloVrApp::PrepareFramebuffer() {
-  // Because we are using 2X MSAA, we can render to half as many pixels and
-  // achieve similar quality.
-  const gvr::Sizei recommended_size =
-      HalfPixelCount(gvr_api_->GetMaximumEffectiveRenderTargetSize());
-  if (render_size_.width != recommended_size.width ||
-      render_size_.height != recommended_size.height) {
+  const gvr::Sizei recommended_size = GetRecommendedRenderSize();
+  const bool scale_needs_resize = resolution_controller_.Update(
+      profiler_, frame_budget_ns_);
+  const bool recommended_size_changed =
+      recommended_render_size_.width != recommended_size.width ||
+      recommended_render_size_.height != recommended_size.height;
+  if (kFoveatedRendering && recommended_size_changed) {
+    // The fovea doesn't follow the render scale.
+    fovea_render_size_ = GetFoveaRenderSize();
+    gvr::Sizei fovea_size = fovea_render_size_;
+    if (multiview_enabled_) {
+      fovea_size.width /= 2;
+    }
+    swapchain_->ResizeBuffer(kFoveaBufferIndex, fovea_size);
+    TrackSwapChainMemory();
+  }
+  if (scale_needs_resize || recommended_size_changed) {
     // We need to resize the framebuffer. Note that multiview uses two texture
     // layers, each with half the render width.
-    gvr::Sizei framebuffer_size = recommended_size;
+    recommended_render_size_ = recommended_size;
+    render_size_ = resolution_controller_.GetBufferSize(recommended_size);
+    gvr::Sizei framebuffer_size = render_size_;
     if (multiview_enabled_) {
       framebuffer_size.width /= 2;
     }
     swapchain_->ResizeBuffer(0, framebuffer_size);
-    render_size_ = recommended_size;
+    TrackSwapChainMemory();
   }
 }
 
-void HelloVrApp::OnTriggerEvent() {
-  if (IsPointingAtTarget()) {
-    success_source_id_ = gvr_audio_api_->CreateStereoSound(kSuccessSoundFile);
-    gvr_audio_api_->PlaySound(success_source_id_, false /* looping disabled */);
-    HideTarget();
+void HelloVrApp::TrackSwapChainMemory() {
+  size_t bytes = 0;
+  for (int32_t i = 0; i < swapchain_->GetBufferCount(); ++i) {
+    const gvr::Sizei size = swapchain_->GetBufferSize(i);
+    bytes += static_cast<size_t>(size.width) * size.height *
+             swap_chain_bytes_per_pixel_[i];
   }
+  GetResourceRegistry().Track(swapchain_.get(), ResourceKind::kBuffer,
+                              "swap chain", 0, bytes);
+}
+
+gvr::Sizei HelloVrApp::GetRecommendedRenderSize() const {
+  // Because we are using 2X MSAA, we can render to half as many pixels and
+  // achieve similar quality.
+  const gvr::Sizei size =
+      HalfPixelCount(gvr_api_->GetMaximumEffectiveRenderTargetSize());
+  return kFoveatedRendering ? ScaleSize(size, kPeripheryResolutionScale)
+                            : size;
+}
+
+gvr::Sizei HelloVrApp::GetFoveaRenderSize() const {
+  // The fovea covers kFoveaSize of each dimension of the view at the density
+  // of the full sized scene buffer.
+  return ScaleSize(
+      HalfPixelCount(gvr_api_->GetMaximumEffectiveRenderTargetSize()),
+      kFoveaSize);
+}
+
+void HelloVrApp::UpdateFrameState(const gvr::ClockTimePoint& target_time) {
+  // Each GetCurrentProperties() call fetches a new properties handle, so use
+  // a single one for the frame.
+  const gvr::Properties properties = gvr_api_->GetCurrentProperties();
+  gvr::Value value;
+  // This may change when the floor height changes so it's read every frame.
+  frame_state_.floor_height =
+      properties.Get(GVR_PROPERTY_TRACKING_FLOOR_HEIGHT, &value)
+          ? value.f
+          : kDefaultFloorHeight;
+  head_view_ = GetHeadView(target_time);
+
+  frame_state_.show_safety_ring =
+      properties.Get(GVR_PROPERTY_SAFETY_REGION, &value) &&
+      value.i == GVR_SAFETY_REGION_CYLINDER;
+  frame_state_.safety_ring_radius = kDefaultSafetyRingRadius;
+  if (frame_state_.show_safety_ring &&
+      properties.Get(GVR_PROPERTY_SAFETY_CYLINDER_ENTER_RADIUS, &value)) {
+    frame_state_.safety_ring_radius = value.f;
+  }
+}
+
+gvr::Mat4f HelloVrApp::GetHeadView(const gvr::ClockTimePoint& target_time) {
+  const int64_t replay_frame = GetReplayFrame();
+  if (replay_frame >= 0) {
+    return pose_trace_.GetPose(static_cast<size_t>(replay_frame));
+  }
+  // Note that neck model application is a no-op if the viewer supports 6DoF
+  // head tracking
+  const gvr::Mat4f head_view = gvr_api_->ApplyNeckModel(
+      gvr_api_->GetHeadSpaceFromStartSpaceTransform(target_time),
+      kNeckModelFactor);
+  // Incorporate the floor height into the head_view
+  const float ground_y = frame_state_.floor_height;
+  return MatrixMul(head_view, GetTranslationMatrix({0.0f, ground_y, 0.0f}));
+}
+
+void HelloVrApp::UpdateViewTransforms() {
+  const gvr::BufferViewport* viewport[2] = {&viewport_left_, &viewport_right_};
+  UpdateReticlePosition();
+  for (int eye = 0; eye < 2; ++eye) {
+    const gvr::Mat4f& eye_from_head = eye_from_head_[eye];
+    reticle_viewport_.SetTransform(
+        MatrixMul(eye_from_head, modelview_reticle_));
+    reticle_viewport_.SetTargetEye(eye == 0 ? GVR_LEFT_EYE : GVR_RIGHT_EYE);
+    viewport_list_->SetBufferViewport(kReticleViewportIndex + eye,
+                                      reticle_viewport_);
+
+    eye_view_[eye] = MatrixMul(eye_from_head, head_view_);
+    projection_[eye] =
+        PerspectiveMatrixFromView(viewport[eye]->GetSourceFov(), kZNear, kZFar);
+    view_projection_[eye] = MatrixMul(projection_[eye], eye_view_[eye]);
+    if (kFoveatedRendering) {
+      fovea_projection_[eye] = PerspectiveMatrixFromView(
+          GetFoveaFov(viewport[eye]->GetSourceFov()), kZNear, kZFar);
+      fovea_view_projection_[eye] =
+          MatrixMul(fovea_projection_[eye], eye_view_[eye]);
+    }
+  }
+}
+
+ViewFrustum HelloVrApp::GetCullingFrustum() const {
+  const gvr::BufferViewport* viewport[2] = {&viewport_left_, &viewport_right_};
+  gvr::Mat4f view_projection[2];
+  for (int eye = 0; eye < 2; ++eye) {
+    const gvr::Rectf fov =
+        WidenFov(viewport[eye]->GetSourceFov(), kCullingMarginDegrees);
+    view_projection[eye] = MatrixMul(
+        PerspectiveMatrixFromView(fov, kZNear, kZFar), eye_view_[eye]);
+  }
+  ViewFrustum frustum;
+  frustum.Set(view_projection);
+  return frustum;
+}
+
+void HelloVrApp::RefreshEyeFromHeadMatrices() {
+  eye_from_head_[0] = gvr_api_->GetEyeFromHeadMatrix(GVR_LEFT_EYE);
+  eye_from_head_[1] = gvr_api_->GetEyeFromHeadMatrix(GVR_RIGHT_EYE);
+}
+
+int64_t HelloVrApp::GetReplayFrame() const {
+  if (replay_start_frame_ < 0) {
+    return -1;
+  }
+  const int64_t frame = profiler_.GetFrameIndex() - replay_start_frame_;
+  return frame < static_cast<int64_t>(pose_trace_.GetFrameCount()) ? frame
+                                                                   : -1;
+}
+
+void HelloVrApp::UpdateBenchmark() {
+  const uint32_t gl_calls = GetGlStateCache().GetStats().issued_calls;
+  const uint32_t frame_gl_calls = gl_calls - last_gl_calls_;
+  last_gl_calls_ = gl_calls;
+  if (kBenchmarkMode == BenchmarkMode::kRecord) {
+    pose_trace_.Append(head_view_);
+    return;
+  }
+  if (replay_start_frame_ < 0) {
+    return;
+  }
+  if (GetReplayFrame() >= 0) {
+    benchmark_report_.AddCounts(frame_draw_calls_, frame_gl_calls);
+    const ResourceRegistry::Totals memory = GetResourceRegistry().GetTotals();
+    benchmark_report_.AddMemory(memory.GetCpuBytes(), memory.GetGpuBytes());
+  }
+  // The GPU timings of a frame are only known a few frames later, so the
+  // timings trail the counts, and the run ends a few frames after the trace.
+  FrameTimings timings;
+  if (!profiler_.GetTimings(FrameProfiler::kGpuResultFrames, &timings) ||
+      timings.frame_index < replay_start_frame_) {
+    return;
+  }
+  benchmark_report_.AddTimings(timings);
+  const int64_t last_frame = replay_start_frame_ +
+                             static_cast<int64_t>(pose_trace_.GetFrameCount()) -
+                             1;
+  if (timings.frame_index < last_frame) {
+    return;
+  }
+  LOGD("Benchmark: %s", benchmark_report_.ToJson().c_str());
+  benchmark_report_.Write(cache_dir_ + "/" + kBenchmarkReportFile);
+  benchmark_report_.Clear();
+  pose_trace_.Clear();
+  replay_start_frame_ = -1;
+}
+
+void HelloVrApp::OnTriggerEvent() { trigger_pending_ = true; }
+
+void HelloVrApp::SetDisplayRefreshRate(float refresh_rate) {
+  if (refresh_rate > 0.0f) {
+    frame_budget_ns_ = 1e9f / refresh_rate;
+  }
+}
+
+void HelloVrApp::OnTrimMemory(int level) {
+  if (level < kTrimMemoryRunningModerate) {
+    return;
+  }
+  // The decoded images only save decoding time on reloads.
+  texture_loader_->ClearCache();
+  // GL objects can only be deleted with their context current. At
+  // TRIM_MEMORY_UI_HIDDEN and above GLSurfaceView has usually made it
+  // non-current, so those levels only drop the cache and GPU memory stays
+  // allocated until the app is resumed or killed. Like OnDrawFrame(), this
+  // evicts nothing while the meshes are loading.
+  if (level >= kTrimMemoryRunningLow && !meshes_loading_ &&
+      gl_context_ != EGL_NO_CONTEXT && eglGetCurrentContext() == gl_context_) {
+    GetResourceRegistry().EnforceBudget(0);
+  }
+  GetResourceRegistry().LogTotals("trimmed");
 }
 
 void HelloVrApp::OnPause() {
+  const GlStateCache::Stats& gl_stats = GetGlStateCache().GetStats();
+  LOGD("GL state changes: %u issued, %u skipped.", gl_stats.issued_calls,
+       gl_stats.skipped_calls);
+  GetGlStateCache().ResetStats();
+  last_gl_calls_ = 0;
+  GetResourceRegistry().LogTotals("paused");
+  if (kBenchmarkMode == BenchmarkMode::kRecord &&
+      pose_trace_.Save(cache_dir_ + "/" + kPoseTraceFile)) {
+    LOGD("Saved a pose trace of %zu frames.", pose_trace_.GetFrameCount());
+  }
+  // The simulation uses the controller and audio APIs, so it stops first.
+  StopSimulation();
   gvr_api_->PauseTracking();
-  gvr_audio_api_->Pause();
+  audio_player_.Pause();
   if (gvr_controller_api_) gvr_controller_api_->Pause();
 }
 
 void HelloVrApp::OnResume() {
   gvr_api_->ResumeTracking();
   gvr_api_->RefreshViewerProfile();
-  gvr_audio_api_->Resume();
+  RefreshEyeFromHeadMatrices();
+  audio_player_.Resume();
   gvr_viewer_type_ = gvr_api_->GetViewerType();
   ResumeControllerApiAsNeeded();
+  StartSimulation();
 }
 
 /**
@@ -586,93 +1176,82 @@ void HelloVrApp::OnResume() {
  *
  * @param view The view to render: left, right, or both (multiview).
  */
-void HelloVrApp::DrawWorld(ViewType view) {
+void HelloVrApp::DrawWorld(ViewType view, LayerType layer) {
+  const gvr::Sizei& buffer_size =
+      layer == kFoveaLayer ? fovea_render_size_ : render_size_;
+  // Each multiview layer is half as wide as the render size.
+  const gvr::Sizei layer_size = {
+      view == kMultiview ? buffer_size.width / 2 : buffer_size.width,
+      buffer_size.height};
+  const gvr::BufferViewport& viewport =
+      view == kRightView ? viewport_right_ : viewport_left_;
+  const gvr::Rectf source_uv =
+      layer == kFoveaLayer
+          ? GetFoveaSourceUv(view == kRightView ? 1 : 0, view == kMultiview)
+          : viewport.GetSourceUv();
+  const gvr::Recti pixel_rect = CalculatePixelSpaceRect(layer_size, source_uv);
+  glViewport(pixel_rect.left, pixel_rect.bottom,
+             pixel_rect.right - pixel_rect.left,
+             pixel_rect.top - pixel_rect.bottom);
   if (view == kMultiview) {
-    glViewport(0, 0, render_size_.width / 2, render_size_.height);
+    // The matrices are in the view uniforms bound by BeginFrame().
+    draw_list_.Draw(nullptr, 2);
+    frame_draw_calls_ += draw_list_.GetDrawCallCount();
   } else {
-    const gvr::BufferViewport& viewport =
-        view == kLeftView ? viewport_left_ : viewport_right_;
-    const gvr::Recti pixel_rect =
-        CalculatePixelSpaceRect(render_size_, viewport.GetSourceUv());
-    glViewport(pixel_rect.left, pixel_rect.bottom,
-               pixel_rect.right - pixel_rect.left,
-               pixel_rect.top - pixel_rect.bottom);
+    const gvr::Mat4f* view_projection =
+        layer == kFoveaLayer ? fovea_view_projection_ : view_projection_;
+    draw_list_.Draw(MatrixToGLArray(view_projection[view]).data(), 1);
+    frame_draw_calls_ += draw_list_.GetDrawCallCount();
   }
-  DrawTarget(view);
-  DrawRoom(view);
-  gvr::Value safety_region;
-  int safety_region_type = gvr_api_->GetCurrentProperties().Get(
-                               GVR_PROPERTY_SAFETY_REGION, &safety_region)
-                               ? safety_region.i
-                               : GVR_SAFETY_REGION_NONE;
-  if (safety_region_type == GVR_SAFETY_REGION_CYLINDER) {
-    DrawSafetyRing(view);
+  // The overlay is drawn once, in the scene buffer.
+  if (kShowProfilerOverlay && layer == kSceneLayer) {
+    profiler_overlay_.Draw(profiler_);
   }
 }
 
-void HelloVrApp::DrawTarget(ViewType view) {
-  glUseProgram(obj_program_);
-
-  if (view == kMultiview) {
-    glUniformMatrix4fv(
-        obj_modelview_projection_param_, 2, GL_FALSE,
-        MatrixPairToGLArray(modelview_projection_target_).data());
-  } else {
-    glUniformMatrix4fv(
-        obj_modelview_projection_param_, 1, GL_FALSE,
-        MatrixToGLArray(modelview_projection_target_[view]).data());
+void HelloVrApp::SubmitTarget() {
+  const int target_object = frame_simulation_.target_object;
+  const bool selected = frame_simulation_.pointing_at_target;
+  if (use_texture_arrays_) {
+    // Both states share the texture, so the item only changes its layer.
+    draw_list_.Add({&obj_array_draw_program_,
+                    &target_object_textures_[target_object],
+                    selected ? kSelectedLayer : kNotSelectedLayer,
+                    &target_object_meshes_[target_object],
+                    scene_.GetWorldTransform(target_node_), BlendMode::kOpaque,
+                    nullptr, nullptr});
+    return;
   }
-
-  if (IsPointingAtTarget()) {
-    target_object_selected_textures_[cur_target_object_].Bind();
-  } else {
-    target_object_not_selected_textures_[cur_target_object_].Bind();
-  }
-  target_object_meshes_[cur_target_object_].Draw();
-
-  CheckGLError("Drawing target object");
+  const Texture& texture =
+      selected ? target_object_selected_textures_[target_object]
+               : target_object_not_selected_textures_[target_object];
+  draw_list_.Add({&obj_draw_program_, &texture, 0,
+                  &target_object_meshes_[target_object],
+                  scene_.GetWorldTransform(target_node_), BlendMode::kOpaque,
+                  nullptr, nullptr});
 }
 
-void HelloVrApp::DrawRoom(ViewType view) {
-  glUseProgram(obj_program_);
-
-  if (view == kMultiview) {
-    glUniformMatrix4fv(obj_modelview_projection_param_, 2, GL_FALSE,
-                       MatrixPairToGLArray(modelview_projection_room_).data());
-  } else {
-    glUniformMatrix4fv(
-        obj_modelview_projection_param_, 1, GL_FALSE,
-        MatrixToGLArray(modelview_projection_room_[view]).data());
-  }
-
-  room_tex_.Bind();
-  room_.Draw();
-
-  CheckGLError("Drawing room");
+void HelloVrApp::SubmitRoom() {
+  // The baked room texture has partially transparent texels, so the room is
+  // blended like before. As the farthest blended item it is drawn right after
+  // the opaque items.
+  draw_list_.Add({&obj_draw_program_, &room_tex_, 0, &room_,
+                  scene_.GetWorldTransform(room_node_), BlendMode::kAlpha,
+                  nullptr, nullptr});
 }
 
-void HelloVrApp::DrawSafetyRing(ViewType view) {
-  glUseProgram(obj_program_);
-
-  if (view == kMultiview) {
-    glUniformMatrix4fv(
-        obj_modelview_projection_param_, 2, GL_FALSE,
-        MatrixPairToGLArray(modelview_projection_safety_ring_).data());
-  } else {
-    glUniformMatrix4fv(
-        obj_modelview_projection_param_, 1, GL_FALSE,
-        MatrixToGLArray(modelview_projection_safety_ring_[view]).data());
-  }
-
-  safety_ring_tex_.Bind();
-  safety_ring_.Draw();
-
-  CheckGLError("Draw Safety Ring");
+void HelloVrApp::SubmitSafetyRing() {
+  draw_list_.Add({&obj_draw_program_, &safety_ring_tex_, 0, &safety_ring_,
+                  scene_.GetWorldTransform(safety_ring_node_),
+                  BlendMode::kAlpha, nullptr, nullptr});
 }
 
 void HelloVrApp::DrawReticle() {
   glViewport(0, 0, reticle_render_size_.width, reticle_render_size_.height);
-  glUseProgram(reticle_program_);
+  GlStateCache& gl_state = GetGlStateCache();
+  gl_state.SetCapability(GL_BLEND, true);
+  gl_state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  gl_state.UseProgram(reticle_program_);
   const gvr::Mat4f uniform_matrix = {{{1.f, 0.f, 0.f, 0.f},
                                       {0.f, 1.f, 0.f, 0.f},
                                       {0.f, 0.f, 1.f, 0.f},
@@ -699,18 +1278,14 @@ void HelloVrApp::HideTarget() {
 
   model_target_ = GetTranslationMatrix(target_position);
 
-  if (audio_source_id_ >= 0) {
-    gvr_audio_api_->SetSoundObjectPosition(audio_source_id_, target_position.x,
-                                           target_position.y,
-                                           target_position.z);
-  }
+  audio_player_.SetPosition(target_voice_, target_position);
 }
 
-bool HelloVrApp::IsPointingAtTarget() {
+bool HelloVrApp::IsPointingAtTarget(
+    const gvr::Mat4f& head_view, const gvr::Mat4f& head_from_reticle) const {
   // Compute vectors pointing towards the reticle and towards the target object
   // in head space.
-  gvr::Mat4f head_from_reticle = modelview_reticle_;
-  gvr::Mat4f head_from_target = MatrixMul(head_view_, model_target_);
+  gvr::Mat4f head_from_target = MatrixMul(head_view, model_target_);
   const std::array<float, 4> reticle_vector =
       MatrixVectorMul(head_from_reticle, {0.f, 0.f, 0.f, 1.f});
   const std::array<float, 4> target_vector =
@@ -720,18 +1295,4 @@ bool HelloVrApp::IsPointingAtTarget() {
   return angle < kAngleLimit;
 }
 
-void HelloVrApp::LoadAndPlayTargetObjectSound() {
-  // Preload sound files.
-  gvr_audio_api_->PreloadSoundfile(kObjectSoundFile);
-  gvr_audio_api_->PreloadSoundfile(kSuccessSoundFile);
-  // Create sound file handler from preloaded sound file.
-  audio_source_id_ = gvr_audio_api_->CreateSoundObject(kObjectSoundFile);
-  // Set sound object to current target position.
-  gvr_audio_api_->SetSoundObjectPosition(
-      audio_source_id_, model_target_.m[0][3], model_target_.m[1][3],
-      model_target_.m[2][3]);
-  // Trigger sound object playback.
-  gvr_audio_api_->PlaySound(audio_source_id_, true /* looped playback */);
-}
-
 }  // namespace ndk_hello_vr
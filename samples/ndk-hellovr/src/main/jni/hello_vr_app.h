@@ -21,12 +21,29 @@
 #include <android/asset_manager.h>
 #include <jni.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <thread>  // NOLINT
 #include <vector>
 
-#include "util.h"  // NOLINT
+#include "audio_player.h"           // NOLINT
+#include "benchmark_report.h"       // NOLINT
+#include "draw_list.h"              // NOLINT
+#include "frame_profiler.h"         // NOLINT
+#include "mesh_loader.h"            // NOLINT
+#include "micro_benchmarks.h"       // NOLINT
+#include "pose_predictor.h"         // NOLINT
+#include "pose_trace.h"             // NOLINT
+#include "profiler_overlay.h"       // NOLINT
+#include "resolution_controller.h"  // NOLINT
+#include "resource_registry.h"      // NOLINT
+#include "scene_graph.h"            // NOLINT
+#include "texture_loader.h"         // NOLINT
+#include "triple_buffer.h"          // NOLINT
+#include "util.h"                   // NOLINT
+#include "view_frustum.h"           // NOLINT
+#include "view_uniforms.h"          // NOLINT
 #include "vr/gvr/capi/include/gvr.h"
 #include "vr/gvr/capi/include/gvr_audio.h"
 #include "vr/gvr/capi/include/gvr_controller.h"
@@ -47,15 +64,18 @@ class HelloVrApp {
    * @param asset_mgr_obj The asset manager object.
    * @param gvr_api The (non-owned) gvr_context.
    * @param gvr_audio_api The (owned) gvr::AudioApi context.
+   * @param cache_dir A directory for compiled shader programs, or empty to
+   *     compile them on every surface creation; see ProgramCache.
    */
   HelloVrApp(JNIEnv* env, jobject asset_mgr_obj, gvr_context* gvr_context,
-             std::unique_ptr<gvr::AudioApi> gvr_audio_api);
+             std::unique_ptr<gvr::AudioApi> gvr_audio_api,
+             const std::string& cache_dir);
 
   ~HelloVrApp();
 
   /**
    * Initializes any GL-related objects. This should be called on the rendering
-   * thread with a valid GL context.
+   * thread with a valid GL context, once for each new context.
    */
   void OnSurfaceCreated(JNIEnv* env);
 
@@ -65,7 +85,8 @@ class HelloVrApp {
   void OnDrawFrame();
 
   /**
-   * Hides the target object if it's being targeted.
+   * Hides the target object if it's being targeted. May be called from any
+   * thread; the simulation thread handles the event on its next tick.
    */
   void OnTriggerEvent();
 
@@ -79,22 +100,106 @@ class HelloVrApp {
    */
   void OnResume();
 
+  /**
+   * Releases memory as the system asks for in ComponentCallbacks2's
+   * onTrimMemory(). This should be called on the rendering thread. GL
+   * objects are only evicted while the context is current, which it usually
+   * is not once the UI is hidden.
+   *
+   * @param level The trim level, such as TRIM_MEMORY_RUNNING_LOW.
+   */
+  void OnTrimMemory(int level);
+
+  /**
+   * Sets the refresh rate of the display, which the GPU time of a frame is
+   * budgeted against. This should be called on the rendering thread.
+   *
+   * @param refresh_rate The rate in Hz, as from Display.getRefreshRate().
+   */
+  void SetDisplayRefreshRate(float refresh_rate);
+
  private:
   int CreateTexture(int width, int height, int textureFormat, int textureType);
 
   /*
-   * Prepares the GvrApi framebuffer for rendering, resizing if needed.
+   * Prepares the GvrApi framebuffer for rendering, resizing if needed. Also
+   * picks the render scale of the frame.
    */
   void PrepareFramebuffer();
 
+  /*
+   * Records the estimated size of the swap chain buffers in the resource
+   * registry. Called whenever a buffer is created or resized.
+   */
+  void TrackSwapChainMemory();
+
+  /*
+   * Returns the render target size for the scene buffer at a render scale of
+   * 1. With foveated rendering this is the size of the periphery.
+   */
+  gvr::Sizei GetRecommendedRenderSize() const;
+
+  /*
+   * Returns the size of the fovea buffer for foveated rendering.
+   */
+  gvr::Sizei GetFoveaRenderSize() const;
+
+  /*
+   * Reads the head pose and the GVR properties used while drawing a frame.
+   * The rest of the frame reads them from |head_view_| and |frame_state_|
+   * instead of querying GvrApi again.
+   */
+  void UpdateFrameState(const gvr::ClockTimePoint& target_time);
+
+  /*
+   * Reads the head pose for |target_time|, including the floor height of the
+   * frame.
+   */
+  gvr::Mat4f GetHeadView(const gvr::ClockTimePoint& target_time);
+
+  /*
+   * Computes everything that depends on |head_view_|: the view-projection
+   * matrices and the reticle viewports. Called again after late latching.
+   */
+  void UpdateViewTransforms();
+
+  /*
+   * Returns the volume seen by either eye at |head_view_|, with some margin,
+   * for culling the world-space objects.
+   */
+  ViewFrustum GetCullingFrustum() const;
+
+  /*
+   * Caches the eye-from-head matrices. These only change with the viewer
+   * profile, so this is called again after refreshing it.
+   */
+  void RefreshEyeFromHeadMatrices();
+
+  /*
+   * Returns the frame of |pose_trace_| that the current frame replays, or -1
+   * if it uses the tracked head pose.
+   */
+  int64_t GetReplayFrame() const;
+
+  /*
+   * Records the pose or the measurements of the frame that just ended, as
+   * selected by kBenchmarkMode, and writes the report at the end of a replay.
+   */
+  void UpdateBenchmark();
+
   enum ViewType { kLeftView, kRightView, kMultiview };
 
+  // The buffers that the world is drawn into. Without foveated rendering
+  // there is only the scene buffer.
+  enum LayerType { kSceneLayer, kFoveaLayer };
+
   /**
    * Draws all world-space objects for the given view type.
    *
    * @param view Specifies which view we are rendering.
+   * @param layer Specifies which buffer is bound.
    */
-  void DrawWorld(ViewType view);
+  void DrawWorld(ViewType view, LayerType layer);
 
   /**
    * Draws the reticle. The reticle is positioned using viewport parameters,
@@ -103,28 +208,19 @@ class HelloVrApp {
   void DrawReticle();
 
   /**
-   * Draws the target object.
-   *
-   * We've set all of our transformation matrices. Now we simply pass them
-   * into the shader.
-   *
-   * @param view Specifies which eye we are rendering: left, right, or both.
+   * Adds the target object to |draw_list_|.
    */
-  void DrawTarget(ViewType view);
+  void SubmitTarget();
 
   /**
-   * Draws the room.
-   *
-   * @param view Specifies which eye we are rendering: left, right, or both.
+   * Adds the room to |draw_list_|.
    */
-  void DrawRoom(ViewType view);
+  void SubmitRoom();
 
   /**
-   * Draws the safety ring.
-   *
-   * @param view Specifies which eye we are rendering: left, right, or both.
+   * Adds the safety ring to |draw_list_|.
    */
-  void DrawSafetyRing(ViewType view);
+  void SubmitSafetyRing();
 
   /**
    * Finds a new random position for the target object.
@@ -132,27 +228,49 @@ class HelloVrApp {
   void HideTarget();
 
   /**
-   * Updates the position of the reticle based on controller data.
-   * In Cardboard mode, this function simply sets the position to the center
-   * of the view.
+   * Moves the nodes of |scene_| to the frame's simulation and frame state,
+   * and recomputes the world transforms of those that changed.
+   */
+  void UpdateSceneGraph();
+
+  /**
+   * Places the reticle with its node in |scene_|. In Cardboard mode, the
+   * reticle is simply in the center of the view.
    */
   void UpdateReticlePosition();
 
+  /**
+   * Starts and stops the simulation thread, which runs while the app is
+   * resumed.
+   */
+  void StartSimulation();
+  void StopSimulation();
+
+  /**
+   * The body of the simulation thread.
+   */
+  void RunSimulation();
+
+  /**
+   * Advances the simulation by one tick: reads the controller, handles
+   * trigger events, updates the audio engine and publishes a new
+   * SimulationState. Only called on the simulation thread.
+   *
+   * @param head_view The latest head pose used for rendering.
+   */
+  void Simulate(const gvr::Mat4f& head_view);
+
   /**
    * Checks if user is pointing or looking at the target object by calculating
    * whether the angle between the user's gaze or controller orientation and the
    * vector pointing towards the object is lower than some threshold.
    *
+   * @param head_view The head pose.
+   * @param head_from_reticle The pose of the reticle in head space.
    * @return true if the user is pointing at the target object.
    */
-  bool IsPointingAtTarget();
-
-  /**
-   * Preloads the target object sound sample and starts the spatialized playback
-   * at the current target location. This method is executed from a separate
-   * thread to avoid any delay during construction and app initialization.
-   */
-  void LoadAndPlayTargetObjectSound();
+  bool IsPointingAtTarget(const gvr::Mat4f& head_view,
+                          const gvr::Mat4f& head_from_reticle) const;
 
   /**
    * Processes the controller input.
@@ -177,8 +295,14 @@ class HelloVrApp {
   std::unique_ptr<gvr::AudioApi> gvr_audio_api_;
   std::unique_ptr<gvr::BufferViewportList> viewport_list_;
   std::unique_ptr<gvr::SwapChain> swapchain_;
+  // The context that the GL objects were created in.
+  EGLContext gl_context_;
   gvr::BufferViewport viewport_left_;
   gvr::BufferViewport viewport_right_;
+  gvr::BufferViewport reticle_viewport_;
+  // Places the fovea buffer in the middle of each eye when foveated rendering
+  // is enabled.
+  gvr::BufferViewport fovea_viewport_;
 
   std::vector<float> lightpos_;
 
@@ -193,6 +317,19 @@ class HelloVrApp {
   std::vector<TexturedMesh> target_object_meshes_;
   std::vector<Texture> target_object_not_selected_textures_;
   std::vector<Texture> target_object_selected_textures_;
+  // The same textures as array textures with both states as layers, used
+  // instead of the above if |use_texture_arrays_| is set.
+  std::vector<Texture> target_object_textures_;
+
+  // Declared after the meshes and textures so that they are destroyed before
+  // them.
+  std::unique_ptr<MeshLoader> mesh_loader_;
+  std::unique_ptr<TextureLoader> texture_loader_;
+  // Whether meshes queued by OnSurfaceCreated() are still loading. The world
+  // is left out of the frames until they are done.
+  bool meshes_loading_;
+  // The target is owned by the simulation thread, which publishes it in
+  // SimulationState.
   int cur_target_object_;
 
   int reticle_program_;
@@ -200,45 +337,130 @@ class HelloVrApp {
 
   GLuint obj_position_param_;
   GLuint obj_uv_param_;
-  GLuint obj_modelview_projection_param_;
+  DrawProgram obj_draw_program_;
+  // Whether the context supports array textures, which are sampled by
+  // |obj_array_program_|.
+  bool use_texture_arrays_;
+  GLuint obj_array_program_;
+  DrawProgram obj_array_draw_program_;
+
+  // The world-space objects of the current frame.
+  DrawList draw_list_;
+
+  FrameProfiler profiler_;
+  PosePredictor pose_predictor_;
+  ProfilerOverlay profiler_overlay_;
+  ResolutionController resolution_controller_;
+  // The time between refreshes of the display, in nanoseconds.
+  float frame_budget_ns_;
+
+  // The state of a benchmark run; see kBenchmarkMode.
+  const std::string cache_dir_;
+  PoseTrace pose_trace_;
+  BenchmarkReport benchmark_report_;
+  // The profiler frame that replays the first pose of |pose_trace_|, or -1
+  // if no replay is running.
+  int64_t replay_start_frame_;
+  // The draw calls of |draw_list_| in the current frame.
+  size_t frame_draw_calls_;
+  // The calls issued by the GL state cache up to the end of the last frame.
+  uint32_t last_gl_calls_;
+
+  // The estimated bytes per pixel of each swap chain buffer, for
+  // TrackSwapChainMemory().
+  std::vector<size_t> swap_chain_bytes_per_pixel_;
 
   int reticle_position_param_;
   int reticle_modelview_projection_param_;
 
   const gvr::Sizei reticle_render_size_;
 
+  // The GVR properties of the current frame, see UpdateFrameState().
+  struct FrameState {
+    float floor_height;
+    float safety_ring_radius;
+    bool show_safety_ring;
+  };
+  FrameState frame_state_;
+  gvr::Mat4f eye_from_head_[2];
+
   gvr::Mat4f head_view_;
   gvr::Mat4f model_target_;
   gvr::Mat4f camera_;
   gvr::Mat4f view_;
   gvr::Mat4f model_reticle_;
   gvr::Mat4f modelview_reticle_;
+  // The world transforms of the rendered objects, which culling and the draw
+  // list read. The nodes are moved once per frame, before any of them.
+  SceneGraph scene_;
+  int room_node_;
+  int safety_ring_node_;
+  int target_node_;
+  // The reticle is a child of the controller node, which stays at the
+  // identity without a controller.
+  int controller_node_;
+  int reticle_node_;
+  // The render target size recommended by GVR, and the actual size of the
+  // scene buffer, which follows the render scale on large, sustained changes.
+  // Only part of the buffer may be rendered in a given frame.
+  gvr::Sizei recommended_render_size_;
   gvr::Sizei render_size_;
+  // The size of the fovea buffer, which always has the full resolution.
+  gvr::Sizei fovea_render_size_;
 
   // View-dependent values.  These are stored in length two arrays to allow
   // syncing with uniforms consumed by the multiview vertex shader.  For
   // simplicity, we stash valid values in both elements (left, right) of these
   // arrays even when multiview is disabled.
-  gvr::Mat4f modelview_projection_target_[2];
-  gvr::Mat4f modelview_projection_room_[2];
-  gvr::Mat4f modelview_projection_safety_ring_[2];
-  gvr::Mat4f modelview_target_[2];
+  gvr::Mat4f eye_view_[2];
+  gvr::Mat4f projection_[2];
+  gvr::Mat4f view_projection_[2];
+  // Holds the matrices above for the multiview shaders. The ES 2.0 shaders
+  // get |view_projection_| as a plain uniform instead.
+  ViewUniforms view_uniforms_;
+  // The same for the narrower field of view of the fovea buffer.
+  gvr::Mat4f fovea_projection_[2];
+  gvr::Mat4f fovea_view_projection_[2];
+  ViewUniforms fovea_view_uniforms_;
 
   float reticle_distance_;
   bool multiview_enabled_;
 
-  gvr::AudioSourceId audio_source_id_;
-
-  gvr::AudioSourceId success_source_id_;
-
-  std::thread audio_initialization_thread_;
+  // Preloads the sounds and plays them off the render and simulation
+  // threads. Declared after |gvr_audio_api_| so that it stops first.
+  AudioPlayer audio_player_;
+  // The voice of the looping target sound.
+  int target_voice_;
 
   // Controller API entry point.
   std::unique_ptr<gvr::ControllerApi> gvr_controller_api_;
 
-  // The latest controller state (updated once per frame).
+  // The latest controller state (updated once per simulation tick).
   gvr::ControllerState gvr_controller_state_;
 
+  // What the simulation thread hands to the renderer. The renderer never
+  // touches the simulation's own members, and vice versa.
+  struct SimulationState {
+    gvr::Mat4f model_target;
+    // The controller orientation in start space. Without a controller this
+    // is the identity, and the reticle is head-locked.
+    gvr::Mat4f controller_matrix;
+    int target_object;
+    bool pointing_at_target;
+  };
+  struct SimulationInput {
+    gvr::Mat4f head_view;
+    bool has_head_view;
+  };
+  TripleBuffer<SimulationState> simulation_state_;
+  TripleBuffer<SimulationInput> simulation_input_;
+  // The simulation state used for rendering the current frame.
+  SimulationState frame_simulation_;
+
+  std::thread simulation_thread_;
+  std::atomic<bool> simulation_running_;
+  std::atomic<bool> trigger_pending_;
+
   gvr::ViewerType gvr_viewer_type_;
 
   jobject java_asset_mgr_;
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mesh_loader.h"  // NOLINT
+
+#include "resource_registry.h"  // NOLINT
+
+namespace ndk_hello_vr {
+
+namespace {
+
+// Parsing .obj files is CPU bound, while .mesh files are mostly page faults
+// into the APK. Together with the texture decoders this keeps the big cores
+// busy at startup without starving the GL thread.
+constexpr size_t kParseThreadCount = 2;
+
+}  // anonymous namespace
+
+MeshLoader::MeshLoader(AAssetManager* asset_mgr)
+    : asset_mgr_(asset_mgr),
+      load_count_(0),
+      uploaded_count_(0),
+      thread_pool_(new ThreadPool(kParseThreadCount)) {}
+
+MeshLoader::~MeshLoader() { thread_pool_.reset(); }
+
+void MeshLoader::Load(const std::string& path, GLuint position_attrib,
+                      GLuint uv_attrib, TexturedMesh* mesh) {
+  std::unique_ptr<Job> job(new Job);
+  job->path = path;
+  job->position_attrib = position_attrib;
+  job->uv_attrib = uv_attrib;
+  job->mesh = mesh;
+  job->parsed = false;
+  job->parse_succeeded = false;
+  Job* job_ptr = job.get();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+  }
+  ++load_count_;
+  thread_pool_->Post([this, job_ptr] { ParseTask(job_ptr); });
+  // An evicted mesh is parsed and uploaded again the next time it is drawn.
+  GetResourceRegistry().SetEvictable(
+      mesh, [mesh] { mesh->Release(); },
+      [this, path, position_attrib, uv_attrib, mesh] {
+        Load(path, position_attrib, uv_attrib, mesh);
+      });
+}
+
+bool MeshLoader::ProcessUploads() {
+  while (true) {
+    std::unique_ptr<Job> job;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (jobs_.empty() || !jobs_.front()->parsed) {
+        break;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    HELLOVR_CHECK(job->parse_succeeded &&
+                  job->mesh->Initialize(job->data, job->position_attrib,
+                                        job->uv_attrib));
+    ++uploaded_count_;
+  }
+  return uploaded_count_ < load_count_;
+}
+
+void MeshLoader::ParseTask(Job* job) {
+  // Only this task touches the job until it is marked as parsed.
+  const bool succeeded = TexturedMesh::Parse(asset_mgr_, job->path, &job->data);
+  if (!succeeded) {
+    LOGE("Couldn't load mesh %s.", job->path.c_str());
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  job->parse_succeeded = succeeded;
+  job->parsed = true;
+}
+
+}  // namespace ndk_hello_vr
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_MESH_LOADER_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_MESH_LOADER_H_  // NOLINT
+
+#include <android/asset_manager.h>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "thread_pool.h"  // NOLINT
+#include "util.h"         // NOLINT
+
+namespace ndk_hello_vr {
+
+// Loads meshes from the app's assets without blocking the GL thread.
+//
+// Files are read and parsed on worker threads, next to the image decoding
+// of TextureLoader. ProcessUploads() then creates the GL buffers on the GL
+// thread, in the order that the loads were queued in.
+//
+// The loader must be destroyed before the meshes it loads into.
+class MeshLoader {
+ public:
+  explicit MeshLoader(AAssetManager* asset_mgr);
+
+  ~MeshLoader();
+
+  // Queues the mesh file at |path| (see TexturedMesh::Parse()) to be parsed
+  // and uploaded into |mesh|. Must be called on the GL thread.
+  //
+  // The mesh is registered with GetResourceRegistry(), which may evict it
+  // and reload it through this loader. ProcessUploads() has to keep running
+  // for the reloads.
+  void Load(const std::string& path, GLuint position_attrib, GLuint uv_attrib,
+            TexturedMesh* mesh);
+
+  // Uploads the parsed meshes that all earlier loads have been uploaded
+  // before. Must be called on the GL thread, typically once per frame. A
+  // mesh that fails to load is a fatal error, as the app cannot run without
+  // its meshes.
+  //
+  // @return True if some loads have not been uploaded yet.
+  bool ProcessUploads();
+
+  // The number of Load() calls, and how many of them have been uploaded, for
+  // showing the loading progress.
+  size_t GetLoadCount() const { return load_count_; }
+  size_t GetUploadedCount() const { return uploaded_count_; }
+
+ private:
+  struct Job {
+    std::string path;
+    GLuint position_attrib;
+    GLuint uv_attrib;
+    TexturedMesh* mesh;
+    MeshData data;
+    // Set by the worker once |data| is complete.
+    bool parsed;
+    bool parse_succeeded;
+  };
+
+  void ParseTask(Job* job);
+
+  AAssetManager* asset_mgr_;
+
+  std::mutex mutex_;
+  // The jobs that have not been uploaded, in Load() order.
+  std::deque<std::unique_ptr<Job>> jobs_;
+
+  size_t load_count_;
+  size_t uploaded_count_;
+
+  // Reset first on destruction, so that no worker still uses a job.
+  std::unique_ptr<ThreadPool> thread_pool_;
+
+  MeshLoader(const MeshLoader&) = delete;
+  MeshLoader& operator=(const MeshLoader&) = delete;
+};
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_MESH_LOADER_H_  // NOLINT
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "micro_benchmarks.h"  // NOLINT
+
+#include <time.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "obj_loader.h"  // NOLINT
+#include "util.h"        // NOLINT
+
+namespace ndk_hello_vr {
+
+namespace {
+
+// How long each routine is repeated for.
+constexpr int64_t kMinBenchmarkNanos = 50000000;
+
+#if defined(__aarch64__)
+constexpr const char* kAbi = "arm64-v8a";
+#elif defined(__arm__)
+constexpr const char* kAbi = "armeabi-v7a";
+#elif defined(__x86_64__)
+constexpr const char* kAbi = "x86_64";
+#elif defined(__i386__)
+constexpr const char* kAbi = "x86";
+#else
+constexpr const char* kAbi = "unknown";
+#endif
+
+// The benchmarks store a part of each result here, so that the calls are not
+// optimized away.
+volatile float g_sink;
+
+int64_t NowNanos() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Runs |function| in batches of doubling size until a batch takes at least
+// kMinBenchmarkNanos, and appends the time per call of that batch to |json|.
+template <typename Function>
+void RunBenchmark(const char* name, Function function, std::string* json) {
+  for (int64_t iterations = 1;; iterations *= 2) {
+    const int64_t start_ns = NowNanos();
+    for (int64_t i = 0; i < iterations; ++i) {
+      function();
+    }
+    const int64_t elapsed_ns = NowNanos() - start_ns;
+    if (elapsed_ns < kMinBenchmarkNanos) {
+      continue;
+    }
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer),
+             ",\"%s\":{\"ns\":%.1f,\"iterations\":%lld}", name,
+             static_cast<double>(elapsed_ns) / iterations,
+             static_cast<long long>(iterations));
+    json->append(buffer);
+    return;
+  }
+}
+
+// Reads a whole asset, or returns an empty string if there is none.
+std::string ReadAsset(AAssetManager* asset_mgr, const char* path) {
+  AAsset* asset = AAssetManager_open(asset_mgr, path, AASSET_MODE_BUFFER);
+  if (asset == nullptr) {
+    LOGE("Error opening asset %s", path);
+    return std::string();
+  }
+  const char* data = static_cast<const char*>(AAsset_getBuffer(asset));
+  std::string contents;
+  if (data != nullptr) {
+    contents.assign(data, AAsset_getLength(asset));
+  }
+  AAsset_close(asset);
+  return contents;
+}
+
+// Parses an .obj asset from memory, which leaves out the asset reads.
+void RunParseObjBenchmark(AAssetManager* asset_mgr, const char* name,
+                          const char* path, std::string* json) {
+  const std::string contents = ReadAsset(asset_mgr, path);
+  if (contents.empty()) {
+    return;
+  }
+  RunBenchmark(name,
+               [&contents]() {
+                 ObjMesh mesh;
+                 std::string error;
+                 ParseObj(contents.data(), contents.size(), false, &mesh,
+                          &error);
+                 g_sink = static_cast<float>(mesh.indices.size());
+               },
+               json);
+}
+
+}  // anonymous namespace
+
+bool RunMicroBenchmarks(AAssetManager* asset_mgr,
+                        const std::string& report_path) {
+  std::string json = std::string("{\"abi\":\"") + kAbi + "\"";
+
+  // A rotation and a translation, so that repeated products stay finite.
+  const gvr::ControllerQuat quat = {0.1f, 0.7f, -0.1f, 0.7f};
+  const gvr::Mat4f rotation = ControllerQuatToMatrix(quat);
+  const gvr::Mat4f translation = GetTranslationMatrix({0.5f, 1.5f, -2.0f});
+  const gvr::Mat4f pair[2] = {rotation, translation};
+  const gvr::Rectf fov = {40.0f, 45.0f, 50.0f, 45.0f};
+  const std::array<float, 4> vec1 = {{0.0f, 0.0f, -1.0f, 0.0f}};
+  const std::array<float, 4> vec2 = {{0.3f, 0.2f, -0.9f, 0.0f}};
+
+  RunBenchmark("MatrixMul",
+               [&]() { g_sink = MatrixMul(rotation, translation).m[0][3]; },
+               &json);
+  RunBenchmark("MatrixPairToGLArray",
+               [&]() { g_sink = MatrixPairToGLArray(pair)[20]; }, &json);
+  RunBenchmark(
+      "PerspectiveMatrixFromView",
+      [&]() { g_sink = PerspectiveMatrixFromView(fov, 0.1f, 100.0f).m[0][0]; },
+      &json);
+  RunBenchmark("ControllerQuatToMatrix",
+               [&]() { g_sink = ControllerQuatToMatrix(quat).m[0][1]; },
+               &json);
+  RunBenchmark("AngleBetweenVectors",
+               [&]() { g_sink = AngleBetweenVectors(vec1, vec2); }, &json);
+
+  RunParseObjBenchmark(asset_mgr, "ParseObj CubeRoom", "CubeRoom.obj", &json);
+  RunParseObjBenchmark(asset_mgr, "ParseObj TriSphere", "TriSphere.obj",
+                       &json);
+  RunBenchmark("TexturedMesh::Parse CubeRoom",
+               [asset_mgr]() {
+                 MeshData data;
+                 TexturedMesh::Parse(asset_mgr, "CubeRoom.mesh", &data);
+                 g_sink = static_cast<float>(data.index_count);
+               },
+               &json);
+
+  json += "}\n";
+  LOGD("Micro benchmarks: %s", json.c_str());
+
+  FILE* file = fopen(report_path.c_str(), "w");
+  if (file == nullptr) {
+    LOGE("Could not create %s.", report_path.c_str());
+    return false;
+  }
+  const bool written = fwrite(json.data(), json.size(), 1, file) == 1;
+  if (fclose(file) != 0 || !written) {
+    LOGE("Could not write micro benchmark report %s.", report_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ndk_hello_vr
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_OBJ_LOADER_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_OBJ_LOADER_H_  // NOLINT
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// This file has no Android or OpenGL dependencies so that it can also be
+// built into host-side asset tools.
+
+namespace ndk_hello_vr {
+
+// An indexed triangle mesh produced from an .obj file.
+//
+// Every distinct combination of position, UV and (optionally) normal that is
+// referenced by a face becomes exactly one vertex, so triangles sharing a
+// corner also share the vertex. Vertices are numbered in the order in which
+// faces first reference them, which keeps vertex fetches mostly sequential.
+struct ObjMesh {
+  std::vector<float> positions;  // 3 floats per vertex.
+  std::vector<float> uvs;        // 2 floats per vertex, or empty.
+  std::vector<float> normals;    // 3 floats per vertex, or empty.
+  std::vector<uint32_t> indices;  // 3 indices per triangle.
+
+  size_t GetVertexCount() const { return positions.size() / 3; }
+};
+
+// Parses the contents of an .obj file.
+//
+// Supports 'v', 'vt', 'vn' and 'f' records; faces may use any of the
+// v, v/vt, v//vn and v/vt/vn forms, negative (relative) indices, and any
+// number of corners (polygons are triangulated as fans). Other records are
+// ignored. Numbers are parsed without going through the C locale.
+//
+// Files larger than a threshold are split into line-aligned chunks that are
+// parsed on a shared pool of worker threads before being merged.
+//
+// @param data The file contents. Does not need to be null-terminated.
+// @param size The number of bytes in |data|.
+// @param keep_normals Whether normals should be part of the output. When
+//     false, vertices that only differ by their normal are merged.
+// @param mesh The output mesh.
+// @param error Receives a description of the problem if parsing fails.
+// @return true if the file was parsed successfully.
+bool ParseObj(const char* data, size_t size, bool keep_normals, ObjMesh* mesh,
+              std::string* error);
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_OBJ_LOADER_H_  // NOLINT
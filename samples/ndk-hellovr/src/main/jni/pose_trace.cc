@@ -0,0 +1,88 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pose_trace.h"  // NOLINT
+
+#include <cstdint>
+#include <cstdio>
+
+#include "util.h"  // NOLINT
+
+namespace ndk_hello_vr {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x31545048;  // "HPT1"
+
+struct Header {
+  uint32_t magic;
+  uint32_t frame_count;
+};
+
+}  // anonymous namespace
+
+PoseTrace::PoseTrace() {}
+
+void PoseTrace::Append(const gvr::Mat4f& head_view) {
+  poses_.push_back(head_view);
+}
+
+void PoseTrace::Clear() { poses_.clear(); }
+
+bool PoseTrace::Load(const std::string& path) {
+  poses_.clear();
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  Header header;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+               header.magic == kMagic && header.frame_count > 0;
+  if (valid) {
+    poses_.resize(header.frame_count);
+    valid = fread(poses_.data(), sizeof(gvr::Mat4f), poses_.size(), file) ==
+            poses_.size();
+  }
+  fclose(file);
+  if (!valid) {
+    LOGE("Pose trace %s is invalid.", path.c_str());
+    poses_.clear();
+  }
+  return valid;
+}
+
+bool PoseTrace::Save(const std::string& path) const {
+  const std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    LOGE("Could not create %s.", temp_path.c_str());
+    return false;
+  }
+  const Header header = {kMagic, static_cast<uint32_t>(poses_.size())};
+  const bool written =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(poses_.data(), sizeof(gvr::Mat4f), poses_.size(), file) ==
+          poses_.size();
+  if (fclose(file) != 0 || !written ||
+      rename(temp_path.c_str(), path.c_str()) != 0) {
+    LOGE("Could not write pose trace %s.", path.c_str());
+    remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ndk_hello_vr
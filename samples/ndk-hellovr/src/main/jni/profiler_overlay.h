@@ -0,0 +1,65 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_PROFILER_OVERLAY_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_PROFILER_OVERLAY_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+
+#include <vector>
+
+#include "frame_profiler.h"  // NOLINT
+
+namespace ndk_hello_vr {
+
+// Draws a head-locked bar graph of the recent frame times of a FrameProfiler,
+// for checking performance on the headset.
+//
+// Each frame gets a green bar for its CPU time and an orange bar for the sum
+// of its GPU passes, scaled so that the top of the graph is one frame at
+// 60 Hz. Frames without GPU results have no orange bar.
+class ProfilerOverlay {
+ public:
+  ProfilerOverlay();
+  ~ProfilerOverlay();
+
+  // Creates the GL program. |multiview| must match the framebuffers that
+  // Draw() renders into.
+  void Initialize(bool multiview);
+
+  // Draws the graph in the lower part of the current viewport, on top of
+  // everything that has been drawn there.
+  void Draw(const FrameProfiler& profiler);
+
+ private:
+  // Adds a bar between |bottom| and |top|, which are given in frames.
+  void AddBar(float left, float right, float bottom, float top,
+              const float color[4]);
+
+  GLuint program_;
+  GLint position_attrib_;
+  GLint color_attrib_;
+
+  // Vertex data of the current frame, kept to avoid reallocating it.
+  std::vector<float> vertices_;
+
+  ProfilerOverlay(const ProfilerOverlay&) = delete;
+  ProfilerOverlay& operator=(const ProfilerOverlay&) = delete;
+};
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_PROFILER_OVERLAY_H_  // NOLINT
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_PROGRAM_CACHE_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_PROGRAM_CACHE_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ndk_hello_vr {
+
+// Creates GL programs and keeps their driver binaries in app storage, so that
+// recreating the surface or relaunching the app skips compiling and linking
+// the GLSL.
+//
+// An entry is keyed by a hash of the shader sources, the attribute bindings
+// and the GL_RENDERER and GL_VERSION strings, so a driver update never loads
+// a stale binary. When the driver rejects a binary anyway, the program is
+// compiled from source and the entry is replaced. Program binaries need
+// OpenGL ES 3.0; on older contexts every program is compiled.
+//
+// Only the linked program is cached. Uniform values and uniform block
+// bindings have to be set again after every CreateProgram().
+class ProgramCache {
+ public:
+  // An attribute location to bind before linking.
+  struct AttribLocation {
+    GLuint location;
+    const char* name;
+  };
+
+  ProgramCache();
+
+  // Sets the directory that holds the cache files, such as the app's cache
+  // directory. Until this is called, every program is compiled.
+  void SetDirectory(const std::string& directory);
+
+  // Creates a program from the given shader sources, loading it from the
+  // cache if possible. Call on the GL thread.
+  //
+  // @param vertex_source The source code of the vertex shader.
+  // @param fragment_source The source code of the fragment shader.
+  // @param attrib_locations The attribute locations to bind.
+  // @return The linked program, or 0 if there's an error.
+  GLuint CreateProgram(const char* vertex_source, const char* fragment_source,
+                       const std::vector<AttribLocation>& attrib_locations);
+
+ private:
+  // Returns the key of a program, including the current driver.
+  static uint64_t ComputeKey(
+      const char* vertex_source, const char* fragment_source,
+      const std::vector<AttribLocation>& attrib_locations);
+
+  std::string GetPath(uint64_t key) const;
+
+  // Returns a program created from the cached binary, or 0 on a miss.
+  GLuint Load(uint64_t key) const;
+
+  void Store(uint64_t key, GLuint program) const;
+
+  // Compiles and links a program from source.
+  static GLuint Compile(const char* vertex_source,
+                        const char* fragment_source,
+                        const std::vector<AttribLocation>& attrib_locations,
+                        bool retrievable);
+
+  std::string directory_;
+
+  ProgramCache(const ProgramCache&) = delete;
+  ProgramCache& operator=(const ProgramCache&) = delete;
+};
+
+// Returns the program cache of the render thread.
+ProgramCache& GetProgramCache();
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_PROGRAM_CACHE_H_  // NOLINT
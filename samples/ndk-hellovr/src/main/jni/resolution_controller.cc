@@ -0,0 +1,258 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "resolution_controller.h"  // NOLINT
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "util.h"  // NOLINT
+
+namespace ndk_hello_vr {
+
+namespace {
+
+// The scale is lowered when the GPU needs more than kMaxGpuLoad of a vsync
+// period, and raised when it needs less than kMinGpuLoad. Either way it is
+// moved towards kTargetGpuLoad, by at most kMaxScaleStep at a time.
+constexpr float kMaxGpuLoad = 0.9f;
+constexpr float kMinGpuLoad = 0.7f;
+constexpr float kTargetGpuLoad = 0.8f;
+constexpr float kMaxScaleStep = 0.1f;
+
+constexpr float kMinRenderScale = 0.5f;
+
+// Weight of a new GPU time in the smoothed value.
+constexpr float kGpuTimeSmoothing = 0.2f;
+
+// The buffer is only resized after the render scale has been out of its range
+// for this many consecutive frames (5 seconds at 60 Hz). The buffer is
+// shrunk when less than kMinBufferUse of it (per dimension) is rendered.
+constexpr int kResizeFrames = 300;
+constexpr float kMinBufferUse = 0.75f;
+
+// AThermalStatus values from android/thermal.h.
+constexpr int kThermalStatusModerate = 2;
+constexpr int kThermalStatusSevere = 3;
+constexpr int kThermalStatusCritical = 4;
+
+// The thermal API of libandroid. It was added in API level 30, after the
+// samples' minimum SDK version, so it is looked up at runtime and may be
+// missing.
+struct ThermalFunctions {
+  void* (*acquire_manager)();
+  void (*release_manager)(void* manager);
+  int (*get_current_status)(void* manager);
+  int (*register_listener)(void* manager, void (*callback)(void*, int),
+                           void* data);
+  int (*unregister_listener)(void* manager, void (*callback)(void*, int),
+                             void* data);
+};
+
+ThermalFunctions LoadThermalFunctions() {
+  ThermalFunctions functions = {};
+  void* library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+  if (library == nullptr) {
+    return functions;
+  }
+  functions.acquire_manager =
+      reinterpret_cast<void* (*)()>(dlsym(library, "AThermal_acquireManager"));
+  functions.release_manager = reinterpret_cast<void (*)(void*)>(
+      dlsym(library, "AThermal_releaseManager"));
+  functions.get_current_status = reinterpret_cast<int (*)(void*)>(
+      dlsym(library, "AThermal_getCurrentStatus"));
+  functions.register_listener =
+      reinterpret_cast<int (*)(void*, void (*)(void*, int), void*)>(
+          dlsym(library, "AThermal_registerThermalStatusListener"));
+  functions.unregister_listener =
+      reinterpret_cast<int (*)(void*, void (*)(void*, int), void*)>(
+          dlsym(library, "AThermal_unregisterThermalStatusListener"));
+  if (functions.acquire_manager == nullptr ||
+      functions.release_manager == nullptr ||
+      functions.get_current_status == nullptr ||
+      functions.register_listener == nullptr ||
+      functions.unregister_listener == nullptr) {
+    functions = {};
+  }
+  return functions;
+}
+
+const ThermalFunctions& GetThermal() {
+  static const ThermalFunctions functions = LoadThermalFunctions();
+  return functions;
+}
+
+}  // anonymous namespace
+
+ResolutionController::ResolutionController()
+    : thermal_manager_(nullptr), thermal_status_(0) {
+  Reset();
+  const ThermalFunctions& thermal = GetThermal();
+  if (thermal.acquire_manager == nullptr) {
+    LOGD("Thermal API is not available, not limiting the render scale.");
+    return;
+  }
+  thermal_manager_ = thermal.acquire_manager();
+  if (thermal_manager_ == nullptr) {
+    return;
+  }
+  thermal_status_ = std::max(thermal.get_current_status(thermal_manager_), 0);
+  // Listening avoids a binder call on the GL thread every frame.
+  if (thermal.register_listener(thermal_manager_, &OnThermalStatusChanged,
+                                this) != 0) {
+    LOGE("Could not listen for thermal status changes.");
+  }
+}
+
+ResolutionController::~ResolutionController() {
+  if (thermal_manager_ != nullptr) {
+    const ThermalFunctions& thermal = GetThermal();
+    thermal.unregister_listener(thermal_manager_, &OnThermalStatusChanged,
+                                this);
+    thermal.release_manager(thermal_manager_);
+  }
+}
+
+void ResolutionController::Reset() {
+  render_scale_ = 1.0f;
+  buffer_scale_ = 1.0f;
+  smoothed_gpu_ns_ = 0.0f;
+  last_measured_frame_ = -1;
+  first_frame_at_scale_ = 0;
+  frames_buffer_too_large_ = 0;
+  frames_buffer_too_small_ = 0;
+}
+
+void ResolutionController::OnThermalStatusChanged(void* data, int status) {
+  static_cast<ResolutionController*>(data)->thermal_status_ =
+      std::max(status, 0);
+}
+
+float ResolutionController::GetThermalScaleLimit() const {
+  const int status = thermal_status_.load(std::memory_order_relaxed);
+  if (status >= kThermalStatusCritical) {
+    return kMinRenderScale;
+  } else if (status >= kThermalStatusSevere) {
+    return 0.7f;
+  } else if (status >= kThermalStatusModerate) {
+    return 0.85f;
+  }
+  return 1.0f;
+}
+
+bool ResolutionController::Update(const FrameProfiler& profiler,
+                                  float frame_budget_ns) {
+  // Use the newest frame with GPU results that was rendered at the current
+  // scale. The results of a frame arrive a few frames after it.
+  FrameTimings timings;
+  int64_t next_frame = 0;
+  for (int frames_ago = 0; profiler.GetTimings(frames_ago, &timings);
+       ++frames_ago) {
+    if (frames_ago == 0) {
+      next_frame = timings.frame_index + 1;
+    }
+    if (timings.frame_index <= last_measured_frame_ ||
+        timings.frame_index < first_frame_at_scale_) {
+      break;
+    }
+    int64_t gpu_ns = 0;
+    bool has_gpu_timing = false;
+    for (const int64_t pass_ns : timings.gpu_pass_ns) {
+      if (pass_ns >= 0) {
+        gpu_ns += pass_ns;
+        has_gpu_timing = true;
+      }
+    }
+    if (has_gpu_timing) {
+      last_measured_frame_ = timings.frame_index;
+      const float frame_gpu_ns = static_cast<float>(gpu_ns);
+      smoothed_gpu_ns_ =
+          smoothed_gpu_ns_ == 0.0f
+              ? frame_gpu_ns
+              : smoothed_gpu_ns_ +
+                    kGpuTimeSmoothing * (frame_gpu_ns - smoothed_gpu_ns_);
+      break;
+    }
+  }
+
+  const float scale_limit = GetThermalScaleLimit();
+  float scale = render_scale_;
+  if (last_measured_frame_ < 0) {
+    // Without GPU timings, only the thermal status is known.
+    scale = scale_limit;
+  } else if (smoothed_gpu_ns_ > frame_budget_ns * kMaxGpuLoad ||
+             (smoothed_gpu_ns_ > 0.0f &&
+              smoothed_gpu_ns_ < frame_budget_ns * kMinGpuLoad)) {
+    // GPU time is roughly proportional to the number of pixels.
+    scale *= std::sqrt(frame_budget_ns * kTargetGpuLoad / smoothed_gpu_ns_);
+    scale = std::min(std::max(scale, render_scale_ * (1.0f - kMaxScaleStep)),
+                     render_scale_ * (1.0f + kMaxScaleStep));
+  }
+  scale = std::min(std::max(scale, kMinRenderScale), scale_limit);
+
+  bool resize_buffer = false;
+  if (scale > buffer_scale_) {
+    if (++frames_buffer_too_small_ >= kResizeFrames) {
+      buffer_scale_ = scale_limit;
+      resize_buffer = true;
+    }
+    scale = std::min(scale, buffer_scale_);
+  } else {
+    frames_buffer_too_small_ = 0;
+  }
+  if (scale < buffer_scale_ * kMinBufferUse) {
+    if (++frames_buffer_too_large_ >= kResizeFrames) {
+      buffer_scale_ = scale;
+      resize_buffer = true;
+    }
+  } else {
+    frames_buffer_too_large_ = 0;
+  }
+  if (resize_buffer) {
+    LOGD("Resizing the render buffer to scale %.2f.", buffer_scale_);
+    frames_buffer_too_small_ = 0;
+    frames_buffer_too_large_ = 0;
+  }
+
+  if (scale != render_scale_) {
+    // The smoothed time belongs to the old scale.
+    render_scale_ = scale;
+    smoothed_gpu_ns_ = 0.0f;
+    first_frame_at_scale_ = next_frame;
+  }
+  return resize_buffer;
+}
+
+gvr::Sizei ResolutionController::GetBufferSize(
+    const gvr::Sizei& recommended_size) const {
+  gvr::Sizei size;
+  size.width =
+      std::max(static_cast<int>(recommended_size.width * buffer_scale_), 1);
+  size.height =
+      std::max(static_cast<int>(recommended_size.height * buffer_scale_), 1);
+  return size;
+}
+
+gvr::Rectf ResolutionController::ScaleSourceUv(const gvr::Rectf& uv) const {
+  const float scale = render_scale_ / buffer_scale_;
+  gvr::Rectf result = {uv.left * scale, uv.right * scale, uv.bottom * scale,
+                       uv.top * scale};
+  return result;
+}
+
+}  // namespace ndk_hello_vr
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_RESOURCE_REGISTRY_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_RESOURCE_REGISTRY_H_  // NOLINT
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace ndk_hello_vr {
+
+// How the memory of a resource is counted in ResourceRegistry::Totals.
+enum class ResourceKind : uint8_t {
+  kMesh,
+  kTexture,
+  // Render targets, such as the buffers of the swap chain.
+  kBuffer,
+  // CPU-side copies kept to speed up reloads, such as decoded images.
+  kCache,
+};
+
+// Records the CPU and GPU memory held by the sample's meshes, textures and
+// buffers, and keeps the GPU memory of meshes and textures under a budget.
+//
+// Meshes and textures record their size whenever they upload, and register
+// how to evict and reload them. DrawList marks the items of every frame as
+// used, and EnforceBudget() evicts the least recently used resources until
+// the rest fit. An evicted resource is queued for reloading the next time it
+// is used, so it is missing for a few frames instead of the process being
+// killed for its memory.
+//
+// All methods must be called on the GL thread.
+class ResourceRegistry {
+ public:
+  static constexpr int kKindCount = 4;
+
+  struct Totals {
+    size_t cpu_bytes[kKindCount];
+    size_t gpu_bytes[kKindCount];
+    // The resources that are evicted at the moment.
+    size_t evicted_count;
+
+    size_t GetCpuBytes() const;
+    size_t GetGpuBytes() const;
+  };
+
+  ResourceRegistry();
+
+  // Starts a new frame for MarkUsed().
+  void BeginFrame();
+
+  // Records the current memory use of |resource|, replacing the previous
+  // record.
+  //
+  // @param name A name for logging, such as the asset path.
+  void Track(const void* resource, ResourceKind kind, const std::string& name,
+             size_t cpu_bytes, size_t gpu_bytes);
+
+  // Lets EnforceBudget() evict |resource|. |evict| releases its GPU memory
+  // and must Track() the remaining size; |reload| queues it to be loaded
+  // again. Both stay registered until Untrack().
+  void SetEvictable(const void* resource, std::function<void()> evict,
+                    std::function<void()> reload);
+
+  // Forgets |resource|, such as when it is destroyed.
+  void Untrack(const void* resource);
+
+  // Marks |resource| as used in the current frame, and queues its reload if
+  // it was evicted. Resources that were never tracked are ignored.
+  void MarkUsed(const void* resource);
+
+  // Evicts the least recently used meshes and textures, except those used in
+  // the current frame, until their GPU memory is at most |gpu_budget_bytes|.
+  // A budget of 0 evicts everything that was not used in the current frame.
+  //
+  // @return The number of resources that were evicted.
+  size_t EnforceBudget(size_t gpu_budget_bytes);
+
+  Totals GetTotals() const;
+
+  // Logs GetTotals() with |reason|.
+  void LogTotals(const char* reason) const;
+
+ private:
+  struct Entry {
+    ResourceKind kind;
+    std::string name;
+    size_t cpu_bytes;
+    size_t gpu_bytes;
+    int64_t last_used_frame;
+    bool evicted;
+    std::function<void()> evict;
+    std::function<void()> reload;
+  };
+
+  std::unordered_map<const void*, Entry> entries_;
+  int64_t frame_;
+
+  ResourceRegistry(const ResourceRegistry&) = delete;
+  ResourceRegistry& operator=(const ResourceRegistry&) = delete;
+};
+
+// Returns the registry of the render thread.
+ResourceRegistry& GetResourceRegistry();
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_RESOURCE_REGISTRY_H_  // NOLINT
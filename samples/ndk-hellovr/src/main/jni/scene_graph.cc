@@ -0,0 +1,94 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "scene_graph.h"  // NOLINT
+
+#include <algorithm>
+#include <cstring>
+
+#include "util.h"  // NOLINT
+
+namespace ndk_hello_vr {
+
+SceneGraph::SceneGraph() : order_dirty_(false) {}
+
+int SceneGraph::AddNode(int parent, const gvr::Mat4f& local) {
+  const int node = GetNodeCount();
+  parents_.push_back(parent);
+  locals_.push_back(local);
+  worlds_.push_back(local);
+  dirty_.push_back(1);
+  changed_.push_back(0);
+  order_.push_back(node);
+  return node;
+}
+
+void SceneGraph::SetLocalTransform(int node, const gvr::Mat4f& local) {
+  if (std::memcmp(&locals_[node], &local, sizeof(local)) != 0) {
+    locals_[node] = local;
+    dirty_[node] = 1;
+  }
+}
+
+void SceneGraph::SetParent(int node, int parent, const gvr::Mat4f& local) {
+  if (parents_[node] != parent) {
+    parents_[node] = parent;
+    order_dirty_ = true;
+  }
+  locals_[node] = local;
+  dirty_[node] = 1;
+}
+
+void SceneGraph::Detach(int node) {
+  SetParent(node, -1, worlds_[node]);
+}
+
+int SceneGraph::Update() {
+  if (order_dirty_) {
+    SortNodes();
+  }
+  int updated_count = 0;
+  for (const int node : order_) {
+    const int parent = parents_[node];
+    const bool update = dirty_[node] || (parent >= 0 && changed_[parent]);
+    changed_[node] = update;
+    if (!update) {
+      continue;
+    }
+    worlds_[node] =
+        parent < 0 ? locals_[node] : MatrixMul(worlds_[parent], locals_[node]);
+    dirty_[node] = 0;
+    ++updated_count;
+  }
+  return updated_count;
+}
+
+void SceneGraph::SortNodes() {
+  // The hierarchy is shallow and rarely changes, so walking up from every
+  // node is cheap enough.
+  std::vector<int> depths(parents_.size(), 0);
+  for (size_t node = 0; node < parents_.size(); ++node) {
+    for (int parent = parents_[node]; parent >= 0; parent = parents_[parent]) {
+      ++depths[node];
+    }
+  }
+  std::stable_sort(order_.begin(), order_.end(), [&depths](int a, int b) {
+    return depths[a] < depths[b];
+  });
+  order_dirty_ = false;
+}
+
+}  // namespace ndk_hello_vr
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_SCENE_GRAPH_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_SCENE_GRAPH_H_  // NOLINT
+
+#include <cstdint>
+#include <vector>
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+namespace ndk_hello_vr {
+
+// A flat hierarchy of transforms whose world matrices are only recomputed
+// when they change.
+//
+// Each node has a local transform relative to its parent, or to the world if
+// it has none. Nodes are referred to by the index AddNode() returns, and
+// their state is stored as separate arrays, which Update() walks in one pass
+// with every parent before its children. A node is recomputed if its own
+// local transform was set to a new value or its parent was recomputed, so a
+// static node costs nothing after its first frame.
+//
+// The world matrices are valid from Update() until the next change, so
+// culling, picking and drawing all see the same transforms in a frame.
+class SceneGraph {
+ public:
+  SceneGraph();
+
+  // Adds a node with the given local transform and returns its index.
+  //
+  // @param parent The index of the parent node, or -1 for a root.
+  int AddNode(int parent, const gvr::Mat4f& local);
+
+  // Sets the local transform of |node|. Setting the current value again
+  // doesn't mark the node as changed.
+  void SetLocalTransform(int node, const gvr::Mat4f& local);
+
+  // Moves |node| under |parent|, or makes it a root if |parent| is -1.
+  // |parent| must not be |node| or one of its descendants.
+  //
+  // @param local The new local transform, relative to |parent|.
+  void SetParent(int node, int parent, const gvr::Mat4f& local);
+
+  // Makes |node| a root that stays where it was in the last Update().
+  void Detach(int node);
+
+  // Recomputes the world transforms of the changed nodes and their
+  // descendants.
+  //
+  // @return The number of nodes that were recomputed.
+  int Update();
+
+  int GetNodeCount() const { return static_cast<int>(parents_.size()); }
+  int GetParent(int node) const { return parents_[node]; }
+  const gvr::Mat4f& GetLocalTransform(int node) const { return locals_[node]; }
+
+  // Returns the world transform of |node| as of the last Update().
+  const gvr::Mat4f& GetWorldTransform(int node) const { return worlds_[node]; }
+
+ private:
+  // Sorts |order_| by depth, so that parents come before their children.
+  void SortNodes();
+
+  std::vector<int> parents_;
+  std::vector<gvr::Mat4f> locals_;
+  std::vector<gvr::Mat4f> worlds_;
+  // Whether the local transform was set since the last Update().
+  std::vector<uint8_t> dirty_;
+  // Whether the world transform was recomputed in the last Update().
+  std::vector<uint8_t> changed_;
+  // The node indices in the order Update() visits them.
+  std::vector<int> order_;
+  // Whether a node was moved since |order_| was sorted. Added nodes come
+  // after their parents anyway.
+  bool order_dirty_;
+};
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_SCENE_GRAPH_H_  // NOLINT
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_THREAD_POOL_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_THREAD_POOL_H_  // NOLINT
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ndk_hello_vr {
+
+// A fixed set of worker threads running posted tasks in FIFO order.
+class ThreadPool {
+ public:
+  // Starts |thread_count| worker threads.
+  //
+  // @param on_thread_start If set, runs on each worker before its first task,
+  //     e.g. to attach the thread to the Java VM.
+  // @param on_thread_exit If set, runs on each worker after its last task.
+  ThreadPool(size_t thread_count,
+             std::function<void()> on_thread_start = nullptr,
+             std::function<void()> on_thread_exit = nullptr);
+
+  // Discards the tasks that have not started yet, waits for the running ones
+  // to finish and joins the workers.
+  ~ThreadPool();
+
+  // Queues |task| to run on one of the workers. Safe to call from any thread.
+  void Post(std::function<void()> task);
+
+ private:
+  void WorkerLoop();
+
+  std::function<void()> on_thread_start_;
+  std::function<void()> on_thread_exit_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_;
+
+  std::vector<std::thread> threads_;
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+};
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_THREAD_POOL_H_  // NOLINT
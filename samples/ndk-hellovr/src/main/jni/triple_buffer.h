@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_TRIPLE_BUFFER_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_TRIPLE_BUFFER_H_  // NOLINT
+
+#include <atomic>
+#include <cstdint>
+
+namespace ndk_hello_vr {
+
+// Hands the latest value of a T from one producer thread to one consumer
+// thread without locks and without either side ever waiting for the other.
+//
+// Each side owns one of three slots, and the third holds the most recently
+// published value. Publishing and reading swap a slot with that third one
+// through a single atomic exchange, so the consumer always sees a complete
+// value. Values that are overwritten before the consumer reads them are
+// dropped, which is what a per-frame state handoff wants.
+template <typename T>
+class TripleBuffer {
+ public:
+  // All three slots start out as |initial|, which is what Read() returns
+  // until the first Write().
+  explicit TripleBuffer(const T& initial)
+      : slots_{initial, initial, initial},
+        shared_(kInitialSharedSlot),
+        write_slot_(kInitialWriteSlot),
+        read_slot_(kInitialReadSlot) {}
+
+  // Publishes |value|. Must only be called by the producer.
+  void Write(const T& value) {
+    slots_[write_slot_] = value;
+    const uint8_t previous =
+        shared_.exchange(write_slot_ | kNewValueBit, std::memory_order_acq_rel);
+    write_slot_ = previous & kSlotMask;
+  }
+
+  // Returns the most recently published value. The reference stays valid
+  // until the next call. Must only be called by the consumer.
+  const T& Read() {
+    if (shared_.load(std::memory_order_relaxed) & kNewValueBit) {
+      const uint8_t previous =
+          shared_.exchange(read_slot_, std::memory_order_acq_rel);
+      read_slot_ = previous & kSlotMask;
+    }
+    return slots_[read_slot_];
+  }
+
+ private:
+  static constexpr uint8_t kSlotMask = 0x3;
+  static constexpr uint8_t kNewValueBit = 0x4;
+  static constexpr uint8_t kInitialWriteSlot = 0;
+  static constexpr uint8_t kInitialSharedSlot = 1;
+  static constexpr uint8_t kInitialReadSlot = 2;
+
+  T slots_[3];
+  // Index of the slot owned by neither side, plus kNewValueBit if it holds a
+  // value that the consumer has not taken yet.
+  std::atomic<uint8_t> shared_;
+  uint8_t write_slot_;
+  uint8_t read_slot_;
+
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+};
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_TRIPLE_BUFFER_H_  // NOLINT
@@ -15,72 +15,25 @@
  */
 #include "util.h"  // NOLINT
 
-#include <string.h>  // Needed for strtok_r and strstr
+#include <EGL/egl.h>
+#include <string.h>  // Needed for memcpy and strstr
 #include <unistd.h>
 #include <cmath>
+#include <cstddef>
 #include <random>
-#include <sstream>
 #include <string>
 
+#include "gl_state_cache.h"     // NOLINT
+#include "mesh_format.h"        // NOLINT
+#include "obj_loader.h"         // NOLINT
+#include "resource_registry.h"  // NOLINT
+#include "simd_math.h"          // NOLINT
+#include "texture_loader.h"     // NOLINT
+
 namespace ndk_hello_vr {
 
 namespace {
 
-class RunAtEndOfScope {
- public:
-  RunAtEndOfScope(std::function<void()> function) : function_(function) {}
-  ~RunAtEndOfScope() { function_(); }
-
- private:
-  std::function<void()> function_;
-};
-
-// Loads a png file from assets folder and then assigns it to the OpenGL target.
-// This method must be called from the renderer thread since it will result in
-// OpenGL calls to assign the image to the texture target.
-//
-// @param env The JNIEnv to use.
-// @param target, openGL texture target to load the image into.
-// @param path, path to the file, relative to the assets folder.
-// @return true if png is loaded correctly, otherwise false.
-bool LoadPngFromAssetManager(JNIEnv* env, jobject java_asset_mgr, int target,
-                             const std::string& path) {
-  jclass bitmap_factory_class =
-      env->FindClass("android/graphics/BitmapFactory");
-  jclass asset_manager_class =
-      env->FindClass("android/content/res/AssetManager");
-  jclass gl_utils_class = env->FindClass("android/opengl/GLUtils");
-  jmethodID decode_stream_method = env->GetStaticMethodID(
-      bitmap_factory_class, "decodeStream",
-      "(Ljava/io/InputStream;)Landroid/graphics/Bitmap;");
-  jmethodID open_method = env->GetMethodID(
-      asset_manager_class, "open", "(Ljava/lang/String;)Ljava/io/InputStream;");
-  jmethodID tex_image_2d_method = env->GetStaticMethodID(
-      gl_utils_class, "texImage2D", "(IILandroid/graphics/Bitmap;I)V");
-
-  jstring j_path = env->NewStringUTF(path.c_str());
-  RunAtEndOfScope cleanup_j_path([&] {
-    if (j_path) {
-      env->DeleteLocalRef(j_path);
-    }
-  });
-
-  jobject image_stream =
-      env->CallObjectMethod(java_asset_mgr, open_method, j_path);
-  jobject image_obj = env->CallStaticObjectMethod(
-      bitmap_factory_class, decode_stream_method, image_stream);
-  if (env->ExceptionOccurred() != nullptr) {
-    LOGE("Java exception while loading image");
-    env->ExceptionClear();
-    image_obj = nullptr;
-    return false;
-  }
-
-  env->CallStaticVoidMethod(gl_utils_class, tex_image_2d_method, target, 0,
-                            image_obj, 0);
-  return true;
-}
-
 // Loads obj file from assets folder from the app.
 //
 // This sample uses the .obj format since .obj is straightforward to parse and
@@ -90,23 +43,10 @@ bool LoadPngFromAssetManager(JNIEnv* env, jobject java_asset_mgr, int target,
 //
 // @param mgr, AAssetManager pointer.
 // @param file_name, name of the obj file.
-// @param out_vertices, output vertices.
-// @param out_normals, output normals.
-// @param out_uv, output texture UV coordinates.
-// @param out_indices, output triangle indices.
+// @param mesh, output indexed mesh. Normals are not loaded.
 // @return true if obj is loaded correctly, otherwise false.
 bool LoadObjFile(AAssetManager* mgr, const std::string& file_name,
-                 std::vector<GLfloat>* out_vertices,
-                 std::vector<GLfloat>* out_normals,
-                 std::vector<GLfloat>* out_uv,
-                 std::vector<GLushort>* out_indices) {
-  std::vector<GLfloat> temp_positions;
-  std::vector<GLfloat> temp_normals;
-  std::vector<GLfloat> temp_uvs;
-  std::vector<GLushort> vertex_indices;
-  std::vector<GLushort> normal_indices;
-  std::vector<GLushort> uv_indices;
-
+                 ObjMesh* mesh) {
   // If the file hasn't been uncompressed, load it to the internal storage.
   // Note that AAsset_openFileDescriptor doesn't support compressed
   // files (.obj).
@@ -128,178 +68,20 @@ bool LoadObjFile(AAssetManager* mgr, const std::string& file_name,
     return false;
   }
 
-  std::stringstream file_string_stream(file_buffer);
-
-  while (file_string_stream && !file_string_stream.eof()) {
-    char line_header[128];
-    file_string_stream.getline(line_header, 128);
-
-    if (line_header[0] == '\0') {
-      continue;
-    } else if (line_header[0] == 'v' && line_header[1] == 'n') {
-      // Parse vertex normal.
-      GLfloat normal[3];
-      int matches = sscanf(line_header, "vn %f %f %f\n", &normal[0], &normal[1],
-                           &normal[2]);
-      if (matches != 3) {
-        LOGE("Format of 'vn float float float' required for each normal line");
-        return false;
-      }
-
-      temp_normals.push_back(normal[0]);
-      temp_normals.push_back(normal[1]);
-      temp_normals.push_back(normal[2]);
-    } else if (line_header[0] == 'v' && line_header[1] == 't') {
-      // Parse texture uv.
-      GLfloat uv[2];
-      int matches = sscanf(line_header, "vt %f %f\n", &uv[0], &uv[1]);
-      if (matches != 2) {
-        LOGE("Format of 'vt float float' required for each texture uv line");
-        return false;
-      }
-
-      temp_uvs.push_back(uv[0]);
-      temp_uvs.push_back(uv[1]);
-    } else if (line_header[0] == 'v') {
-      // Parse vertex.
-      GLfloat vertex[3];
-      int matches = sscanf(line_header, "v %f %f %f\n", &vertex[0], &vertex[1],
-                           &vertex[2]);
-      if (matches != 3) {
-        LOGE("Format of 'v float float float' required for each vertex line");
-        return false;
-      }
-
-      temp_positions.push_back(vertex[0]);
-      temp_positions.push_back(vertex[1]);
-      temp_positions.push_back(vertex[2]);
-    } else if (line_header[0] == 'f') {
-      // Actual faces information starts from the second character.
-      char* face_line = &line_header[1];
-
-      unsigned int vertex_index[4];
-      unsigned int normal_index[4];
-      unsigned int texture_index[4];
-
-      std::vector<char*> per_vertex_info_list;
-      char* per_vertex_info_list_c_str;
-      char* face_line_iter = face_line;
-      while ((per_vertex_info_list_c_str =
-                  strtok_r(face_line_iter, " ", &face_line_iter))) {
-        // Divide each faces information into individual positions.
-        per_vertex_info_list.push_back(per_vertex_info_list_c_str);
-      }
-
-      bool is_normal_available = false;
-      bool is_uv_available = false;
-      for (int i = 0; i < per_vertex_info_list.size(); ++i) {
-        char* per_vertex_info;
-        int per_vertex_info_count = 0;
-
-        const bool is_vertex_normal_only_face =
-            strstr(per_vertex_info_list[i], "//") != nullptr;
-
-        char* per_vertex_info_iter = per_vertex_info_list[i];
-        while ((per_vertex_info = strtok_r(per_vertex_info_iter, "/",
-                                           &per_vertex_info_iter))) {
-          // write only normal and vert values.
-          switch (per_vertex_info_count) {
-            case 0:
-              // Write to vertex indices.
-              vertex_index[i] = atoi(per_vertex_info);  // NOLINT
-              break;
-            case 1:
-              // Write to texture indices.
-              if (is_vertex_normal_only_face) {
-                normal_index[i] = atoi(per_vertex_info);  // NOLINT
-                is_normal_available = true;
-              } else {
-                texture_index[i] = atoi(per_vertex_info);  // NOLINT
-                is_uv_available = true;
-              }
-              break;
-            case 2:
-              // Write to normal indices.
-              if (!is_vertex_normal_only_face) {
-                normal_index[i] = atoi(per_vertex_info);  // NOLINT
-                is_normal_available = true;
-                break;
-              }
-              [[clang::fallthrough]];
-              // Fallthrough to error case because if there's no texture coords,
-              // there should only be 2 indices per vertex (position and
-              // normal).
-            default:
-              // Error formatting.
-              LOGE(
-                  "Format of 'f int/int/int int/int/int int/int/int "
-                  "(int/int/int)' "
-                  "or 'f int//int int//int int//int (int//int)' required for "
-                  "each face");
-              return false;
-          }
-          per_vertex_info_count++;
-        }
-      }
-
-      const int vertices_count = per_vertex_info_list.size();
-      for (int i = 2; i < vertices_count; ++i) {
-        vertex_indices.push_back(vertex_index[0] - 1);
-        vertex_indices.push_back(vertex_index[i - 1] - 1);
-        vertex_indices.push_back(vertex_index[i] - 1);
-
-        if (is_normal_available) {
-          normal_indices.push_back(normal_index[0] - 1);
-          normal_indices.push_back(normal_index[i - 1] - 1);
-          normal_indices.push_back(normal_index[i] - 1);
-        }
-
-        if (is_uv_available) {
-          uv_indices.push_back(texture_index[0] - 1);
-          uv_indices.push_back(texture_index[i - 1] - 1);
-          uv_indices.push_back(texture_index[i] - 1);
-        }
-      }
-    }
-  }
-
-  const bool is_normal_available = !normal_indices.empty();
-  const bool is_uv_available = !uv_indices.empty();
-
-  if (is_normal_available && normal_indices.size() != vertex_indices.size()) {
-    LOGE("Obj normal indices does not equal to vertex indices.");
-    return false;
-  }
-
-  if (is_uv_available && uv_indices.size() != vertex_indices.size()) {
-    LOGE("Obj UV indices does not equal to vertex indices.");
+  std::string error;
+  if (!ParseObj(file_buffer.data(), file_buffer.size(),
+                /*keep_normals=*/false, mesh, &error)) {
+    LOGE("Failed to parse %s: %s", file_name.c_str(), error.c_str());
     return false;
   }
-
-  for (unsigned int i = 0; i < vertex_indices.size(); i++) {
-    unsigned int vertex_index = vertex_indices[i];
-    out_vertices->push_back(temp_positions[vertex_index * 3]);
-    out_vertices->push_back(temp_positions[vertex_index * 3 + 1]);
-    out_vertices->push_back(temp_positions[vertex_index * 3 + 2]);
-    out_indices->push_back(i);
-
-    if (is_normal_available) {
-      unsigned int normal_index = normal_indices[i];
-      out_normals->push_back(temp_normals[normal_index * 3]);
-      out_normals->push_back(temp_normals[normal_index * 3 + 1]);
-      out_normals->push_back(temp_normals[normal_index * 3 + 2]);
-    }
-
-    if (is_uv_available) {
-      unsigned int uv_index = uv_indices[i];
-      out_uv->push_back(temp_uvs[uv_index * 2]);
-      out_uv->push_back(temp_uvs[uv_index * 2 + 1]);
-    }
-  }
-
   return true;
 }
 
+bool HasSuffix(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
 float VectorNorm(const std::array<float, 4>& vec) {
   return std::sqrt(vec[0] * vec[0] + vec[1] * vec[1] + vec[2] * vec[2]);
 }
@@ -313,40 +95,40 @@ float VectorDotProduct(const std::array<float, 4>& vec1,
   return product;
 }
 
+// Returns the GPU memory of |image| once uploaded, including the mip chain
+// that GL generates for a single uncompressed level.
+size_t GetGpuBytes(const TextureImage& image) {
+  size_t bytes = 0;
+  for (const TextureImage::Level& level : image.levels) {
+    bytes += level.data.size();
+  }
+  if (image.levels.size() == 1 && image.compressed_format == 0) {
+    bytes += bytes / 3;
+  }
+  return bytes;
+}
+
 }  // anonymous namespace
 
 std::array<float, 16> MatrixToGLArray(const gvr::Mat4f& matrix) {
   // Note that this performs a *transpose* to a column-major matrix array, as
   // expected by GL.
   std::array<float, 16> result;
-  for (int i = 0; i < 4; ++i) {
-    for (int j = 0; j < 4; ++j) {
-      result[j * 4 + i] = matrix.m[i][j];
-    }
-  }
+  TransposeMat4(&matrix.m[0][0], result.data());
   return result;
 }
 
 std::array<float, 32> MatrixPairToGLArray(const gvr::Mat4f matrix[]) {
   std::array<float, 32> result;
-  for (int i = 0; i < 4; ++i) {
-    for (int j = 0; j < 4; ++j) {
-      result[j * 4 + i] = matrix[0].m[i][j];
-      result[16 + j * 4 + i] = matrix[1].m[i][j];
-    }
-  }
+  TransposeMat4(&matrix[0].m[0][0], result.data());
+  TransposeMat4(&matrix[1].m[0][0], result.data() + 16);
   return result;
 }
 
 std::array<float, 4> MatrixVectorMul(const gvr::Mat4f& matrix,
                                      const std::array<float, 4>& vec) {
   std::array<float, 4> result;
-  for (int i = 0; i < 4; ++i) {
-    result[i] = 0;
-    for (int k = 0; k < 4; ++k) {
-      result[i] += matrix.m[i][k] * vec[k];
-    }
-  }
+  MultiplyMat4Vec4(&matrix.m[0][0], vec.data(), result.data());
   return result;
 }
 
@@ -359,14 +141,7 @@ gvr::Mat4f GetTranslationMatrix(const gvr::Vec3f& translation) {
 
 gvr::Mat4f MatrixMul(const gvr::Mat4f& matrix1, const gvr::Mat4f& matrix2) {
   gvr::Mat4f result;
-  for (int i = 0; i < 4; ++i) {
-    for (int j = 0; j < 4; ++j) {
-      result.m[i][j] = 0.0f;
-      for (int k = 0; k < 4; ++k) {
-        result.m[i][j] += matrix1.m[i][k] * matrix2.m[k][j];
-      }
-    }
-  }
+  MultiplyMat4(&matrix1.m[0][0], &matrix2.m[0][0], &result.m[0][0]);
   return result;
 }
 
@@ -408,6 +183,14 @@ gvr::Mat4f PerspectiveMatrixFromView(const gvr::Rectf& fov, float z_near,
   return result;
 }
 
+gvr::Rectf WidenFov(const gvr::Rectf& fov, float degrees) {
+  const auto widen = [degrees](float angle) {
+    return std::fmin(angle + degrees, 89.0f);
+  };
+  return {widen(fov.left), widen(fov.right), widen(fov.bottom),
+          widen(fov.top)};
+}
+
 gvr::Rectf ModulateRect(const gvr::Rectf& rect, float width, float height) {
   gvr::Rectf result = {rect.left * width, rect.right * width,
                        rect.bottom * height, rect.top * height};
@@ -439,6 +222,30 @@ int RandomUniformInt(int max_val) {
   return random_distribution(random_generator);
 }
 
+bool IsGLES3Context() {
+  const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  // The version string has the form "OpenGL ES N.M <vendor-specific>".
+  int major = 0;
+  return version != nullptr && sscanf(version, "OpenGL ES %d", &major) == 1 &&
+         major >= 3;
+}
+
+bool HasGLExtension(const char* extension) {
+  const char* extensions =
+      reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+  if (extensions == nullptr) return false;
+  // Match whole words only, since some names are prefixes of others.
+  const size_t length = strlen(extension);
+  for (const char* match = strstr(extensions, extension); match != nullptr;
+       match = strstr(match + length, extension)) {
+    const bool starts_word = match == extensions || match[-1] == ' ';
+    const bool ends_word = match[length] == ' ' || match[length] == '\0';
+    if (starts_word && ends_word) return true;
+  }
+  return false;
+}
+
+#ifndef NDEBUG
 void CheckGLError(const char* label) {
   int gl_error = glGetError();
   if (gl_error != GL_NO_ERROR) {
@@ -447,6 +254,33 @@ void CheckGLError(const char* label) {
     abort();
   }
 }
+#endif  // NDEBUG
+
+void DiscardDepthStencil() {
+  // The way to discard, for the context it was chosen in.
+  static EGLContext context = EGL_NO_CONTEXT;
+  static bool invalidate_supported = false;
+  static PFNGLDISCARDFRAMEBUFFEREXTPROC discard_framebuffer = nullptr;
+
+  const EGLContext current_context = eglGetCurrentContext();
+  if (current_context != context) {
+    context = current_context;
+    invalidate_supported = IsGLES3Context();
+    discard_framebuffer =
+        !invalidate_supported && HasGLExtension("GL_EXT_discard_framebuffer")
+            ? reinterpret_cast<PFNGLDISCARDFRAMEBUFFEREXTPROC>(
+                  eglGetProcAddress("glDiscardFramebufferEXT"))
+            : nullptr;
+  }
+  // Attachments that the framebuffer doesn't have are ignored.
+  static const GLenum kAttachments[] = {GL_DEPTH_ATTACHMENT,
+                                        GL_STENCIL_ATTACHMENT};
+  if (invalidate_supported) {
+    glInvalidateFramebuffer(GL_FRAMEBUFFER, 2, kAttachments);
+  } else if (discard_framebuffer != nullptr) {
+    discard_framebuffer(GL_FRAMEBUFFER, 2, kAttachments);
+  }
+}
 
 gvr::Sizei HalfPixelCount(const gvr::Sizei& in) {
   // Scale each dimension by sqrt(2)/2 ~= 7/10ths.
@@ -518,63 +352,490 @@ GLuint LoadGLShader(GLenum type, const char* shader_source) {
 }
 
 TexturedMesh::TexturedMesh()
-    : vertices_(), uv_(), indices_(), position_attrib_(0), uv_attrib_(0) {}
+    : vertex_buffer_(0),
+      index_buffer_(0),
+      vertex_array_(0),
+      index_count_(0),
+      index_type_(GL_UNSIGNED_SHORT),
+      vertex_stride_(0),
+      uv_type_(GL_FLOAT),
+      position_attrib_(0),
+      uv_attrib_(0),
+      bounds_min_{0.0f, 0.0f, 0.0f},
+      bounds_max_{0.0f, 0.0f, 0.0f},
+      bounding_sphere_center_{0.0f, 0.0f, 0.0f},
+      bounding_sphere_radius_(0.0f) {}
+
+TexturedMesh::~TexturedMesh() {
+  Release();
+  GetResourceRegistry().Untrack(this);
+}
+
+void TexturedMesh::Release() {
+  if (vertex_array_ != 0) {
+    glDeleteVertexArrays(1, &vertex_array_);
+    vertex_array_ = 0;
+  }
+  if (vertex_buffer_ != 0) {
+    glDeleteBuffers(1, &vertex_buffer_);
+    vertex_buffer_ = 0;
+  }
+  if (index_buffer_ != 0) {
+    glDeleteBuffers(1, &index_buffer_);
+    index_buffer_ = 0;
+  }
+  index_count_ = 0;
+  GetResourceRegistry().Track(this, ResourceKind::kMesh, name_, 0, 0);
+}
+
+void TexturedMesh::Forget() {
+  vertex_array_ = 0;
+  vertex_buffer_ = 0;
+  index_buffer_ = 0;
+  index_count_ = 0;
+  GetResourceRegistry().Track(this, ResourceKind::kMesh, name_, 0, 0);
+}
+
+MeshData::MeshData()
+    : vertex_data(nullptr),
+      vertex_count(0),
+      vertex_stride(0),
+      uv_type(GL_FLOAT),
+      index_data(nullptr),
+      index_count(0),
+      index_type(GL_UNSIGNED_SHORT),
+      bounds_min{0.0f, 0.0f, 0.0f},
+      bounds_max{0.0f, 0.0f, 0.0f},
+      asset(nullptr) {}
+
+MeshData::~MeshData() {
+  if (asset != nullptr) {
+    AAsset_close(asset);
+  }
+}
 
 bool TexturedMesh::Initialize(JNIEnv* env, AAssetManager* asset_mgr,
-                              const std::string& obj_file_path,
+                              const std::string& file_path,
                               GLuint position_attrib, GLuint uv_attrib) {
+  MeshData data;
+  return Parse(asset_mgr, file_path, &data) &&
+         Initialize(data, position_attrib, uv_attrib);
+}
+
+bool TexturedMesh::Initialize(const MeshData& data, GLuint position_attrib,
+                              GLuint uv_attrib) {
   position_attrib_ = position_attrib;
   uv_attrib_ = uv_attrib;
-  // We don't use normals for anything so we discard them.
-  std::vector<GLfloat> normals;
-  if (!LoadObjFile(asset_mgr, obj_file_path, &vertices_, &normals, &uv_,
-                   &indices_)) {
+  bounds_min_ = data.bounds_min;
+  bounds_max_ = data.bounds_max;
+  return Upload(data.vertex_data, data.vertex_count, data.vertex_stride,
+                data.uv_type, data.index_data, data.index_count,
+                data.index_type, data.name);
+}
+
+bool TexturedMesh::Parse(AAssetManager* asset_mgr,
+                         const std::string& file_path, MeshData* data) {
+  data->name = file_path;
+  if (HasSuffix(file_path, ".mesh")) {
+    return ParseMeshFile(asset_mgr, data);
+  }
+
+  // We don't use normals for anything so they are not loaded.
+  ObjMesh mesh;
+  if (!LoadObjFile(asset_mgr, file_path, &mesh)) {
     return false;
   }
+
+  // Interleave positions and UVs so each vertex is fetched from one place.
+  // Use 16-bit indices whenever they are sufficient.
+  const size_t vertex_count = mesh.GetVertexCount();
+  const bool has_uv = !mesh.uvs.empty();
+  const bool short_indices = vertex_count <= 0x10000;
+  const size_t index_size = short_indices ? sizeof(GLushort) : sizeof(GLuint);
+  const size_t vertex_bytes = vertex_count * sizeof(MeshVertex);
+  data->storage.resize(vertex_bytes + mesh.indices.size() * index_size);
+  MeshVertex* vertices = reinterpret_cast<MeshVertex*>(data->storage.data());
+  for (size_t i = 0; i < vertex_count; ++i) {
+    MeshVertex& vertex = vertices[i];
+    vertex.position[0] = mesh.positions[i * 3];
+    vertex.position[1] = mesh.positions[i * 3 + 1];
+    vertex.position[2] = mesh.positions[i * 3 + 2];
+    vertex.uv[0] = has_uv ? mesh.uvs[i * 2] : 0.0f;
+    vertex.uv[1] = has_uv ? mesh.uvs[i * 2 + 1] : 0.0f;
+    gvr::Vec3f& bounds_min = data->bounds_min;
+    gvr::Vec3f& bounds_max = data->bounds_max;
+    if (i == 0) {
+      bounds_min = {vertex.position[0], vertex.position[1],
+                    vertex.position[2]};
+      bounds_max = bounds_min;
+    }
+    bounds_min.x = std::fmin(bounds_min.x, vertex.position[0]);
+    bounds_min.y = std::fmin(bounds_min.y, vertex.position[1]);
+    bounds_min.z = std::fmin(bounds_min.z, vertex.position[2]);
+    bounds_max.x = std::fmax(bounds_max.x, vertex.position[0]);
+    bounds_max.y = std::fmax(bounds_max.y, vertex.position[1]);
+    bounds_max.z = std::fmax(bounds_max.z, vertex.position[2]);
+  }
+
+  uint8_t* indices = data->storage.data() + vertex_bytes;
+  if (short_indices) {
+    GLushort* short_index = reinterpret_cast<GLushort*>(indices);
+    for (size_t i = 0; i < mesh.indices.size(); ++i) {
+      short_index[i] = static_cast<GLushort>(mesh.indices[i]);
+    }
+  } else {
+    memcpy(indices, mesh.indices.data(), mesh.indices.size() * index_size);
+  }
+
+  data->vertex_data = vertices;
+  data->vertex_count = vertex_count;
+  data->vertex_stride = sizeof(MeshVertex);
+  data->uv_type = GL_FLOAT;
+  data->index_data = indices;
+  data->index_count = mesh.indices.size();
+  data->index_type = short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
   return true;
 }
 
-void TexturedMesh::Draw() const {
+bool TexturedMesh::ParseMeshFile(AAssetManager* asset_mgr, MeshData* data) {
+  const std::string& mesh_file_path = data->name;
+  // In buffer mode, assets stored uncompressed in the APK are memory-mapped,
+  // so the vertex and index data go from the APK straight to glBufferData.
+  // The asset stays open until |data| is released.
+  data->asset =
+      AAssetManager_open(asset_mgr, mesh_file_path.c_str(), AASSET_MODE_BUFFER);
+  if (data->asset == nullptr) {
+    LOGE("Error opening asset %s", mesh_file_path.c_str());
+    return false;
+  }
+
+  const char* buffer = static_cast<const char*>(AAsset_getBuffer(data->asset));
+  const size_t size = static_cast<size_t>(AAsset_getLength(data->asset));
+  MeshFileHeader header;
+  if (buffer == nullptr || size < sizeof(header)) {
+    LOGE("Failed to read mesh file %s", mesh_file_path.c_str());
+    return false;
+  }
+  memcpy(&header, buffer, sizeof(header));
+  if (!IsValidMeshFileHeader(header, size)) {
+    LOGE("Invalid mesh file %s", mesh_file_path.c_str());
+    return false;
+  }
+  data->bounds_min = {header.bounds_min[0], header.bounds_min[1],
+                      header.bounds_min[2]};
+  data->bounds_max = {header.bounds_max[0], header.bounds_max[1],
+                      header.bounds_max[2]};
+
+  data->vertex_data = buffer + header.vertex_data_offset;
+  data->vertex_count = header.vertex_count;
+  data->vertex_stride = header.vertex_stride;
+  data->uv_type =
+      (header.flags & kMeshFlagHalfFloatUv) ? GL_HALF_FLOAT : GL_FLOAT;
+  data->index_data = buffer + header.index_data_offset;
+  data->index_count = header.index_count;
+  data->index_type = (header.flags & kMeshFlag32BitIndices) ? GL_UNSIGNED_INT
+                                                            : GL_UNSIGNED_SHORT;
+  return true;
+}
+
+bool TexturedMesh::Upload(const void* vertex_data, size_t vertex_count,
+                          GLsizei vertex_stride, GLenum uv_type,
+                          const void* index_data, size_t index_count,
+                          GLenum index_type, const std::string& name) {
+  const bool es3 = IsGLES3Context();
+  // 32-bit indices and half float attributes are core in OpenGL ES 3.0 but
+  // need extensions on ES 2.0.
+  if (index_type == GL_UNSIGNED_INT && !es3 &&
+      !HasGLExtension("GL_OES_element_index_uint")) {
+    LOGE("%s has %zu vertices, which needs 32-bit indices.", name.c_str(),
+         vertex_count);
+    return false;
+  }
+  if (uv_type == GL_HALF_FLOAT && !es3) {
+    if (!HasGLExtension("GL_OES_vertex_half_float")) {
+      LOGE("%s uses half float UVs, which are not supported.", name.c_str());
+      return false;
+    }
+    uv_type = GL_HALF_FLOAT_OES;
+  }
+  ComputeBoundingSphere(vertex_data, vertex_count, vertex_stride);
+  vertex_stride_ = vertex_stride;
+  uv_type_ = uv_type;
+  index_count_ = static_cast<GLsizei>(index_count);
+  index_type_ = index_type;
+  const size_t index_size =
+      index_type == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort);
+
+  glGenBuffers(1, &vertex_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertex_count * vertex_stride, vertex_data,
+               GL_STATIC_DRAW);
+
+  glGenBuffers(1, &index_buffer_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * index_size, index_data,
+               GL_STATIC_DRAW);
+
+  // A vertex array object remembers the buffer bindings and attribute
+  // pointers, so drawing only needs a single bind.
+  if (es3) {
+    glGenVertexArrays(1, &vertex_array_);
+    glBindVertexArray(vertex_array_);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    SetVertexAttribPointers();
+    glBindVertexArray(0);
+  }
+
+  // Leave the default bindings in place for code that still draws from
+  // client-side arrays, such as the reticle.
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  CheckGLError("TexturedMesh::Upload");
+  name_ = name;
+  GetResourceRegistry().Track(this, ResourceKind::kMesh, name_, 0,
+                              vertex_count * vertex_stride +
+                                  index_count * index_size);
+  return true;
+}
+
+void TexturedMesh::ComputeBoundingSphere(const void* vertex_data,
+                                         size_t vertex_count,
+                                         GLsizei vertex_stride) {
+  bounding_sphere_center_ = {(bounds_min_.x + bounds_max_.x) * 0.5f,
+                             (bounds_min_.y + bounds_max_.y) * 0.5f,
+                             (bounds_min_.z + bounds_max_.z) * 0.5f};
+  // The farthest vertex from the center of the box gives a tighter sphere
+  // than the corners of the box do.
+  float max_distance_squared = 0.0f;
+  const char* vertex = static_cast<const char*>(vertex_data);
+  for (size_t i = 0; i < vertex_count; ++i, vertex += vertex_stride) {
+    float position[3];
+    memcpy(position, vertex, sizeof(position));
+    const float dx = position[0] - bounding_sphere_center_.x;
+    const float dy = position[1] - bounding_sphere_center_.y;
+    const float dz = position[2] - bounding_sphere_center_.z;
+    max_distance_squared =
+        std::fmax(max_distance_squared, dx * dx + dy * dy + dz * dz);
+  }
+  bounding_sphere_radius_ = std::sqrt(max_distance_squared);
+}
+
+void TexturedMesh::SetVertexAttribPointers() const {
+  // Both vertex layouts in mesh_format.h start with three position floats
+  // followed by the UV.
   glEnableVertexAttribArray(position_attrib_);
-  glVertexAttribPointer(position_attrib_, 3, GL_FLOAT, false, 0,
-                        vertices_.data());
+  glVertexAttribPointer(
+      position_attrib_, 3, GL_FLOAT, false, vertex_stride_,
+      reinterpret_cast<const void*>(offsetof(MeshVertex, position)));
   glEnableVertexAttribArray(uv_attrib_);
-  glVertexAttribPointer(uv_attrib_, 2, GL_FLOAT, false, 0, uv_.data());
+  glVertexAttribPointer(
+      uv_attrib_, 2, uv_type_, false, vertex_stride_,
+      reinterpret_cast<const void*>(offsetof(MeshVertex, uv)));
+}
 
-  glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_SHORT,
-                 indices_.data());
+void TexturedMesh::Draw() const {
+  Bind();
+  DrawBound(1);
+  Unbind();
 }
 
-Texture::Texture() : texture_id_(0) {}
+void TexturedMesh::Bind() const {
+  if (vertex_array_ != 0) {
+    glBindVertexArray(vertex_array_);
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  SetVertexAttribPointers();
+}
+
+void TexturedMesh::DrawBound(GLsizei instance_count) const {
+  if (instance_count == 1) {
+    glDrawElements(GL_TRIANGLES, index_count_, index_type_, nullptr);
+  } else {
+    glDrawElementsInstanced(GL_TRIANGLES, index_count_, index_type_, nullptr,
+                            instance_count);
+  }
+}
+
+void TexturedMesh::Unbind() const {
+  if (vertex_array_ != 0) {
+    glBindVertexArray(0);
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+Texture::Texture()
+    : loader_(nullptr),
+      texture_id_(0),
+      target_(GL_TEXTURE_2D),
+      layer_count_(1),
+      array_format_(0),
+      array_width_(0),
+      array_height_(0),
+      array_level_count_(0) {}
 
 Texture::~Texture() {
+  GetResourceRegistry().Untrack(this);
   if (texture_id_ != 0) {
+    GetGlStateCache().OnTextureDeleted(texture_id_);
     glDeleteTextures(1, &texture_id_);
   }
 }
 
-bool Texture::Initialize(JNIEnv* env, jobject java_asset_mgr,
+void Texture::Initialize(TextureLoader* loader,
                          const std::string& texture_path) {
-  glGenTextures(1, &texture_id_);
+  target_ = GL_TEXTURE_2D;
+  InitializeLayers(loader, {texture_path});
+}
+
+void Texture::InitializeArray(TextureLoader* loader,
+                              const std::vector<std::string>& layer_paths) {
+  HELLOVR_CHECK(!layer_paths.empty());
+  target_ = GL_TEXTURE_2D_ARRAY;
+  InitializeLayers(loader, layer_paths);
+}
+
+void Texture::Upload(const TextureImage& image, int layer) {
+  HELLOVR_CHECK(layer >= 0 && layer < layer_count_);
   Bind();
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                  GL_LINEAR_MIPMAP_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  if (!LoadPngFromAssetManager(env, java_asset_mgr, GL_TEXTURE_2D,
-                               texture_path)) {
-    LOGE("Couldn't load texture.");
-    return false;
+  if (target_ == GL_TEXTURE_2D_ARRAY) {
+    const TextureImage::Level& base = image.levels[0];
+    if (array_level_count_ == 0) {
+      AllocateArray(image);
+    } else if (image.compressed_format != array_format_ ||
+               base.width != array_width_ || base.height != array_height_ ||
+               image.levels.size() != array_level_count_) {
+      LOGE("Texture layer %d doesn't match the first layer of the array.",
+           layer);
+      return;
+    }
+    for (size_t level = 0; level < image.levels.size(); ++level) {
+      const TextureImage::Level& data = image.levels[level];
+      if (image.compressed_format != 0) {
+        glCompressedTexSubImage3D(
+            GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), 0, 0, layer,
+            data.width, data.height, 1, image.compressed_format,
+            static_cast<GLsizei>(data.data.size()), data.data.data());
+      } else {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), 0, 0,
+                        layer, data.width, data.height, 1, GL_RGBA,
+                        GL_UNSIGNED_BYTE, data.data.data());
+      }
+    }
+    if (image.levels.size() == 1 && image.compressed_format == 0) {
+      glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+    return;
   }
-  glGenerateMipmap(GL_TEXTURE_2D);
-  return true;
+
+  for (size_t level = 0; level < image.levels.size(); ++level) {
+    const TextureImage::Level& data = image.levels[level];
+    if (image.compressed_format != 0) {
+      glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level),
+                             image.compressed_format, data.width, data.height,
+                             0, static_cast<GLsizei>(data.data.size()),
+                             data.data.data());
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), GL_RGBA,
+                   data.width, data.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                   data.data.data());
+    }
+  }
+  if (image.levels.size() == 1) {
+    if (image.compressed_format != 0) {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    } else {
+      glGenerateMipmap(GL_TEXTURE_2D);
+    }
+  }
+  GetResourceRegistry().Track(this, ResourceKind::kTexture, paths_[0], 0,
+                              GetGpuBytes(image));
 }
 
 void Texture::Bind() const {
   HELLOVR_CHECK(texture_id_ != 0);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
+  GetGlStateCache().BindTexture(0, target_, texture_id_);
+}
+
+void Texture::InitializeLayers(TextureLoader* loader,
+                               const std::vector<std::string>& paths) {
+  loader_ = loader;
+  paths_ = paths;
+  layer_count_ = static_cast<GLsizei>(paths.size());
+  CreateTexture();
+  GetResourceRegistry().SetEvictable(this, [this] { Evict(); },
+                                     [this] { Reload(); });
+  Reload();
+}
+
+void Texture::CreateTexture() {
+  array_level_count_ = 0;
+  glGenTextures(1, &texture_id_);
+  Bind();
+  glTexParameteri(target_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target_, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+  glTexParameteri(target_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  // A 1x1 image is a complete mip chain, so this is valid to sample from.
+  const std::vector<uint8_t> placeholder(4 * layer_count_, 0);
+  if (target_ == GL_TEXTURE_2D_ARRAY) {
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, 1, 1, layer_count_, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, placeholder.data());
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, placeholder.data());
+  }
+  GetResourceRegistry().Track(this, ResourceKind::kTexture, paths_[0], 0,
+                              placeholder.size());
+}
+
+void Texture::Evict() {
+  // Deleting the texture frees all its levels, which respecifying level 0
+  // would not.
+  GetGlStateCache().OnTextureDeleted(texture_id_);
+  glDeleteTextures(1, &texture_id_);
+  CreateTexture();
+}
+
+void Texture::Reload() {
+  for (GLsizei layer = 0; layer < layer_count_; ++layer) {
+    loader_->Load(paths_[layer], this, layer);
+  }
+}
+
+void Texture::AllocateArray(const TextureImage& image) {
+  // Each level is allocated zeroed and filled layer by layer, since the
+  // layers arrive from the loader one at a time. Allocating without data
+  // would leave the missing layers undefined, both when sampled and when
+  // mipmaps are generated from them.
+  std::vector<uint8_t> zeros(image.levels[0].data.size() * layer_count_, 0);
+  for (size_t level = 0; level < image.levels.size(); ++level) {
+    const TextureImage::Level& data = image.levels[level];
+    const size_t size = data.data.size() * layer_count_;
+    if (image.compressed_format != 0) {
+      glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level),
+                             image.compressed_format, data.width, data.height,
+                             layer_count_, 0, static_cast<GLsizei>(size),
+                             zeros.data());
+    } else {
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), GL_RGBA,
+                   data.width, data.height, layer_count_, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, zeros.data());
+    }
+  }
+  if (image.levels.size() == 1 && image.compressed_format != 0) {
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  }
+  array_format_ = image.compressed_format;
+  array_width_ = image.levels[0].width;
+  array_height_ = image.levels[0].height;
+  array_level_count_ = image.levels.size();
+  GetResourceRegistry().Track(this, ResourceKind::kTexture, paths_[0], 0,
+                              GetGpuBytes(image) * layer_count_);
 }
 
 }  // namespace ndk_hello_vr
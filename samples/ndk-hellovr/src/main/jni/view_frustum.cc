@@ -0,0 +1,69 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "view_frustum.h"  // NOLINT
+
+#include <cmath>
+
+namespace ndk_hello_vr {
+
+constexpr int ViewFrustum::kPlaneCount;
+
+ViewFrustum::ViewFrustum() : planes_() {}
+
+void ViewFrustum::Set(const gvr::Mat4f view_projection[2]) {
+  for (int eye = 0; eye < 2; ++eye) {
+    // A point is inside the clip volume if -w <= x, y, z <= w, so each plane
+    // is the last row of the matrix plus or minus one of the others.
+    const float(&m)[4][4] = view_projection[eye].m;
+    for (int i = 0; i < kPlaneCount; ++i) {
+      const int row = i / 2;
+      const float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+      Plane plane = {m[3][0] + sign * m[row][0], m[3][1] + sign * m[row][1],
+                     m[3][2] + sign * m[row][2], m[3][3] + sign * m[row][3]};
+      const float length = std::sqrt(plane.a * plane.a + plane.b * plane.b +
+                                     plane.c * plane.c);
+      if (length > 0.0f) {
+        plane.a /= length;
+        plane.b /= length;
+        plane.c /= length;
+        plane.d /= length;
+      }
+      planes_[eye][i] = plane;
+    }
+  }
+}
+
+bool ViewFrustum::IsSphereVisible(const gvr::Vec3f& center,
+                                  float radius) const {
+  for (int eye = 0; eye < 2; ++eye) {
+    bool inside = true;
+    for (const Plane& plane : planes_[eye]) {
+      const float distance = plane.a * center.x + plane.b * center.y +
+                             plane.c * center.z + plane.d;
+      if (distance < -radius) {
+        inside = false;
+        break;
+      }
+    }
+    if (inside) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace ndk_hello_vr
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "view_uniforms.h"  // NOLINT
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+#include <GLES3/gl3.h>
+
+#include <cstring>
+
+#include "simd_math.h"  // NOLINT
+#include "util.h"       // NOLINT
+
+namespace ndk_hello_vr {
+
+constexpr const char* ViewUniforms::kBlockName;
+constexpr GLuint ViewUniforms::kBindingPoint;
+constexpr int ViewUniforms::kSlotCount;
+constexpr size_t ViewUniforms::kBlockSize;
+
+ViewUniforms::ViewUniforms()
+    : buffer_(0), mapped_(nullptr), slot_stride_(0), slot_(0) {}
+
+ViewUniforms::~ViewUniforms() {
+  if (buffer_ != 0) {
+    // Deleting the buffer also unmaps it.
+    glDeleteBuffers(1, &buffer_);
+  }
+}
+
+void ViewUniforms::Initialize() {
+  // A new context has none of the old objects, so this does not delete them.
+  buffer_ = 0;
+  mapped_ = nullptr;
+  slot_ = 0;
+
+  GLint alignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  alignment = alignment > 0 ? alignment : 256;
+  slot_stride_ = (kBlockSize + alignment - 1) / alignment * alignment;
+  const GLsizeiptr buffer_size = slot_stride_ * kSlotCount;
+
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  PFNGLBUFFERSTORAGEEXTPROC buffer_storage = nullptr;
+  if (HasGLExtension("GL_EXT_buffer_storage")) {
+    buffer_storage = reinterpret_cast<PFNGLBUFFERSTORAGEEXTPROC>(
+        eglGetProcAddress("glBufferStorageEXT"));
+  }
+  if (buffer_storage != nullptr) {
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT_EXT | GL_MAP_COHERENT_BIT_EXT;
+    buffer_storage(GL_UNIFORM_BUFFER, buffer_size, nullptr, flags);
+    mapped_ = static_cast<uint8_t*>(
+        glMapBufferRange(GL_UNIFORM_BUFFER, 0, buffer_size, flags));
+  }
+  if (mapped_ == nullptr) {
+    LOGD("Persistent buffer mapping is not supported, not late latching.");
+    if (buffer_storage != nullptr) {
+      // Immutable storage cannot be respecified, so start over.
+      glDeleteBuffers(1, &buffer_);
+      glGenBuffers(1, &buffer_);
+      glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    }
+    glBufferData(GL_UNIFORM_BUFFER, buffer_size, nullptr, GL_DYNAMIC_DRAW);
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  CheckGLError("View uniform buffer");
+}
+
+void ViewUniforms::AttachToProgram(GLuint program) {
+  const GLuint block_index = glGetUniformBlockIndex(program, kBlockName);
+  if (block_index != GL_INVALID_INDEX) {
+    glUniformBlockBinding(program, block_index, kBindingPoint);
+  }
+}
+
+void ViewUniforms::BeginFrame(const gvr::Mat4f view[2],
+                              const gvr::Mat4f projection[2]) {
+  slot_ = (slot_ + 1) % kSlotCount;
+  WriteSlot(view, projection);
+  // Bound every frame, because GVR's distortion pass may use the binding
+  // point too.
+  glBindBufferRange(GL_UNIFORM_BUFFER, kBindingPoint, buffer_,
+                    slot_ * slot_stride_, kBlockSize);
+}
+
+void ViewUniforms::LateLatch(const gvr::Mat4f view[2],
+                             const gvr::Mat4f projection[2]) {
+  if (SupportsLateLatch()) {
+    WriteSlot(view, projection);
+  }
+}
+
+void ViewUniforms::WriteSlot(const gvr::Mat4f view[2],
+                             const gvr::Mat4f projection[2]) {
+  // The layout of HELLOVR_VIEW_UNIFORMS_GLSL, in column-major order.
+  float block[kBlockSize / sizeof(float)];
+  for (int eye = 0; eye < 2; ++eye) {
+    const gvr::Mat4f view_projection = MatrixMul(projection[eye], view[eye]);
+    TransposeMat4(&view[eye].m[0][0], block + eye * 16);
+    TransposeMat4(&projection[eye].m[0][0], block + (2 + eye) * 16);
+    TransposeMat4(&view_projection.m[0][0], block + (4 + eye) * 16);
+  }
+  if (mapped_ != nullptr) {
+    // The mapping is coherent, so the GPU sees this without a flush.
+    memcpy(mapped_ + slot_ * slot_stride_, block, sizeof(block));
+  } else {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferSubData(GL_UNIFORM_BUFFER, slot_ * slot_stride_, sizeof(block),
+                    block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  }
+}
+
+}  // namespace ndk_hello_vr
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVR_APP_SRC_MAIN_JNI_VIEW_UNIFORMS_H_  // NOLINT
+#define HELLOVR_APP_SRC_MAIN_JNI_VIEW_UNIFORMS_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+namespace ndk_hello_vr {
+
+// The GLSL declaration of the ViewUniforms block, for pasting into ES 3.0
+// shader sources. Index the arrays with gl_ViewID_OVR.
+#define HELLOVR_VIEW_UNIFORMS_GLSL          \
+  "layout(std140) uniform ViewUniforms {\n" \
+  "  mat4 u_View[2];\n"                     \
+  "  mat4 u_Projection[2];\n"               \
+  "  mat4 u_VP[2];\n"                       \
+  "};\n"
+
+// The std140 uniform block that holds the view, projection and
+// view-projection matrices of both eyes, shared by all multiview shaders.
+// It is written once per frame, so draws only set their own model matrix.
+//
+// The block lives in a uniform buffer with one slot per frame in flight.
+//
+// With GL_EXT_buffer_storage the buffer is mapped persistently and coherently,
+// which allows late latching: the matrices can be rewritten after the draw
+// calls have been issued, up to the moment the frame is submitted, and the
+// GPU reads whatever is in the slot when it runs the draws. Without the
+// extension the matrices are uploaded with glBufferSubData() before drawing.
+//
+// Requires OpenGL ES 3.0.
+class ViewUniforms {
+ public:
+  static constexpr const char* kBlockName = "ViewUniforms";
+  static constexpr GLuint kBindingPoint = 0;
+
+  ViewUniforms();
+  ~ViewUniforms();
+
+  // Creates the buffer. Must be called on the GL thread with a new context.
+  void Initialize();
+
+  // Binds the block of |program| to the buffer. Call once after linking.
+  static void AttachToProgram(GLuint program);
+
+  // Writes the matrices of a new frame to the next slot and binds it. Call
+  // before drawing.
+  void BeginFrame(const gvr::Mat4f view[2], const gvr::Mat4f projection[2]);
+
+  // Whether LateLatch() can be used.
+  bool SupportsLateLatch() const { return mapped_ != nullptr; }
+
+  // Replaces the matrices of the current frame after its draws have been
+  // issued. Call right before submitting the frame. The GPU may read a mix
+  // of the old and new matrices if it is already running the frame, so the
+  // two should be close, e.g. computed from successive head poses.
+  void LateLatch(const gvr::Mat4f view[2], const gvr::Mat4f projection[2]);
+
+ private:
+  // Slots that may be read by the GPU while the CPU writes the next one.
+  static constexpr int kSlotCount = 4;
+  // Three arrays of two matrices.
+  static constexpr size_t kBlockSize = 3 * 2 * 16 * sizeof(float);
+
+  void WriteSlot(const gvr::Mat4f view[2], const gvr::Mat4f projection[2]);
+
+  GLuint buffer_;
+  // The persistent mapping of the whole buffer, or null without
+  // GL_EXT_buffer_storage.
+  uint8_t* mapped_;
+  GLsizeiptr slot_stride_;
+  int slot_;
+
+  ViewUniforms(const ViewUniforms&) = delete;
+  ViewUniforms& operator=(const ViewUniforms&) = delete;
+};
+
+}  // namespace ndk_hello_vr
+
+#endif  // HELLOVR_APP_SRC_MAIN_JNI_VIEW_UNIFORMS_H_  // NOLINT
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_AUDIO_PLAYER_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_AUDIO_PLAYER_H_  // NOLINT
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vr/gvr/capi/include/gvr_audio.h"
+#include "vr/gvr/capi/include/gvr_types.h"
+
+namespace ndk_hello_vr_beta {
+
+// Plays preloaded sounds on a fixed pool of voices from a worker thread.
+//
+// All gvr::AudioApi calls, including SetHeadPose() and Update(), happen on
+// the worker, so neither the render thread nor input handling ever waits
+// for the audio engine to create or start a source. The other methods only
+// queue a command for the worker. They are safe to call from any thread.
+class AudioPlayer {
+ public:
+  static constexpr int kVoiceCount = 4;
+
+  // Starts the worker, which preloads |sound_files| before it runs any
+  // command.
+  //
+  // @param audio_api The audio context. Not owned, must outlive the player.
+  // @param sound_files Paths in the APK assets. They must stay valid for the
+  //     lifetime of the player, as must the paths passed to the Play
+  //     methods.
+  AudioPlayer(gvr::AudioApi* audio_api, std::vector<const char*> sound_files);
+
+  // Joins the worker. Commands that have not run yet are dropped.
+  ~AudioPlayer();
+
+  // Starts looping |sound_file| at |position| on a voice of its own, which
+  // is returned for SetPosition(). Returns -1 if no voice is left.
+  int PlayLooping(const char* sound_file, const gvr::Vec3f& position);
+
+  // Plays |sound_file| once without spatialization. The voice that started
+  // playing longest ago among those not taken by looping sounds is reused,
+  // which stops its sound if it is still playing.
+  void PlayOnce(const char* sound_file);
+
+  // Moves the sound playing on |voice|.
+  void SetPosition(int voice, const gvr::Vec3f& position);
+
+  // Updates the listener and then the audio engine. Call once per frame.
+  void SetHeadPose(const gvr::Mat4f& head_view);
+
+  void Pause();
+  void Resume();
+
+ private:
+  struct Command {
+    enum Type { kPlayLooping, kPlayOnce, kSetPosition, kPause, kResume };
+
+    Type type;
+    int voice;
+    const char* sound_file;
+    gvr::Vec3f position;
+  };
+
+  void Post(const Command& command);
+  void WorkerLoop();
+  void Run(const Command& command);
+
+  gvr::AudioApi* audio_api_;
+  const std::vector<const char*> sound_files_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  // The commands that the worker has not taken yet. The worker swaps this
+  // with |running_|, so both keep their storage from frame to frame.
+  std::vector<Command> pending_;
+  gvr::Mat4f head_view_;
+  bool has_head_view_;
+  bool stopping_;
+  // The voices reserved by PlayLooping(). The others play one-shot sounds.
+  int looping_voice_count_;
+  int next_once_voice_;
+
+  // Only used by the worker.
+  std::vector<Command> running_;
+  gvr::AudioSourceId sources_[kVoiceCount];
+
+  std::thread thread_;
+
+  AudioPlayer(const AudioPlayer&) = delete;
+  AudioPlayer& operator=(const AudioPlayer&) = delete;
+};
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_AUDIO_PLAYER_H_  // NOLINT
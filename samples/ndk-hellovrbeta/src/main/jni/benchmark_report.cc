@@ -0,0 +1,132 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "benchmark_report.h"  // NOLINT
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+#include "util.h"  // NOLINT
+
+namespace ndk_hello_vr_beta {
+
+namespace {
+
+const char* const kCpuPhaseKeys[FrameTimings::kCpuPhaseCount] = {
+    "cpu_pose_us", "cpu_controllers_us", "cpu_draw_world_us", "cpu_submit_us",
+    "cpu_audio_us",
+};
+
+const char* const kGpuPassKeys[FrameTimings::kMaxGpuPasses] = {
+    "gpu_pass0_us", "gpu_pass1_us",
+};
+
+// Returns the nearest-rank percentile of sorted, non-empty |values|.
+int64_t GetPercentile(const std::vector<int64_t>& values, int percentile) {
+  const size_t rank = (values.size() * percentile + 99) / 100;
+  return values[rank > 0 ? rank - 1 : 0];
+}
+
+}  // anonymous namespace
+
+BenchmarkReport::BenchmarkReport() {}
+
+void BenchmarkReport::Clear() {
+  cpu_frame_us_.clear();
+  for (std::vector<int64_t>& values : cpu_phase_us_) {
+    values.clear();
+  }
+  for (std::vector<int64_t>& values : gpu_pass_us_) {
+    values.clear();
+  }
+  draw_calls_.clear();
+  gl_calls_.clear();
+  cpu_kb_.clear();
+  gpu_kb_.clear();
+}
+
+void BenchmarkReport::AddTimings(const FrameTimings& timings) {
+  cpu_frame_us_.push_back(timings.cpu_frame_ns / 1000);
+  for (int i = 0; i < FrameTimings::kCpuPhaseCount; ++i) {
+    cpu_phase_us_[i].push_back(timings.cpu_phase_ns[i] / 1000);
+  }
+  for (int i = 0; i < FrameTimings::kMaxGpuPasses; ++i) {
+    if (timings.gpu_pass_ns[i] >= 0) {
+      gpu_pass_us_[i].push_back(timings.gpu_pass_ns[i] / 1000);
+    }
+  }
+}
+
+void BenchmarkReport::AddCounts(size_t draw_calls, uint32_t gl_calls) {
+  draw_calls_.push_back(static_cast<int64_t>(draw_calls));
+  gl_calls_.push_back(gl_calls);
+}
+
+void BenchmarkReport::AddMemory(size_t cpu_bytes, size_t gpu_bytes) {
+  cpu_kb_.push_back(static_cast<int64_t>(cpu_bytes / 1024));
+  gpu_kb_.push_back(static_cast<int64_t>(gpu_bytes / 1024));
+}
+
+void BenchmarkReport::AppendPercentiles(const char* name,
+                                        std::vector<int64_t> values,
+                                        std::string* json) {
+  if (values.empty()) {
+    return;
+  }
+  std::sort(values.begin(), values.end());
+  char buffer[160];
+  snprintf(buffer, sizeof(buffer),
+           ",\"%s\":{\"p50\":%" PRId64 ",\"p90\":%" PRId64 ",\"p99\":%" PRId64
+           ",\"max\":%" PRId64 "}",
+           name, GetPercentile(values, 50), GetPercentile(values, 90),
+           GetPercentile(values, 99), values.back());
+  json->append(buffer);
+}
+
+std::string BenchmarkReport::ToJson() const {
+  std::string json = "{\"frames\":" + std::to_string(GetFrameCount());
+  AppendPercentiles("cpu_frame_us", cpu_frame_us_, &json);
+  for (int i = 0; i < FrameTimings::kCpuPhaseCount; ++i) {
+    AppendPercentiles(kCpuPhaseKeys[i], cpu_phase_us_[i], &json);
+  }
+  for (int i = 0; i < FrameTimings::kMaxGpuPasses; ++i) {
+    AppendPercentiles(kGpuPassKeys[i], gpu_pass_us_[i], &json);
+  }
+  AppendPercentiles("draw_calls", draw_calls_, &json);
+  AppendPercentiles("gl_calls", gl_calls_, &json);
+  AppendPercentiles("cpu_kb", cpu_kb_, &json);
+  AppendPercentiles("gpu_kb", gpu_kb_, &json);
+  json += "}";
+  return json;
+}
+
+bool BenchmarkReport::Write(const std::string& path) const {
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    LOGE("Could not create %s.", path.c_str());
+    return false;
+  }
+  const std::string json = ToJson() + "\n";
+  const bool written = fwrite(json.data(), json.size(), 1, file) == 1;
+  if (fclose(file) != 0 || !written) {
+    LOGE("Could not write benchmark report %s.", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ndk_hello_vr_beta
@@ -44,13 +44,20 @@ constexpr float kBatteryCriticalPercentage = 0.25f;
 }  // unnamed namespace
 
 Controller::Controller(gvr::ControllerApi* gvr_controller_api, int32_t index,
-                       gvr::ControllerHandedness handedness)
+                       gvr::ControllerHandedness handedness, SceneGraph* scene)
     : index_(index),
-      handedness_(handedness),
-      type_(GVR_BETA_CONTROLLER_CONFIGURATION_UNKNOWN),
-      show_laser_(index == 0),
-      is_tracking_(true),
-      is_out_of_fov_(false) {
+      scene_(scene),
+      node_(scene->AddNode(-1, GetTranslationMatrix({0.0f, 0.0f, 0.0f}))),
+      laser_node_(scene->AddNode(node_, k6dofLaserTransform)) {
+  Connect(gvr_controller_api, handedness);
+}
+
+void Controller::Connect(gvr::ControllerApi* gvr_controller_api,
+                         gvr::ControllerHandedness handedness) {
+  handedness_ = handedness;
+  show_laser_ = index_ == 0;
+  is_tracking_ = true;
+  is_out_of_fov_ = false;
   // Read current controller state for controller type.
   state_.Update(*gvr_controller_api, index_);
   type_ = static_cast<gvr_beta_controller_configuration_type>(
@@ -69,22 +76,14 @@ void Controller::UpdateTrackingStatus() {
       status == GVR_BETA_CONTROLLER_TRACKING_STATUS_FLAG_OUT_OF_FOV;
 }
 
-void Controller::Update(gvr::ControllerApi* gvr_controller_api,
-                        const gvr::Mat4f& head_space_from_start_space_transform,
-                        float floor_offset) {
+void Controller::ReadState(gvr::ControllerApi* gvr_controller_api,
+                           ControllerEvents* events) {
   const int old_status = state_.GetApiStatus();
   const int old_connection_state = state_.GetConnectionState();
 
-  // Apply an arm model for 3DOF controllers, 6DOF controllers will ignore this.
-  gvr_controller_api->ApplyArmModel(
-      index_, handedness_, gvr::kArmModelBehaviorFollowGazeWith6DOFPosition,
-      head_space_from_start_space_transform);
-
   // Read current controller state.
   state_.Update(*gvr_controller_api, index_);
 
-  UpdateTrackingStatus();
-
   // Print new API status and connection state, if they changed.
   if (state_.GetApiStatus() != old_status ||
       state_.GetConnectionState() != old_connection_state) {
@@ -94,27 +93,70 @@ void Controller::Update(gvr::ControllerApi* gvr_controller_api,
         gvr_controller_connection_state_to_string(state_.GetConnectionState()));
   }
 
+  // The state only reports the transitions since its previous update, so
+  // they are added to what has not been handled yet.
+  uint32_t buttons_down = 0;
+  uint32_t buttons_up = 0;
+  uint32_t buttons_pressed = 0;
+  for (int button = GVR_CONTROLLER_BUTTON_NONE + 1;
+       button < GVR_CONTROLLER_BUTTON_COUNT; ++button) {
+    const auto controller_button = static_cast<gvr::ControllerButton>(button);
+    if (state_.GetButtonDown(controller_button)) {
+      buttons_down |= ControllerEvents::ButtonBit(controller_button);
+    }
+    if (state_.GetButtonUp(controller_button)) {
+      buttons_up |= ControllerEvents::ButtonBit(controller_button);
+    }
+    if (state_.GetButtonState(controller_button)) {
+      buttons_pressed |= ControllerEvents::ButtonBit(controller_button);
+    }
+  }
+  events->buttons_pressed = buttons_pressed;
+  if ((buttons_down | buttons_up) != 0) {
+    events->buttons_down |= buttons_down;
+    events->buttons_up |= buttons_up;
+    events->button_timestamp = state_.GetLastButtonTimestamp();
+  }
+
+  // Track any gestures made since the last update:
+  gesture_api_.Update(&state_);
+  gvr_gesture_direction swipe_direction;
+  if (GetSwipeGesture(&swipe_direction)) {
+    events->has_swipe = true;
+    events->swipe_direction = swipe_direction;
+  }
+}
+
+void Controller::Update(gvr::ControllerApi* gvr_controller_api,
+                        const gvr::Mat4f& head_space_from_start_space_transform,
+                        float floor_offset, ControllerEvents* events) {
+  // Apply an arm model for 3DOF controllers, 6DOF controllers will ignore this.
+  gvr_controller_api->ApplyArmModel(
+      index_, handedness_, gvr::kArmModelBehaviorFollowGazeWith6DOFPosition,
+      head_space_from_start_space_transform);
+
+  ReadState(gvr_controller_api, events);
+  UpdateTrackingStatus();
+
   position_ = state_.GetPosition();
   // ApplyArmModel updates the floor offset in the 3DOF case, but not 6DOF.
   if (type_ == GVR_BETA_CONTROLLER_CONFIGURATION_6DOF) {
     position_.y -= floor_offset;
   }
 
-  transform_ = MatrixMul(GetTranslationMatrix(GetPosition()),
-                         ControllerQuatToMatrix(GetOrientation()));
-  if (type_ == GVR_BETA_CONTROLLER_CONFIGURATION_3DOF) {
-    laser_transform_ = MatrixMul(transform_, k3dofLaserTransform);
-  } else {
-    laser_transform_ = MatrixMul(transform_, k6dofLaserTransform);
-  }
+  scene_->SetLocalTransform(
+      node_, MatrixMul(GetTranslationMatrix(GetPosition()),
+                       ControllerQuatToMatrix(GetOrientation())));
+  // The laser only moves relative to the controller if the type changes.
+  scene_->SetLocalTransform(
+      laser_node_, type_ == GVR_BETA_CONTROLLER_CONFIGURATION_3DOF
+                       ? k3dofLaserTransform
+                       : k6dofLaserTransform);
 
   // Calculate the battery charge.
   float level = static_cast<float>(state_.GetBatteryLevel());
   battery_charge_ =
       level / static_cast<float>(GVR_CONTROLLER_BATTERY_LEVEL_FULL);
-
-  // Track any gestures made since the last update:
-  gesture_api_.Update(&state_);
 }
 
 bool Controller::GetSwipeGesture(gvr_gesture_direction* swipe_direction) const {
@@ -130,64 +172,77 @@ bool Controller::GetSwipeGesture(gvr_gesture_direction* swipe_direction) const {
   return false;
 }
 
-Controllers::Controllers(gvr::GvrApi* gvr_api)
-    : gvr_api_(gvr_api), gvr_controller_api_(new gvr::ControllerApi) {
+Controllers::Controllers(gvr::GvrApi* gvr_api, SceneGraph* scene)
+    : gvr_api_(gvr_api),
+      scene_(scene),
+      gvr_controller_api_(new gvr::ControllerApi),
+      controller_count_(0) {
   HELLOVRBETA_CHECK(gvr_controller_api_->Init(
       gvr::ControllerApi::DefaultOptions() | GVR_CONTROLLER_ENABLE_ARM_MODEL |
           GVR_CONTROLLER_ENABLE_GYRO,
       gvr_api_->cobj()));
 }
 
-void Controllers::Initialize(JNIEnv* env, jobject java_asset_mgr,
-                             AAssetManager* asset_mgr) {
+void Controllers::Initialize(MeshLoader* mesh_loader,
+                             TextureLoader* texture_loader) {
+  // The buffers of a previous context went away with it.
+  controller_6dof_mesh_.Forget();
+  controller_3dof_mesh_.Forget();
+  laser_mesh_.Forget();
   controller_shader_.Link();
 
   GLuint position_attrib = controller_shader_.GetPositionAttribute();
   GLuint uv_attrib = controller_shader_.GetUVAttribute();
 
-  HELLOVRBETA_CHECK(controller_6dof_mesh_.Initialize(
-      asset_mgr, "Controller6DOF.obj", position_attrib, uv_attrib));
-  HELLOVRBETA_CHECK(controller_6dof_texture_.Initialize(
-      env, java_asset_mgr, "Controller6DOFDiffuse.png"));
-  HELLOVRBETA_CHECK(controller_3dof_mesh_.Initialize(
-      asset_mgr, "Controller3DOF.obj", position_attrib, uv_attrib));
-  HELLOVRBETA_CHECK(controller_3dof_texture_.Initialize(
-      env, java_asset_mgr, "Controller3DOFDiffuse.png"));
+  mesh_loader->Load("Controller6DOF.mesh", position_attrib, uv_attrib,
+                    &controller_6dof_mesh_);
+  controller_6dof_texture_.Initialize(texture_loader,
+                                      "Controller6DOFDiffuse.png");
+  mesh_loader->Load("Controller3DOF.mesh", position_attrib, uv_attrib,
+                    &controller_3dof_mesh_);
+  controller_3dof_texture_.Initialize(texture_loader,
+                                      "Controller3DOFDiffuse.png");
 
   laser_shader_.Link();
 
   position_attrib = laser_shader_.GetPositionAttribute();
   uv_attrib = laser_shader_.GetUVAttribute();
 
-  HELLOVRBETA_CHECK(laser_mesh_.Initialize(asset_mgr, "Laser.obj",
-                                           position_attrib, uv_attrib));
-  HELLOVRBETA_CHECK(
-      laser_texture_.Initialize(env, java_asset_mgr, "Laser.png"));
+  mesh_loader->Load("Laser.mesh", position_attrib, uv_attrib, &laser_mesh_);
+  laser_texture_.Initialize(texture_loader, "Laser.png");
 
   Resume();
 }
 
 void Controllers::Pause() {
   if (gvr_controller_api_) gvr_controller_api_->Pause();
-  controllers_.clear();
+  // The controllers are connected again on resume.
+  controller_count_ = 0;
+  events_.clear();
 }
 
 void Controllers::Resume() { gvr_controller_api_->Resume(); }
 
 void Controllers::ReconnectIfRequired() {
-  int32_t controller_count = gvr_controller_api_->GetControllerCount();
-  if (controller_count != controllers_.size()) {
+  const size_t controller_count = gvr_controller_api_->GetControllerCount();
+  if (controller_count != controller_count_) {
     const gvr::UserPrefs user_prefs = gvr_api_->GetUserPrefs();
     const int32_t dominant_hand =
         gvr_user_prefs_get_controller_handedness(user_prefs.cobj());
-    controllers_.clear();
-    for (int32_t i = 0; i < controller_count; ++i) {
+    for (size_t i = 0; i < controller_count; ++i) {
       gvr::ControllerHandedness handedness =
           static_cast<gvr::ControllerHandedness>(i == 0 ? dominant_hand
                                                         : !dominant_hand);
-      controllers_.push_back(
-          Controller(gvr_controller_api_.get(), i, handedness));
+      if (i < controllers_.size()) {
+        controllers_[i].Connect(gvr_controller_api_.get(), handedness);
+      } else {
+        controllers_.push_back(
+            Controller(gvr_controller_api_.get(), i, handedness, scene_));
+      }
     }
+    controller_count_ = controller_count;
+    events_.resize(controller_count_);
+    ClearEvents();
   }
 }
 
@@ -196,52 +251,23 @@ void Controllers::Update(
     float floor_offset) {
   ReconnectIfRequired();
 
-  for (auto& controller : controllers_) {
-    controller.Update(gvr_controller_api_.get(),
-                      head_space_from_start_space_transform, floor_offset);
-
-    // Call controller input callbacks.
-    if (on_click_down_ &&
-        controller.GetState().GetButtonDown(GVR_CONTROLLER_BUTTON_CLICK)) {
-      on_click_down_(controller.GetIndex());
-    }
-    if (on_click_up_ &&
-        controller.GetState().GetButtonUp(GVR_CONTROLLER_BUTTON_CLICK)) {
-      on_click_up_(controller.GetIndex());
-    }
-    if (on_app_button_down_ &&
-        controller.GetState().GetButtonDown(GVR_CONTROLLER_BUTTON_APP)) {
-      on_app_button_down_(controller.GetIndex());
-    }
-    if (on_app_button_up_ &&
-        controller.GetState().GetButtonUp(GVR_CONTROLLER_BUTTON_APP)) {
-      on_app_button_up_(controller.GetIndex());
-    }
-    if (on_grip_down_ &&
-        controller.GetState().GetButtonDown(GVR_CONTROLLER_BUTTON_GRIP)) {
-      on_grip_down_(controller.GetIndex());
-    }
-    if (on_grip_up_ &&
-        controller.GetState().GetButtonUp(GVR_CONTROLLER_BUTTON_GRIP)) {
-      on_grip_up_(controller.GetIndex());
-    }
-    if (on_trigger_down_ &&
-        controller.GetState().GetButtonDown(GVR_CONTROLLER_BUTTON_TRIGGER)) {
-      on_trigger_down_(controller.GetIndex());
-    }
-    if (on_trigger_up_ &&
-        controller.GetState().GetButtonUp(GVR_CONTROLLER_BUTTON_TRIGGER)) {
-      on_trigger_up_(controller.GetIndex());
-    }
+  for (size_t i = 0; i < controller_count_; ++i) {
+    controllers_[i].Update(gvr_controller_api_.get(),
+                           head_space_from_start_space_transform, floor_offset,
+                           &events_[i]);
+  }
+}
 
-    gvr_gesture_direction gesture_direction;
-    if (on_swipe_ && controller.GetSwipeGesture(&gesture_direction)) {
-      on_swipe_(controller.GetIndex(), gesture_direction);
-    }
+void Controllers::ClearEvents() {
+  for (size_t i = 0; i < events_.size(); ++i) {
+    events_[i] = {static_cast<int32_t>(i), 0, 0, 0, false,
+                  GVR_GESTURE_DIRECTION_UP, 0};
   }
 }
 
-void Controllers::UpdateBatteryUniforms(const Controller& controller) const {
+void Controllers::GetBatteryUniforms(
+    const Controller& controller,
+    ControllerShaderProgram::ItemUniforms* uniforms) const {
   // UV Rectangle in the texture that surrounds the battery indicator.
   gvr::Rectf uv_rect = {};
   // UV offset to move the UV rectangle to either the charge or critical icons.
@@ -262,13 +288,15 @@ void Controllers::UpdateBatteryUniforms(const Controller& controller) const {
   if (charge > 0.0) {
     uv_rect.right = Lerp(uv_rect.left, uv_rect.right, charge);
   }
-  controller_shader_.SetBatteryOffset(offset);
-  controller_shader_.SetBatteryUVRect(uv_rect);
+  uniforms->battery_offset = offset;
+  uniforms->battery_uv_rect = uv_rect;
 }
 
-void Controllers::Draw(const gvr::Mat4f view[2],
-                       const gvr::Mat4f view_projection[2]) const {
-  for (const auto& controller : controllers_) {
+void Controllers::Submit(const gvr::Mat4f view[2], DrawList* draw_list) {
+  // The uniform values must stay alive until the list has been drawn.
+  item_uniforms_.resize(controller_count_);
+  for (size_t i = 0; i < controller_count_; ++i) {
+    const Controller& controller = controllers_[i];
     // Don't draw controllers that are out of tracking FOV.
     if (controller.IsOutOfFov()) {
       continue;
@@ -276,20 +304,33 @@ void Controllers::Draw(const gvr::Mat4f view[2],
 
     const gvr::Mat4f& model_matrix = controller.GetTransform();
 
-    controller_shader_.Use();
-    UpdateBatteryUniforms(controller);
-    controller_shader_.SetModelViewProjection(model_matrix, view_projection);
+    ControllerShaderProgram::ItemUniforms& uniforms = item_uniforms_[i];
+    uniforms.program = &controller_shader_;
+    GetBatteryUniforms(controller, &uniforms);
     // Show that tracking has failed by setting making it transparent.
-    controller_shader_.SetAlpha(controller.IsTracking() ? 1.0f : 0.25f);
-
+    uniforms.alpha = controller.IsTracking() ? 1.0f : 0.25f;
+
+    DrawItem item = {controller_shader_.GetDrawProgram(),
+                     nullptr,
+                     0,
+                     nullptr,
+                     model_matrix,
+                     BlendMode::kAlpha,
+                     &ControllerShaderProgram::SetItemUniforms,
+                     &uniforms};
     if (controller.GetType() == GVR_BETA_CONTROLLER_CONFIGURATION_6DOF) {
-      controller_6dof_texture_.Bind();
-      controller_6dof_mesh_.Draw();
+      item.texture = &controller_6dof_texture_;
+      item.mesh = &controller_6dof_mesh_;
+      // The 6DOF texture has no alpha channel.
+      if (uniforms.alpha == 1.0f) {
+        item.blend_mode = BlendMode::kOpaque;
+      }
     } else {
       // Assume 3DOF
-      controller_3dof_texture_.Bind();
-      controller_3dof_mesh_.Draw();
+      item.texture = &controller_3dof_texture_;
+      item.mesh = &controller_3dof_mesh_;
     }
+    draw_list->Add(item);
 
     if (controller.IsLaserShown()) {
       gvr::Mat4f laser_matrix = controller.GetLaserTransform();
@@ -307,23 +348,19 @@ void Controllers::Draw(const gvr::Mat4f view[2],
           laser_matrix, GetAxisAngleRotationMatrix({0.0f, 0.0f, 1.0f}, -angle));
 
       // Transform the laser using left eye, Ideally this should be per eye.
-      laser_shader_.Use();
-      laser_shader_.SetModelViewProjection(laser_model, view_projection);
-
-      // Use premultiplied alpha.
-      glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-      laser_texture_.Bind();
-      laser_mesh_.Draw();
-      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      // The laser texture uses premultiplied alpha.
+      draw_list->Add({laser_shader_.GetDrawProgram(), &laser_texture_, 0,
+                      &laser_mesh_, laser_model,
+                      BlendMode::kPremultipliedAlpha, nullptr, nullptr});
     }
   }
-  CheckGLError("Drawing controllers");
 }
 
 void Controllers::ForEachLaser(
     const std::function<void(int, const gvr::Vec3f& origin,
                              const gvr::Vec3f& direction)>& callback) {
-  for (auto& controller : controllers_) {
+  for (size_t i = 0; i < controller_count_; ++i) {
+    const Controller& controller = controllers_[i];
     if (controller.IsLaserShown()) {
       gvr::Mat4f laser_transform = controller.GetLaserTransform();
       gvr::Vec3f origin = MatrixPointMul(laser_transform, {0.0f, 0.0f, 0.0f});
@@ -336,49 +373,9 @@ void Controllers::ForEachLaser(
 }
 
 void Controllers::SetControllerForLaser(int index) {
-  for (int i = 0; i < static_cast<int>(controllers_.size()); ++i) {
+  for (int i = 0; i < static_cast<int>(controller_count_); ++i) {
     controllers_[i].SetIsLaserShown(index == i);
   }
 }
 
-void Controllers::SetOnClickDown(std::function<void(int index)> on_click_down) {
-  on_click_down_ = std::move(on_click_down);
-}
-
-void Controllers::SetOnClickUp(std::function<void(int index)> on_click_up) {
-  on_click_up_ = std::move(on_click_up);
-}
-
-void Controllers::SetOnTriggerDown(
-    std::function<void(int index)> on_trigger_down) {
-  on_trigger_down_ = std::move(on_trigger_down);
-}
-
-void Controllers::SetOnTriggerUp(std::function<void(int index)> on_trigger_up) {
-  on_trigger_up_ = std::move(on_trigger_up);
-}
-
-void Controllers::SetOnGripDown(std::function<void(int index)> on_grip_down) {
-  on_grip_down_ = std::move(on_grip_down);
-}
-
-void Controllers::SetOnGripUp(std::function<void(int index)> on_grip_up) {
-  on_grip_up_ = std::move(on_grip_up);
-}
-
-void Controllers::SetOnAppButtonDown(
-    std::function<void(int index)> on_app_button_down) {
-  on_app_button_down_ = std::move(on_app_button_down);
-}
-
-void Controllers::SetOnAppButtonUp(
-    std::function<void(int index)> on_app_button_up) {
-  on_app_button_up_ = std::move(on_app_button_up);
-}
-
-void Controllers::SetOnSwipe(
-    std::function<void(int, gvr_gesture_direction)> on_swipe) {
-  on_swipe_ = std::move(on_swipe);
-}
-
 }  // namespace ndk_hello_vr_beta
@@ -23,7 +23,11 @@
 
 #include <vector>
 
+#include "draw_list.h"       // NOLINT
+#include "mesh_loader.h"     // NOLINT
+#include "scene_graph.h"     // NOLINT
 #include "shader_program.h"  // NOLINT
+#include "texture_loader.h"  // NOLINT
 #include "util.h"  // NOLINT
 #include "vr/gvr/capi/include/gvr_beta.h"
 #include "vr/gvr/capi/include/gvr_controller.h"
@@ -32,25 +36,75 @@
 
 namespace ndk_hello_vr_beta {
 
+/**
+ * The input of one controller since its events were last cleared.
+ */
+struct ControllerEvents {
+  // Returns the bit of |button| in |buttons_down|, |buttons_up| and
+  // |buttons_pressed|.
+  static constexpr uint32_t ButtonBit(gvr::ControllerButton button) {
+    return 1u << button;
+  }
+
+  bool HasButtonDown(gvr::ControllerButton button) const {
+    return (buttons_down & ButtonBit(button)) != 0;
+  }
+  bool HasButtonUp(gvr::ControllerButton button) const {
+    return (buttons_up & ButtonBit(button)) != 0;
+  }
+  bool IsButtonPressed(gvr::ControllerButton button) const {
+    return (buttons_pressed & ButtonBit(button)) != 0;
+  }
+
+  int32_t controller_index;
+  // Buttons that were pressed and released.
+  uint32_t buttons_down;
+  uint32_t buttons_up;
+  // Buttons that are held down as of the latest read. The masks above lose
+  // the order of the transitions, so held-button actions settle on this.
+  uint32_t buttons_pressed;
+  // The direction of the latest swipe, if |has_swipe| is set.
+  bool has_swipe;
+  gvr_gesture_direction swipe_direction;
+  // The time of the latest button change, in nanoseconds.
+  int64_t button_timestamp;
+};
+
 /**
  * Represents a single 3DOF or 6DOF controller.
+ *
+ * The controller and its laser are nodes of a scene graph, so that objects
+ * can be attached to them. Their transforms are those of the graph's last
+ * Update().
  */
 class Controller {
  public:
   Controller(gvr::ControllerApi* gvr_controller_api, int32_t index,
-             gvr::ControllerHandedness handedness);
+             gvr::ControllerHandedness handedness, SceneGraph* scene);
+
+  // Starts over for a newly connected controller at the same index.
+  void Connect(gvr::ControllerApi* gvr_controller_api,
+               gvr::ControllerHandedness handedness);
 
+  // Reads the latest state, adding the button and gesture events since the
+  // previous read to |events|, and moves the nodes to the pose from it.
   void Update(gvr::ControllerApi* gvr_controller_api_,
               const gvr::Mat4f& head_space_from_start_space_transform,
-              float floor_offset);
+              float floor_offset, ControllerEvents* events);
 
   int32_t GetIndex() const { return index_; }
   gvr_beta_controller_configuration_type GetType() const { return type_; }
   const gvr::ControllerState& GetState() const { return state_; }
   const gvr::Vec3f& GetPosition() const { return position_; }
   const gvr::Quatf GetOrientation() const { return state_.GetOrientation(); }
-  const gvr::Mat4f& GetTransform() const { return transform_; }
-  const gvr::Mat4f& GetLaserTransform() const { return laser_transform_; }
+  const gvr::Mat4f& GetTransform() const {
+    return scene_->GetWorldTransform(node_);
+  }
+  const gvr::Mat4f& GetLaserTransform() const {
+    return scene_->GetWorldTransform(laser_node_);
+  }
+  // The node of the laser origin, pointing down its -z axis.
+  int GetLaserNode() const { return laser_node_; }
 
   // 6DOF controller tracking can fail if it becomes occluded or out of view.
   bool IsTracking() const { return is_tracking_; }
@@ -60,9 +114,12 @@ class Controller {
 
   float GetBatteryCharge() const { return battery_charge_; }
 
+ private:
+  void ReadState(gvr::ControllerApi* gvr_controller_api,
+                 ControllerEvents* events);
+
   bool GetSwipeGesture(gvr_gesture_direction* swipe_direction) const;
 
- private:
   void UpdateTrackingStatus();
 
   int32_t index_;
@@ -71,8 +128,10 @@ class Controller {
   gvr::ControllerState state_;
   gvr::GestureApi gesture_api_;
   gvr::Vec3f position_;
-  gvr::Mat4f transform_;
-  gvr::Mat4f laser_transform_;
+  SceneGraph* scene_;
+  int node_;
+  // A child of |node_|.
+  int laser_node_;
   bool show_laser_;
   bool is_tracking_;
   bool is_out_of_fov_;
@@ -84,17 +143,26 @@ class Controller {
  */
 class Controllers {
  public:
-  explicit Controllers(gvr::GvrApi* gvr_api);
-  void Initialize(JNIEnv* env, jobject java_asset_mgr,
-                  AAssetManager* asset_mgr);
+  // The controllers add their nodes to |scene|, which must outlive them.
+  Controllers(gvr::GvrApi* gvr_api, SceneGraph* scene);
+  // Queues the controller meshes and textures on the loaders. Called for
+  // each new GL context.
+  void Initialize(MeshLoader* mesh_loader, TextureLoader* texture_loader);
 
   void Pause();
   void Resume();
   void Update(const gvr::Mat4f& head_space_from_start_space_transform,
               float floor_offset);
 
-  void Draw(const gvr::Mat4f view[2],
-            const gvr::Mat4f view_projection[2]) const;
+  // Returns the events of each connected controller since the last
+  // ClearEvents() call, indexed by controller. Consumers handle all of them
+  // once per frame and then clear them.
+  const std::vector<ControllerEvents>& GetEvents() const { return events_; }
+  void ClearEvents();
+
+  // Adds the visible controllers and lasers to |draw_list|. The items refer
+  // to per-controller uniform values that stay valid until the next call.
+  void Submit(const gvr::Mat4f view[2], DrawList* draw_list);
 
   void ForEachLaser(
       const std::function<void(int, const gvr::Vec3f& origin,
@@ -102,23 +170,16 @@ class Controllers {
 
   void SetControllerForLaser(int index);
 
-  void SetOnClickDown(std::function<void(int)> on_click);
-  void SetOnClickUp(std::function<void(int)> on_click);
-  void SetOnTriggerDown(std::function<void(int)> on_trigger);
-  void SetOnTriggerUp(std::function<void(int)> on_trigger);
-  void SetOnGripDown(std::function<void(int)> on_grip);
-  void SetOnGripUp(std::function<void(int)> on_grip);
-  void SetOnAppButtonDown(std::function<void(int)> on_app_button);
-  void SetOnAppButtonUp(std::function<void(int)> on_app_button);
-  void SetOnSwipe(std::function<void(int, gvr_gesture_direction)> on_swipe);
-
   Controller& GetController(int index) { return controllers_[index]; }
 
  private:
-  void UpdateBatteryUniforms(const Controller& controller) const;
+  void GetBatteryUniforms(
+      const Controller& controller,
+      ControllerShaderProgram::ItemUniforms* uniforms) const;
   void ReconnectIfRequired();
 
   gvr::GvrApi* gvr_api_;
+  SceneGraph* scene_;
   std::unique_ptr<gvr::ControllerApi> gvr_controller_api_;
 
   ControllerShaderProgram controller_shader_;
@@ -130,17 +191,13 @@ class Controllers {
   TexturedMesh laser_mesh_;
   Texture laser_texture_;
 
+  // Every controller that has been connected. Only the first
+  // |controller_count_| are connected now, the rest are kept for reuse
+  // along with their gesture detectors.
   std::vector<Controller> controllers_;
-
-  std::function<void(int index)> on_click_down_;
-  std::function<void(int index)> on_click_up_;
-  std::function<void(int index)> on_trigger_down_;
-  std::function<void(int index)> on_trigger_up_;
-  std::function<void(int index)> on_grip_down_;
-  std::function<void(int index)> on_grip_up_;
-  std::function<void(int index)> on_app_button_down_;
-  std::function<void(int index)> on_app_button_up_;
-  std::function<void(int index, gvr_gesture_direction direction)> on_swipe_;
+  size_t controller_count_;
+  std::vector<ControllerShaderProgram::ItemUniforms> item_uniforms_;
+  std::vector<ControllerEvents> events_;
 };
 
 }  // namespace ndk_hello_vr_beta
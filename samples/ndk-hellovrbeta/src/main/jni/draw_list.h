@@ -0,0 +1,168 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_DRAW_LIST_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_DRAW_LIST_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "view_frustum.h"  // NOLINT
+#include "vr/gvr/capi/include/gvr_types.h"
+
+namespace ndk_hello_vr_beta {
+
+class Texture;
+class TexturedMesh;
+
+// Attribute location of the per-instance model matrix, which occupies this
+// location and the three following ones. Programs drawn through a DrawList
+// must bind their "a_Model" attribute here with glBindAttribLocation() before
+// linking.
+constexpr GLuint kModelMatrixAttribLocation = 4;
+
+// Attribute location of the per-instance texture layer, for programs that
+// sample an array texture; see Texture::InitializeArray(). Such programs bind
+// their float "a_TextureLayer" attribute here. It is only set with
+// instancing, since OpenGL ES 2.0 has neither array textures nor more than 8
+// guaranteed attribute locations.
+constexpr GLuint kTextureLayerAttribLocation = 8;
+
+// A program that draws meshes with a per-instance "a_Model" matrix attribute
+// and one view-projection uniform array.
+struct DrawProgram {
+  GLuint program;
+  GLint view_projection_uniform;
+};
+
+// How an item is combined with the framebuffer.
+enum class BlendMode : uint8_t {
+  kOpaque,
+  // Non-premultiplied alpha.
+  kAlpha,
+  kPremultipliedAlpha,
+};
+
+struct DrawItem {
+  const DrawProgram* program;
+  const Texture* texture;
+  // The layer of |texture| that the item samples, if it is an array texture.
+  // Items that differ only in their layer are still merged.
+  int texture_layer;
+  const TexturedMesh* mesh;
+  gvr::Mat4f model;
+  BlendMode blend_mode;
+  // If set, called with |uniform_data| right before the item is drawn to set
+  // uniforms of |program| that differ between items. Items with per-item
+  // uniforms are never merged with other items.
+  void (*set_uniforms)(const void* uniform_data);
+  const void* uniform_data;
+};
+
+// Collects the items of a frame, orders them and draws them with as few draw
+// calls and state changes as possible.
+//
+// Opaque items are drawn first, front to back, so that early depth testing
+// rejects hidden fragments. Items that share a program, texture and mesh are
+// merged into one instanced draw call first, and the merged batches are
+// ordered by their nearest item. Blended items are drawn afterwards, back to
+// front, and only neighbours in that order are merged so that blending stays
+// correct.
+//
+// Instancing requires OpenGL ES 3.0. Without it every item is drawn on its
+// own with the model matrix set as a constant attribute value.
+class DrawList {
+ public:
+  DrawList();
+  ~DrawList();
+
+  // Creates the GL resources in a new context. Must be called on the GL
+  // thread.
+  void Initialize(bool use_instancing);
+
+  // Removes all items, and resets the culled item count.
+  void Clear();
+
+  // Adds an item. |item| is copied; the objects it points to must stay alive
+  // until the list is cleared.
+  void Add(const DrawItem& item);
+
+  // Removes the items whose mesh's bounding sphere is outside |frustum|, so
+  // that nothing is submitted to GL for them. Call after the last Add() and
+  // before Prepare().
+  void Cull(const ViewFrustum& frustum);
+
+  // Orders and batches the items for a viewer at |head_view|, and uploads the
+  // instance data. Must be called after the last Add() and before Draw().
+  //
+  // The meshes and textures of the items are marked as used in
+  // GetResourceRegistry(). Items whose mesh is not loaded are left out.
+  void Prepare(const gvr::Mat4f& head_view);
+
+  // Draws the prepared items into the current framebuffer.
+  //
+  // @param view_projection |view_count| column-major matrices for the
+  //     view-projection uniform; 2 for multiview, 1 otherwise. Null if the
+  //     programs read them from a uniform block instead.
+  // @param view_count The number of matrices in |view_projection|.
+  void Draw(const float* view_projection, GLsizei view_count) const;
+
+  // Number of draw calls that Draw() issues for the prepared items.
+  size_t GetDrawCallCount() const { return batches_.size(); }
+
+  // Number of items that Cull() removed since the last Clear().
+  size_t GetCulledItemCount() const { return culled_item_count_; }
+
+ private:
+  struct SortedItem {
+    const DrawItem* item;
+    float depth;
+  };
+
+  struct Batch {
+    const DrawItem* first_item;
+    GLsizei first_instance;
+    GLsizei instance_count;
+    float depth;
+  };
+
+  // Appends |sorted| to |batches_|, merging neighbouring items where possible.
+  void AddBatches(const std::vector<SortedItem>& sorted);
+
+  bool use_instancing_;
+  GLuint instance_buffer_;
+
+  std::vector<DrawItem> items_;
+  size_t culled_item_count_;
+
+  // Scratch space kept between frames to avoid reallocating it.
+  std::vector<SortedItem> opaque_;
+  std::vector<SortedItem> blended_;
+  std::vector<Batch> batches_;
+  // The column-major model matrix and the texture layer of each item, in the
+  // order of |batches_|.
+  std::vector<float> instance_data_;
+
+  DrawList(const DrawList&) = delete;
+  DrawList& operator=(const DrawList&) = delete;
+};
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_DRAW_LIST_H_  // NOLINT
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_profiler.h"  // NOLINT
+
+#include <EGL/egl.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include "util.h"  // NOLINT
+
+namespace ndk_hello_vr_beta {
+
+namespace {
+
+const char* const kCpuPhaseNames[FrameTimings::kCpuPhaseCount] = {
+    "Pose", "Controllers", "DrawWorld", "Submit", "Audio",
+};
+
+const char* const kGpuPassCounterNames[FrameTimings::kMaxGpuPasses] = {
+    "GPU pass 0 (us)", "GPU pass 1 (us)",
+};
+
+// Index of each FrameTimings member in Slot::values.
+constexpr int kFrameIndexValue = 0;
+constexpr int kCpuFrameValue = 1;
+constexpr int kFirstCpuPhaseValue = 2;
+constexpr int kFirstGpuPassValue =
+    kFirstCpuPhaseValue + FrameTimings::kCpuPhaseCount;
+
+int64_t NowNanos() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// The ATrace functions of libandroid. They were added in API level 23
+// (ATrace_setCounter in 29), after the samples' minimum SDK version, so they
+// are looked up at runtime and may be null.
+struct ATraceFunctions {
+  bool (*is_enabled)();
+  void (*begin_section)(const char* name);
+  void (*end_section)();
+  void (*set_counter)(const char* name, int64_t value);
+};
+
+ATraceFunctions LoadATraceFunctions() {
+  ATraceFunctions functions = {};
+  void* library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+  if (library == nullptr) {
+    return functions;
+  }
+  functions.is_enabled =
+      reinterpret_cast<bool (*)()>(dlsym(library, "ATrace_isEnabled"));
+  functions.begin_section = reinterpret_cast<void (*)(const char*)>(
+      dlsym(library, "ATrace_beginSection"));
+  functions.end_section =
+      reinterpret_cast<void (*)()>(dlsym(library, "ATrace_endSection"));
+  functions.set_counter = reinterpret_cast<void (*)(const char*, int64_t)>(
+      dlsym(library, "ATrace_setCounter"));
+  if (functions.is_enabled == nullptr || functions.begin_section == nullptr ||
+      functions.end_section == nullptr) {
+    functions = ATraceFunctions();
+  }
+  // The library stays loaded for the lifetime of the process.
+  return functions;
+}
+
+const ATraceFunctions& GetATrace() {
+  static const ATraceFunctions functions = LoadATraceFunctions();
+  return functions;
+}
+
+bool IsTracing() {
+  const ATraceFunctions& trace = GetATrace();
+  return trace.is_enabled != nullptr && trace.is_enabled();
+}
+
+void SetTraceCounter(const char* name, int64_t value) {
+  const ATraceFunctions& trace = GetATrace();
+  if (trace.set_counter != nullptr && IsTracing()) {
+    trace.set_counter(name, value);
+  }
+}
+
+}  // anonymous namespace
+
+constexpr int FrameTimings::kCpuPhaseCount;
+constexpr int FrameTimings::kMaxGpuPasses;
+constexpr int FrameProfiler::kHistorySize;
+constexpr int FrameProfiler::kGpuResultFrames;
+constexpr int FrameProfiler::kValueCount;
+constexpr int FrameProfiler::kQueryFrames;
+
+FrameProfiler::ScopedCpuTimer::ScopedCpuTimer(FrameProfiler* profiler,
+                                              CpuPhase phase)
+    : profiler_(profiler), phase_(phase), start_ns_(NowNanos()) {
+  if (IsTracing()) {
+    GetATrace().begin_section(kCpuPhaseNames[static_cast<int>(phase)]);
+  }
+}
+
+FrameProfiler::ScopedCpuTimer::~ScopedCpuTimer() {
+  profiler_->current_.cpu_phase_ns[static_cast<int>(phase_)] +=
+      NowNanos() - start_ns_;
+  if (IsTracing()) {
+    GetATrace().end_section();
+  }
+}
+
+FrameProfiler::FrameProfiler()
+    : completed_frames_(0),
+      current_(),
+      frame_start_ns_(0),
+      active_gpu_pass_(-1),
+      gpu_timing_supported_(false),
+      query_sets_(),
+      gen_queries_(nullptr),
+      delete_queries_(nullptr),
+      begin_query_(nullptr),
+      end_query_(nullptr),
+      get_query_object_uiv_(nullptr),
+      get_query_object_ui64v_(nullptr) {
+  for (Slot& slot : history_) {
+    slot.sequence.store(0, std::memory_order_relaxed);
+    for (std::atomic<int64_t>& value : slot.values) {
+      value.store(-1, std::memory_order_relaxed);
+    }
+  }
+}
+
+FrameProfiler::~FrameProfiler() {
+  if (gpu_timing_supported_) {
+    for (QuerySet& query_set : query_sets_) {
+      delete_queries_(FrameTimings::kMaxGpuPasses, query_set.queries);
+    }
+  }
+}
+
+void FrameProfiler::InitializeGl() {
+  // A new context has none of the old queries, so this does not delete them.
+  gpu_timing_supported_ = false;
+  if (!HasGLExtension("GL_EXT_disjoint_timer_query")) {
+    LOGD("GL_EXT_disjoint_timer_query is not supported, not timing the GPU.");
+    return;
+  }
+  gen_queries_ = reinterpret_cast<PFNGLGENQUERIESEXTPROC>(
+      eglGetProcAddress("glGenQueriesEXT"));
+  delete_queries_ = reinterpret_cast<PFNGLDELETEQUERIESEXTPROC>(
+      eglGetProcAddress("glDeleteQueriesEXT"));
+  begin_query_ = reinterpret_cast<PFNGLBEGINQUERYEXTPROC>(
+      eglGetProcAddress("glBeginQueryEXT"));
+  end_query_ = reinterpret_cast<PFNGLENDQUERYEXTPROC>(
+      eglGetProcAddress("glEndQueryEXT"));
+  get_query_object_uiv_ = reinterpret_cast<PFNGLGETQUERYOBJECTUIVEXTPROC>(
+      eglGetProcAddress("glGetQueryObjectuivEXT"));
+  get_query_object_ui64v_ = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(
+      eglGetProcAddress("glGetQueryObjectui64vEXT"));
+  if (gen_queries_ == nullptr || delete_queries_ == nullptr ||
+      begin_query_ == nullptr || end_query_ == nullptr ||
+      get_query_object_uiv_ == nullptr || get_query_object_ui64v_ == nullptr) {
+    LOGE("GL_EXT_disjoint_timer_query entry points are missing.");
+    return;
+  }
+  for (QuerySet& query_set : query_sets_) {
+    gen_queries_(FrameTimings::kMaxGpuPasses, query_set.queries);
+    for (bool& used : query_set.used) {
+      used = false;
+    }
+    query_set.frame_index = -1;
+  }
+  // Clear a disjoint event that may have happened before now.
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  gpu_timing_supported_ = true;
+}
+
+void FrameProfiler::BeginFrame() {
+  const int64_t frame_index = completed_frames_.load(std::memory_order_relaxed);
+  current_ = FrameTimings();
+  current_.frame_index = frame_index;
+  for (int64_t& gpu_pass_ns : current_.gpu_pass_ns) {
+    gpu_pass_ns = -1;
+  }
+  frame_start_ns_ = NowNanos();
+
+  if (gpu_timing_supported_) {
+    // Collect the oldest frame's results before its queries are reused.
+    QuerySet* query_set = &query_sets_[frame_index % kQueryFrames];
+    ReadBackGpuTimings(query_set);
+    query_set->frame_index = frame_index;
+  }
+}
+
+void FrameProfiler::EndFrame() {
+  current_.cpu_frame_ns = NowNanos() - frame_start_ns_;
+  WriteSlot(current_);
+  completed_frames_.store(current_.frame_index + 1, std::memory_order_release);
+  SetTraceCounter("CPU frame (us)", current_.cpu_frame_ns / 1000);
+}
+
+void FrameProfiler::BeginGpuPass(int pass) {
+  if (!gpu_timing_supported_ || pass < 0 ||
+      pass >= FrameTimings::kMaxGpuPasses || active_gpu_pass_ >= 0) {
+    return;
+  }
+  QuerySet& query_set = query_sets_[current_.frame_index % kQueryFrames];
+  begin_query_(GL_TIME_ELAPSED_EXT, query_set.queries[pass]);
+  query_set.used[pass] = true;
+  active_gpu_pass_ = pass;
+}
+
+void FrameProfiler::EndGpuPass() {
+  if (active_gpu_pass_ < 0) {
+    return;
+  }
+  end_query_(GL_TIME_ELAPSED_EXT);
+  active_gpu_pass_ = -1;
+}
+
+void FrameProfiler::ReadBackGpuTimings(QuerySet* query_set) {
+  if (query_set->frame_index < 0) {
+    return;
+  }
+  // A disjoint event, such as a frequency change, makes all results that
+  // are in flight meaningless.
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+  FrameTimings timings;
+  const bool in_history = ReadSlot(query_set->frame_index, &timings);
+  for (int pass = 0; pass < FrameTimings::kMaxGpuPasses; ++pass) {
+    if (!query_set->used[pass]) {
+      continue;
+    }
+    query_set->used[pass] = false;
+    GLuint available = 0;
+    get_query_object_uiv_(query_set->queries[pass],
+                          GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+    if (!available || disjoint) {
+      continue;
+    }
+    GLuint64 elapsed_ns = 0;
+    get_query_object_ui64v_(query_set->queries[pass], GL_QUERY_RESULT_EXT,
+                            &elapsed_ns);
+    timings.gpu_pass_ns[pass] = static_cast<int64_t>(elapsed_ns);
+    SetTraceCounter(kGpuPassCounterNames[pass],
+                    static_cast<int64_t>(elapsed_ns / 1000));
+  }
+  if (in_history) {
+    WriteSlot(timings);
+  }
+}
+
+void FrameProfiler::WriteSlot(const FrameTimings& timings) {
+  Slot& slot = history_[timings.frame_index % kHistorySize];
+  const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.values[kFrameIndexValue].store(timings.frame_index,
+                                      std::memory_order_relaxed);
+  slot.values[kCpuFrameValue].store(timings.cpu_frame_ns,
+                                    std::memory_order_relaxed);
+  for (int i = 0; i < FrameTimings::kCpuPhaseCount; ++i) {
+    slot.values[kFirstCpuPhaseValue + i].store(timings.cpu_phase_ns[i],
+                                               std::memory_order_relaxed);
+  }
+  for (int i = 0; i < FrameTimings::kMaxGpuPasses; ++i) {
+    slot.values[kFirstGpuPassValue + i].store(timings.gpu_pass_ns[i],
+                                              std::memory_order_relaxed);
+  }
+
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool FrameProfiler::GetTimings(int frames_ago, FrameTimings* timings) const {
+  const int64_t completed = completed_frames_.load(std::memory_order_acquire);
+  const int64_t frame_index = completed - 1 - frames_ago;
+  if (frames_ago < 0 || frames_ago >= kHistorySize || frame_index < 0) {
+    return false;
+  }
+  return ReadSlot(frame_index, timings);
+}
+
+bool FrameProfiler::ReadSlot(int64_t frame_index,
+                             FrameTimings* timings) const {
+  const Slot& slot = history_[frame_index % kHistorySize];
+  while (true) {
+    const uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      continue;
+    }
+    timings->frame_index =
+        slot.values[kFrameIndexValue].load(std::memory_order_relaxed);
+    timings->cpu_frame_ns =
+        slot.values[kCpuFrameValue].load(std::memory_order_relaxed);
+    for (int i = 0; i < FrameTimings::kCpuPhaseCount; ++i) {
+      timings->cpu_phase_ns[i] =
+          slot.values[kFirstCpuPhaseValue + i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < FrameTimings::kMaxGpuPasses; ++i) {
+      timings->gpu_pass_ns[i] =
+          slot.values[kFirstGpuPassValue + i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+      break;
+    }
+  }
+  // The slot may already hold a newer frame if the writer lapped the reader.
+  return timings->frame_index == frame_index;
+}
+
+}  // namespace ndk_hello_vr_beta
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gl_state_cache.h"  // NOLINT
+
+namespace ndk_hello_vr_beta {
+
+constexpr int GlStateCache::kMaxTextureUnits;
+constexpr GLuint GlStateCache::kUnknown;
+
+GlStateCache::GlStateCache() : stats_() { Invalidate(); }
+
+void GlStateCache::Invalidate() {
+  program_ = kUnknown;
+  active_texture_unit_ = kUnknown;
+  for (TextureBinding& binding : texture_bindings_) {
+    binding.target = kUnknown;
+    binding.texture = kUnknown;
+  }
+  for (TriState& capability : capabilities_) {
+    capability = kStateUnknown;
+  }
+  blend_source_factor_ = kUnknown;
+  blend_destination_factor_ = kUnknown;
+  depth_mask_ = kStateUnknown;
+}
+
+bool GlStateCache::Count(bool changed) {
+  if (changed) {
+    ++stats_.issued_calls;
+  } else {
+    ++stats_.skipped_calls;
+  }
+  return changed;
+}
+
+void GlStateCache::UseProgram(GLuint program) {
+  if (Count(program != program_)) {
+    glUseProgram(program);
+    program_ = program;
+  }
+}
+
+void GlStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture) {
+  if (Count(unit != active_texture_unit_)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    active_texture_unit_ = unit;
+  }
+  if (unit >= static_cast<GLuint>(kMaxTextureUnits)) {
+    Count(true);
+    glBindTexture(target, texture);
+    return;
+  }
+  // Only the most recent bind of each unit is remembered, so alternating
+  // between targets on one unit issues redundant binds but is never wrong.
+  TextureBinding& binding = texture_bindings_[unit];
+  if (Count(binding.target != target || binding.texture != texture)) {
+    glBindTexture(target, texture);
+    binding.target = target;
+    binding.texture = texture;
+  }
+}
+
+void GlStateCache::SetCapability(GLenum capability, bool enabled) {
+  const int index = CapabilityIndex(capability);
+  const TriState state = enabled ? kStateOn : kStateOff;
+  if (Count(index < 0 || capabilities_[index] != state)) {
+    if (enabled) {
+      glEnable(capability);
+    } else {
+      glDisable(capability);
+    }
+    if (index >= 0) capabilities_[index] = state;
+  }
+}
+
+void GlStateCache::BlendFunc(GLenum source_factor,
+                             GLenum destination_factor) {
+  if (Count(source_factor != blend_source_factor_ ||
+            destination_factor != blend_destination_factor_)) {
+    glBlendFunc(source_factor, destination_factor);
+    blend_source_factor_ = source_factor;
+    blend_destination_factor_ = destination_factor;
+  }
+}
+
+void GlStateCache::DepthMask(bool enabled) {
+  const TriState state = enabled ? kStateOn : kStateOff;
+  if (Count(state != depth_mask_)) {
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    depth_mask_ = state;
+  }
+}
+
+void GlStateCache::OnProgramDeleted(GLuint program) {
+  // Deleting the current program only flags it for deletion, but a later
+  // program with the same name must not be mistaken for it.
+  if (program == program_) {
+    program_ = kUnknown;
+  }
+}
+
+void GlStateCache::OnTextureDeleted(GLuint texture) {
+  for (TextureBinding& binding : texture_bindings_) {
+    if (binding.texture == texture) {
+      binding.texture = kUnknown;
+    }
+  }
+}
+
+int GlStateCache::CapabilityIndex(GLenum capability) {
+  switch (capability) {
+    case GL_BLEND:
+      return kBlend;
+    case GL_CULL_FACE:
+      return kCullFace;
+    case GL_DEPTH_TEST:
+      return kDepthTest;
+    case GL_SCISSOR_TEST:
+      return kScissorTest;
+    default:
+      return -1;
+  }
+}
+
+void GlStateCache::ResetStats() { stats_ = Stats(); }
+
+GlStateCache& GetGlStateCache() {
+  static GlStateCache cache;
+  return cache;
+}
+
+}  // namespace ndk_hello_vr_beta
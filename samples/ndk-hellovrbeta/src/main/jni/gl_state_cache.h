@@ -0,0 +1,116 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_GL_STATE_CACHE_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_GL_STATE_CACHE_H_  // NOLINT
+
+#include <GLES2/gl2.h>
+#include <cstdint>
+
+namespace ndk_hello_vr_beta {
+
+// Shadows the GL state that the sample changes most often and skips calls
+// that would set a value that is already current.
+//
+// All state goes through the cache on the GL thread. Anything else that
+// changes this state behind the cache's back, such as the GVR distortion
+// renderer in Frame::Submit(), must be followed by Invalidate().
+class GlStateCache {
+ public:
+  // Number of texture units whose bindings are tracked. Binds to higher units
+  // are always issued.
+  static constexpr int kMaxTextureUnits = 8;
+
+  struct Stats {
+    // Calls that were passed on to GL.
+    uint32_t issued_calls;
+    // Calls that were skipped because they matched the current state.
+    uint32_t skipped_calls;
+  };
+
+  GlStateCache();
+
+  // Forgets all shadowed state, so that the next call of each kind is issued.
+  void Invalidate();
+
+  void UseProgram(GLuint program);
+
+  // Binds |texture| to |target| on texture unit |unit|, selecting the unit
+  // only if it is not already active.
+  void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+  // Enables or disables one of GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST or
+  // GL_SCISSOR_TEST. Other capabilities are always passed on to GL.
+  void SetCapability(GLenum capability, bool enabled);
+
+  void BlendFunc(GLenum source_factor, GLenum destination_factor);
+
+  void DepthMask(bool enabled);
+
+  // Must be called before deleting GL objects, since GL implicitly unbinds
+  // deleted objects.
+  void OnProgramDeleted(GLuint program);
+  void OnTextureDeleted(GLuint texture);
+
+  const Stats& GetStats() const { return stats_; }
+  void ResetStats();
+
+ private:
+  // Shadowed enum and object values use this to mean "not known".
+  static constexpr GLuint kUnknown = 0xFFFFFFFF;
+
+  enum Capability {
+    kBlend,
+    kCullFace,
+    kDepthTest,
+    kScissorTest,
+    kCapabilityCount,
+  };
+
+  enum TriState : uint8_t { kStateUnknown, kStateOff, kStateOn };
+
+  struct TextureBinding {
+    GLenum target;
+    GLuint texture;
+  };
+
+  // Returns the index into |capabilities_|, or -1 if |capability| is not
+  // tracked.
+  static int CapabilityIndex(GLenum capability);
+
+  // Records one call, and returns true if it has to be issued.
+  bool Count(bool changed);
+
+  GLuint program_;
+  GLuint active_texture_unit_;
+  TextureBinding texture_bindings_[kMaxTextureUnits];
+  TriState capabilities_[kCapabilityCount];
+  GLenum blend_source_factor_;
+  GLenum blend_destination_factor_;
+  TriState depth_mask_;
+
+  Stats stats_;
+
+  GlStateCache(const GlStateCache&) = delete;
+  GlStateCache& operator=(const GlStateCache&) = delete;
+};
+
+// Returns the cache for the GL context of the render thread.
+GlStateCache& GetGlStateCache();
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_GL_STATE_CACHE_H_  // NOLINT
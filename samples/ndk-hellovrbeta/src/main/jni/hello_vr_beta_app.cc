@@ -22,7 +22,9 @@
 #include <stdlib.h>
 #include <cmath>
 
-#include "util.h"  // NOLINT
+#include "gl_state_cache.h"  // NOLINT
+#include "program_cache.h"   // NOLINT
+#include "util.h"            // NOLINT
 #include "vr/gvr/capi/include/gvr_types.h"
 #include "vr/gvr/capi/include/gvr_version.h"
 
@@ -37,6 +39,9 @@ static constexpr float kNeckModelFactor = 1.0f;
 // set so that the objects are always within a range, which is about 5 meters
 // across.
 static constexpr float kTargetRadius = 0.5f;
+// The layers of the target texture when it is not selected and when it is.
+static constexpr int kNotSelectedLayer = 0;
+static constexpr int kSelectedLayer = 1;
 static constexpr float kMinTargetDistance = 2.5f;
 static constexpr float kMaxTargetDistance = 3.5f;
 static constexpr float kMinTargetHeight = kTargetRadius;
@@ -46,7 +51,52 @@ static constexpr float kMaxTargetHeight = kMinTargetHeight + 3.0f;
 // are too far, 6DOF tracking will have no visible effect.
 static constexpr float kDefaultFloorOffset = -1.7f;
 
-static constexpr uint64_t kPredictionTimeWithoutVsyncNanos = 50000000;
+// Upper bound on the texture data uploaded per frame while textures are still
+// loading, which keeps each upload well inside a frame.
+static constexpr size_t kTextureUploadBytesPerFrame = 4 * 1024 * 1024;
+
+// The GPU memory that meshes and textures may use before the least recently
+// drawn ones are evicted; see ResourceRegistry.
+static constexpr size_t kResourceBudgetBytes = 64 * 1024 * 1024;
+
+// Levels of ComponentCallbacks2.onTrimMemory(). From the first, the decoded
+// image cache is dropped; from the second, also everything that the current
+// frame does not draw.
+static constexpr int kTrimMemoryRunningModerate = 5;
+static constexpr int kTrimMemoryRunningLow = 10;
+
+// Refresh rate assumed until the activity reports the display's own.
+static constexpr float kDefaultRefreshRate = 60.0f;
+
+// Objects are culled against views that are this much wider than the eyes'
+// fields of view, in degrees, so that the newer pose from late latching does
+// not reveal culled objects at the edges.
+static constexpr float kCullingMarginDegrees = 5.0f;
+
+// Whether to draw a graph of the recent CPU and GPU frame times. The timings
+// are recorded, and sent to systrace when it is capturing, either way.
+static constexpr bool kShowProfilerOverlay = false;
+
+// Whether to read the head pose again right before submitting the frame, and
+// to patch it into the view matrices of the draws that have already been
+// issued. Needs GL_EXT_buffer_storage; see ViewUniforms.
+static constexpr bool kLateLatchHeadPose = true;
+
+// Benchmark runs, for comparing builds and devices with the same head motion.
+// kRecord appends the head pose of every frame to kPoseTraceFile in the cache
+// directory, saving it whenever the app pauses. kReplay plays that trace back
+// once, in place of head tracking, as soon as the meshes are loaded, and then
+// writes percentiles of the frame timings and counts to kBenchmarkReportFile
+// next to it. Controller input and GVR properties other than the floor offset
+// baked into the poses are not replayed. kMicro instead times the math,
+// picking and mesh parsing routines at startup and writes
+// kMicroBenchmarkReportFile; see RunMicroBenchmarks().
+enum class BenchmarkMode { kOff, kRecord, kReplay, kMicro };
+static constexpr BenchmarkMode kBenchmarkMode = BenchmarkMode::kOff;
+static constexpr const char* kPoseTraceFile = "pose_trace.bin";
+static constexpr const char* kBenchmarkReportFile = "benchmark.json";
+static constexpr const char* kMicroBenchmarkReportFile =
+    "micro_benchmarks.json";
 
 // Sound file in APK assets.
 static constexpr const char* kObjectSoundFile = "audio/HelloVRBeta_Loop.ogg";
@@ -56,59 +106,77 @@ static constexpr const char* kSuccessSoundFile =
 
 HelloVrBetaApp::HelloVrBetaApp(JNIEnv* env, jobject asset_mgr_obj,
                                gvr_context* gvr_context,
-                               std::unique_ptr<gvr::AudioApi> gvr_audio_api)
+                               std::unique_ptr<gvr::AudioApi> gvr_audio_api,
+                               const std::string& cache_dir)
     : context_(gvr_context),
       gvr_api_(gvr::GvrApi::WrapNonOwned(gvr_context)),
       gvr_audio_api_(std::move(gvr_audio_api)),
       viewports_{gvr_api_->CreateBufferViewport(),
                  gvr_api_->CreateBufferViewport()},
+      gl_context_(EGL_NO_CONTEXT),
       see_through_config_(gvr_beta_see_through_config_create(gvr_context)),
       see_through_mode_(SHOW_SEE_THROUGH),
       see_through_effect_(GVR_BETA_SEE_THROUGH_CAMERA_MODE_RAW_IMAGE),
-      controllers_(gvr_api_.get()),
+      room_node_(scene_.AddNode(-1, GetTranslationMatrix({0.0f, 0.0f, 0.0f}))),
+      target_node_(
+          scene_.AddNode(-1, GetTranslationMatrix({0.0f, 0.0f, 0.0f}))),
+      controllers_(gvr_api_.get(), &scene_),
       controller_on_target_index_(-1),
       target_held_(false),
-      audio_source_id_(-1),
-      success_source_id_(-1),
+      mesh_loader_(new MeshLoader(AAssetManager_fromJava(env, asset_mgr_obj))),
+      texture_loader_(new TextureLoader(env, asset_mgr_obj)),
+      meshes_loading_(false),
+      frame_budget_ns_(1e9f / kDefaultRefreshRate),
+      cache_dir_(cache_dir),
+      replay_start_frame_(-1),
+      frame_draw_calls_(0),
+      last_gl_calls_(0),
+      audio_player_(gvr_audio_api_.get(),
+                    {kObjectSoundFile, kSuccessSoundFile}),
+      target_voice_(-1),
       java_asset_mgr_(env->NewGlobalRef(asset_mgr_obj)),
       asset_mgr_(AAssetManager_fromJava(env, asset_mgr_obj)) {
   LOGD("Built with GVR version: %s", GVR_SDK_VERSION_STRING);
-
-  controllers_.SetOnClickDown(
-      [this](int controller_index) { OnTrigger(controller_index); });
-  controllers_.SetOnTriggerDown(
-      [this](int controller_index) { OnTrigger(controller_index); });
-  controllers_.SetOnAppButtonDown(
-      [this](int controller_index) { OnGrabTarget(controller_index); });
-  controllers_.SetOnAppButtonUp(
-      [this](int controller_index) { OnReleaseTarget(controller_index); });
-  controllers_.SetOnGripDown(
-      [this](int controller_index) { OnGrabTarget(controller_index); });
-  controllers_.SetOnGripUp(
-      [this](int controller_index) { OnReleaseTarget(controller_index); });
-  controllers_.SetOnSwipe(
-      [this](int controller_index, gvr_gesture_direction direction) {
-        OnSwipe(controller_index, direction);
-      });
-}
-
-HelloVrBetaApp::~HelloVrBetaApp() {
-  // Join the audio initialization thread in case it still exists.
-  if (audio_initialization_thread_.joinable()) {
-    audio_initialization_thread_.join();
+  RefreshEyeFromHeadMatrices();
+  GetProgramCache().SetDirectory(cache_dir);
+  if (kBenchmarkMode == BenchmarkMode::kReplay &&
+      !pose_trace_.Load(cache_dir_ + "/" + kPoseTraceFile)) {
+    LOGE("No pose trace to replay in %s.", cache_dir_.c_str());
+  }
+  if (kBenchmarkMode == BenchmarkMode::kMicro) {
+    RunMicroBenchmarks(asset_mgr_,
+                       cache_dir_ + "/" + kMicroBenchmarkReportFile);
   }
 }
 
+HelloVrBetaApp::~HelloVrBetaApp() {}
+
 void HelloVrBetaApp::OnSurfaceCreated(JNIEnv* env) {
+  // GLSurfaceView only calls this for a new context, so every GL object is
+  // created again. Those of a lost context went away with it and are not
+  // deleted; the meshes forget them so that nothing uses or evicts their
+  // names before they are uploaded again.
+  gl_context_ = eglGetCurrentContext();
+  room_.Forget();
+  target_object_mesh_.Forget();
+
   gvr_api_->InitializeGl();
+  // This is a new context, so nothing is known about its state.
+  GetGlStateCache().Invalidate();
 
   HELLOVRBETA_CHECK(gvr_api_->IsFeatureSupported(GVR_FEATURE_MULTIVIEW));
 
   // Initialize the see-through settings.
   UpdateSeeThroughSettings();
 
+  view_uniforms_.Initialize();
   shader_.Link();
   alpha_shader_.Link();
+  draw_list_.Initialize(/*use_instancing=*/true);
+  profiler_.InitializeGl();
+  if (kShowProfilerOverlay) {
+    profiler_overlay_.Initialize();
+  }
 
   CheckGLError("Obj program");
 
@@ -119,26 +187,29 @@ void HelloVrBetaApp::OnSurfaceCreated(JNIEnv* env) {
 
   CheckGLError("Obj program params");
 
-  controllers_.Initialize(env, java_asset_mgr_, asset_mgr_);
+  // The meshes are parsed in parallel and uploaded over the next frames.
+  controllers_.Initialize(mesh_loader_.get(), texture_loader_.get());
 
-  HELLOVRBETA_CHECK(room_.Initialize(asset_mgr_, "CubeRoom.obj",
-                                     alpha_position_param, alpha_uv_param));
-  HELLOVRBETA_CHECK(room_texture_.Initialize(env, java_asset_mgr_,
-                                             "CubeRoom_BakedDiffuse.png"));
-  HELLOVRBETA_CHECK(target_object_mesh_.Initialize(asset_mgr_, "TriSphere.obj",
-                                                   position_param, uv_param));
-  HELLOVRBETA_CHECK(target_object_not_selected_texture_.Initialize(
-      env, java_asset_mgr_, "TriSphere_Blue_BakedDiffuse.png"));
-  HELLOVRBETA_CHECK(target_object_selected_texture_.Initialize(
-      env, java_asset_mgr_, "TriSphere_Pink_BakedDiffuse.png"));
+  mesh_loader_->Load("CubeRoom.mesh", alpha_position_param, alpha_uv_param,
+                     &room_);
+  room_texture_.Initialize(texture_loader_.get(), "CubeRoom_BakedDiffuse.png");
+  mesh_loader_->Load("TriSphere.mesh", position_param, uv_param,
+                     &target_object_mesh_);
+  // In the order of kNotSelectedLayer and kSelectedLayer.
+  target_object_texture_.InitializeArray(
+      texture_loader_.get(),
+      {"TriSphere_Blue_BakedDiffuse.png", "TriSphere_Pink_BakedDiffuse.png"});
+  meshes_loading_ = true;
 
   // Target object first appears directly in front of user.
   SetTargetPosition({0.0f, 1.0f, -kMinTargetDistance});
 
   // Because we are using 2X MSAA, we can render to half as many pixels and
   // achieve similar quality.
-  render_size_ =
+  recommended_render_size_ =
       HalfPixelCount(gvr_api_->GetMaximumEffectiveRenderTargetSize());
+  render_size_ = recommended_render_size_;
+  resolution_controller_.Reset();
   std::vector<gvr::BufferSpec> specs;
 
   specs.push_back(gvr_api_->CreateBufferSpec());
@@ -153,6 +224,7 @@ void HelloVrBetaApp::OnSurfaceCreated(JNIEnv* env) {
   specs[0].SetSize(half_size);
 
   swapchain_.reset(new gvr::SwapChain(gvr_api_->CreateSwapChain(specs)));
+  TrackSwapChainMemory();
 
   viewport_list_.reset(
       new gvr::BufferViewportList(gvr_api_->CreateEmptyBufferViewportList()));
@@ -164,11 +236,12 @@ void HelloVrBetaApp::OnSurfaceCreated(JNIEnv* env) {
     viewports_[eye].SetSourceLayer(eye);
     viewport_list_->SetBufferViewport(eye, viewports_[eye]);
   }
-  // Initialize audio engine and preload sample in a separate thread to avoid
-  // any delay during construction and app initialization. Only do this once.
-  if (!audio_initialization_thread_.joinable()) {
-    audio_initialization_thread_ =
-        std::thread(&HelloVrBetaApp::LoadAndPlayTargetObjectSound, this);
+  // Start the target sound at the current target location once the sounds
+  // are preloaded. Only do this once.
+  if (target_voice_ < 0) {
+    target_voice_ = audio_player_.PlayLooping(
+        kObjectSoundFile,
+        GetMatrixTranslation(scene_.GetLocalTransform(target_node_)));
   }
 }
 
@@ -183,57 +256,250 @@ float HelloVrBetaApp::GetFloorOffset() {
   return kDefaultFloorOffset;
 }
 
-void HelloVrBetaApp::OnDrawFrame() {
-  gvr::Frame frame = swapchain_->AcquireFrame();
-
-  // A client app does its rendering here.
-  gvr::ClockTimePoint target_time = gvr::GvrApi::GetTimePointNow();
-  target_time.monotonic_system_time_nanos += kPredictionTimeWithoutVsyncNanos;
-
+gvr::Mat4f HelloVrBetaApp::GetHeadView(const gvr::ClockTimePoint& target_time,
+                                       float floor_offset) {
+  const int64_t replay_frame = GetReplayFrame();
+  if (replay_frame >= 0) {
+    return pose_trace_.GetPose(static_cast<size_t>(replay_frame));
+  }
   // Note that neck model is a no-op, unless head-tracking is lost.
-  gvr::Mat4f head_view = gvr_api_->ApplyNeckModel(
+  const gvr::Mat4f head_view = gvr_api_->ApplyNeckModel(
       gvr_api_->GetHeadSpaceFromStartSpaceTransform(target_time),
       kNeckModelFactor);
-
-  // This may change when the floor height changes so it's computed every frame.
-  float floor_offset = GetFloorOffset();
   // Incorporate the floor height into the head_view
-  head_view =
-      MatrixMul(head_view, GetTranslationMatrix({0.0f, floor_offset, 0.0f}));
+  return MatrixMul(head_view,
+                   GetTranslationMatrix({0.0f, floor_offset, 0.0f}));
+}
 
-  gvr::Mat4f view[2];
+void HelloVrBetaApp::ComputeViews(const gvr::Mat4f& head_view,
+                                  gvr::Mat4f view[2],
+                                  gvr::Mat4f projection[2]) const {
+  for (int eye = 0; eye < 2; ++eye) {
+    view[eye] = MatrixMul(eye_from_head_[eye], head_view);
+    projection[eye] = ProjectionMatrixFromView(viewports_[eye].GetSourceFov(),
+                                               kZNear, kZFar);
+  }
+}
+
+ViewFrustum HelloVrBetaApp::GetCullingFrustum(
+    const gvr::Mat4f view[2]) const {
   gvr::Mat4f view_projection[2];
   for (int eye = 0; eye < 2; ++eye) {
-    view[eye] = MatrixMul(
-        gvr_api_->GetEyeFromHeadMatrix(static_cast<gvr::Eye>(eye)), head_view);
-    gvr::Mat4f projection =
-        ProjectionMatrixFromView(viewports_[eye].GetSourceFov(), kZNear, kZFar);
-    view_projection[eye] = MatrixMul(projection, view[eye]);
+    const gvr::Rectf fov =
+        WidenFov(viewports_[eye].GetSourceFov(), kCullingMarginDegrees);
+    view_projection[eye] =
+        MatrixMul(ProjectionMatrixFromView(fov, kZNear, kZFar), view[eye]);
+  }
+  ViewFrustum frustum;
+  frustum.Set(view_projection);
+  return frustum;
+}
+
+void HelloVrBetaApp::RefreshEyeFromHeadMatrices() {
+  eye_from_head_[0] = gvr_api_->GetEyeFromHeadMatrix(GVR_LEFT_EYE);
+  eye_from_head_[1] = gvr_api_->GetEyeFromHeadMatrix(GVR_RIGHT_EYE);
+}
+
+int64_t HelloVrBetaApp::GetReplayFrame() const {
+  if (replay_start_frame_ < 0) {
+    return -1;
+  }
+  const int64_t frame = profiler_.GetFrameIndex() - replay_start_frame_;
+  return frame < static_cast<int64_t>(pose_trace_.GetFrameCount()) ? frame
+                                                                   : -1;
+}
+
+void HelloVrBetaApp::UpdateBenchmark(const gvr::Mat4f& head_view) {
+  const uint32_t gl_calls = GetGlStateCache().GetStats().issued_calls;
+  const uint32_t frame_gl_calls = gl_calls - last_gl_calls_;
+  last_gl_calls_ = gl_calls;
+  if (kBenchmarkMode == BenchmarkMode::kRecord) {
+    pose_trace_.Append(head_view);
+    return;
+  }
+  if (replay_start_frame_ < 0) {
+    return;
+  }
+  if (GetReplayFrame() >= 0) {
+    benchmark_report_.AddCounts(frame_draw_calls_, frame_gl_calls);
+    const ResourceRegistry::Totals memory = GetResourceRegistry().GetTotals();
+    benchmark_report_.AddMemory(memory.GetCpuBytes(), memory.GetGpuBytes());
+  }
+  // The GPU timings of a frame are only known a few frames later, so the
+  // timings trail the counts, and the run ends a few frames after the trace.
+  FrameTimings timings;
+  if (!profiler_.GetTimings(FrameProfiler::kGpuResultFrames, &timings) ||
+      timings.frame_index < replay_start_frame_) {
+    return;
+  }
+  benchmark_report_.AddTimings(timings);
+  const int64_t last_frame = replay_start_frame_ +
+                             static_cast<int64_t>(pose_trace_.GetFrameCount()) -
+                             1;
+  if (timings.frame_index < last_frame) {
+    return;
+  }
+  LOGD("Benchmark: %s", benchmark_report_.ToJson().c_str());
+  benchmark_report_.Write(cache_dir_ + "/" + kBenchmarkReportFile);
+  benchmark_report_.Clear();
+  pose_trace_.Clear();
+  replay_start_frame_ = -1;
+}
+
+void HelloVrBetaApp::UpdateRenderScale() {
+  if (resolution_controller_.Update(profiler_, frame_budget_ns_)) {
+    render_size_ =
+        resolution_controller_.GetBufferSize(recommended_render_size_);
+    // Multiview uses two texture layers, each with half the render width.
+    const gvr::Sizei half_size = {render_size_.width / 2, render_size_.height};
+    swapchain_->ResizeBuffer(0, half_size);
+    TrackSwapChainMemory();
+  }
+  // Only the part of the buffer that matches the render scale is drawn.
+  const gvr_rectf fullscreen = {0, 1, 0, 1};
+  const gvr::Rectf source_uv = resolution_controller_.ScaleSourceUv(fullscreen);
+  for (int eye = 0; eye < 2; ++eye) {
+    viewports_[eye].SetSourceUv(source_uv);
+    viewport_list_->SetBufferViewport(eye, viewports_[eye]);
+  }
+}
+
+void HelloVrBetaApp::TrackSwapChainMemory() {
+  // Two layers of 2x multisampled color and depth, plus the resolved color.
+  // Copies that GVR or the compositor keep are not counted.
+  constexpr size_t kBytesPerPixel = ((4 + 2) * 2 + 4) * 2;
+  const gvr::Sizei size = swapchain_->GetBufferSize(0);
+  GetResourceRegistry().Track(
+      swapchain_.get(), ResourceKind::kBuffer, "swap chain", 0,
+      static_cast<size_t>(size.width) * size.height * kBytesPerPixel);
+}
+
+void HelloVrBetaApp::OnDrawFrame() {
+  profiler_.BeginFrame();
+  GetResourceRegistry().BeginFrame();
+  // This also uploads meshes that are reloaded after an eviction.
+  const bool meshes_pending = mesh_loader_->ProcessUploads();
+  if (meshes_loading_ && !meshes_pending) {
+    meshes_loading_ = false;
+    LOGD("Loaded %zu meshes.", mesh_loader_->GetUploadedCount());
+    GetResourceRegistry().LogTotals("loaded");
+  }
+  texture_loader_->ProcessUploads(kTextureUploadBytesPerFrame);
+  if (replay_start_frame_ < 0 && pose_trace_.GetFrameCount() > 0 &&
+      kBenchmarkMode == BenchmarkMode::kReplay && !meshes_loading_) {
+    // Start once the scene is complete, so that every run draws the same.
+    replay_start_frame_ = profiler_.GetFrameIndex();
+    LOGD("Replaying %zu frames.", pose_trace_.GetFrameCount());
+  }
+  frame_draw_calls_ = 0;
+  UpdateRenderScale();
+  gvr::Frame frame = swapchain_->AcquireFrame();
+  pose_predictor_.OnFrameAcquired();
+
+  // A client app does its rendering here.
+  gvr::Mat4f head_view;
+  float floor_offset;
+  gvr::Mat4f view[2];
+  gvr::Mat4f projection[2];
+  {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kPose);
+    // This may change when the floor height changes so it's computed every
+    // frame.
+    floor_offset = GetFloorOffset();
+    head_view = GetHeadView(pose_predictor_.GetTargetTime(), floor_offset);
+    ComputeViews(head_view, view, projection);
   }
 
-  controllers_.Update(head_view, floor_offset);
+  {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kControllers);
+    controllers_.Update(head_view, floor_offset);
+    // The lasers move with the controllers, and a held target with them.
+    scene_.Update();
+    UpdatePicking();
+    HandleControllerEvents();
+    // The events may have grabbed, released or moved the target.
+    scene_.Update();
+  }
 
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_CULL_FACE);
-  glDisable(GL_SCISSOR_TEST);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  GlStateCache& gl_state = GetGlStateCache();
+  gl_state.SetCapability(GL_DEPTH_TEST, true);
+  gl_state.SetCapability(GL_CULL_FACE, true);
+  gl_state.SetCapability(GL_SCISSOR_TEST, false);
+  gl_state.SetCapability(GL_BLEND, true);
+  gl_state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kDrawWorld);
+    // Draw the world. The buffer is fully cleared after binding, so that a
+    // tiled GPU never loads its old contents, and its depth is discarded
+    // before unbinding, so that only the resolved color is stored. A clear
+    // only counts as full if the write masks are all on.
+    gl_state.DepthMask(true);
+    frame.BindBuffer(0);
+    profiler_.BeginGpuPass(0);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    DrawWorld(view, projection);
+    DiscardDepthStencil();
+    profiler_.EndGpuPass();
+    frame.Unbind();
+  }
 
-  // Draw the world.
-  frame.BindBuffer(0);
-  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  DrawWorld(view, view_projection);
-  frame.Unbind();
+  if (kLateLatchHeadPose && view_uniforms_.SupportsLateLatch()) {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kPose);
+    // The GPU has not run the draws yet, so they still pick up a newer pose.
+    // Submit() gets the same pose, which keeps reprojection consistent.
+    head_view = GetHeadView(pose_predictor_.GetTargetTime(), floor_offset);
+    ComputeViews(head_view, view, projection);
+    view_uniforms_.LateLatch(view, projection);
+  }
 
-  // Submit frame.
-  frame.Submit(*viewport_list_, head_view);
+  {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kSubmit);
+    // Submit frame.
+    pose_predictor_.OnFrameSubmitted();
+    frame.Submit(*viewport_list_, head_view);
+    // The distortion renderer changes GL state behind the cache's back.
+    gl_state.Invalidate();
+  }
 
   CheckGLError("onDrawFrame");
 
-  // Update audio head rotation in audio API.
-  gvr_audio_api_->SetHeadPose(head_view);
-  gvr_audio_api_->Update();
+  {
+    FrameProfiler::ScopedCpuTimer timer(&profiler_, CpuPhase::kAudio);
+    // Update audio head rotation in audio API.
+    audio_player_.SetHeadPose(head_view);
+  }
+  profiler_.EndFrame();
+  UpdateBenchmark(head_view);
+}
+
+void HelloVrBetaApp::HandleControllerEvents() {
+  for (const ControllerEvents& events : controllers_.GetEvents()) {
+    const int index = events.controller_index;
+    if (events.HasButtonDown(GVR_CONTROLLER_BUTTON_CLICK) ||
+        events.HasButtonDown(GVR_CONTROLLER_BUTTON_TRIGGER)) {
+      OnTrigger(index);
+    }
+    // A grip may be released and pressed again, or the other way around,
+    // before the events are handled, so whether the target ends up held
+    // follows the buttons that are down now.
+    const bool grip_pressed =
+        events.IsButtonPressed(GVR_CONTROLLER_BUTTON_APP) ||
+        events.IsButtonPressed(GVR_CONTROLLER_BUTTON_GRIP);
+    if (grip_pressed && (events.HasButtonDown(GVR_CONTROLLER_BUTTON_APP) ||
+                         events.HasButtonDown(GVR_CONTROLLER_BUTTON_GRIP))) {
+      OnGrabTarget(index);
+    }
+    if (!grip_pressed && (events.HasButtonUp(GVR_CONTROLLER_BUTTON_APP) ||
+                          events.HasButtonUp(GVR_CONTROLLER_BUTTON_GRIP))) {
+      OnReleaseTarget(index);
+    }
+    if (events.has_swipe) {
+      OnSwipe(index, events.swipe_direction);
+    }
+  }
+  controllers_.ClearEvents();
 }
 
 void HelloVrBetaApp::OnTrigger(int controller_index) {
@@ -246,14 +512,20 @@ void HelloVrBetaApp::OnTrigger(int controller_index) {
 }
 
 void HelloVrBetaApp::OnGrabTarget(int controller_index) {
-  if (controller_index == controller_on_target_index_) {
+  if (!target_held_ && controller_index == controller_on_target_index_) {
     target_held_ = true;
+    // Attach the target to the end of the laser.
+    scene_.SetParent(
+        target_node_,
+        controllers_.GetController(controller_index).GetLaserNode(),
+        GetTranslationMatrix({0.0f, 0.0f, -kTargetRadius}));
   }
 }
 
 void HelloVrBetaApp::OnReleaseTarget(int controller_index) {
-  if (controller_index == controller_on_target_index_) {
+  if (target_held_ && controller_index == controller_on_target_index_) {
     target_held_ = false;
+    scene_.Detach(target_node_);
   }
 }
 
@@ -286,15 +558,50 @@ void HelloVrBetaApp::OnSwipe(int controller_index,
 }
 
 void HelloVrBetaApp::OnPause() {
+  const GlStateCache::Stats& gl_stats = GetGlStateCache().GetStats();
+  LOGD("GL state changes: %u issued, %u skipped.", gl_stats.issued_calls,
+       gl_stats.skipped_calls);
+  GetGlStateCache().ResetStats();
+  last_gl_calls_ = 0;
+  GetResourceRegistry().LogTotals("paused");
+  if (kBenchmarkMode == BenchmarkMode::kRecord &&
+      pose_trace_.Save(cache_dir_ + "/" + kPoseTraceFile)) {
+    LOGD("Saved a pose trace of %zu frames.", pose_trace_.GetFrameCount());
+  }
   gvr_api_->PauseTracking();
-  gvr_audio_api_->Pause();
+  audio_player_.Pause();
   controllers_.Pause();
 }
 
+void HelloVrBetaApp::SetDisplayRefreshRate(float refresh_rate) {
+  if (refresh_rate > 0.0f) {
+    frame_budget_ns_ = 1e9f / refresh_rate;
+  }
+}
+
+void HelloVrBetaApp::OnTrimMemory(int level) {
+  if (level < kTrimMemoryRunningModerate) {
+    return;
+  }
+  // The decoded images only save decoding time on reloads.
+  texture_loader_->ClearCache();
+  // GL objects can only be deleted with their context current. At
+  // TRIM_MEMORY_UI_HIDDEN and above GLSurfaceView has usually made it
+  // non-current, so those levels only drop the cache and GPU memory stays
+  // allocated until the app is resumed or killed. Like OnDrawFrame(), this
+  // evicts nothing while the meshes are loading.
+  if (level >= kTrimMemoryRunningLow && !meshes_loading_ &&
+      gl_context_ != EGL_NO_CONTEXT && eglGetCurrentContext() == gl_context_) {
+    GetResourceRegistry().EnforceBudget(0);
+  }
+  GetResourceRegistry().LogTotals("trimmed");
+}
+
 void HelloVrBetaApp::OnResume() {
   gvr_api_->ResumeTracking();
   gvr_api_->RefreshViewerProfile();
-  gvr_audio_api_->Resume();
+  RefreshEyeFromHeadMatrices();
+  audio_player_.Resume();
   controllers_.Resume();
 }
 
@@ -356,61 +663,72 @@ void HelloVrBetaApp::UpdateSeeThroughSettings() {
  * Draws a frame for a particular view.
  */
 void HelloVrBetaApp::DrawWorld(const gvr::Mat4f view[2],
-                               const gvr::Mat4f view_projection[2]) {
-  glViewport(0, 0, render_size_.width / 2, render_size_.height);
-  if (see_through_mode_ != SHOW_SEE_THROUGH) {
-    DrawRoom(view_projection);
+                               const gvr::Mat4f projection[2]) {
+  // Only the part of each layer that is given to GVR is drawn.
+  const gvr::Rectf source_uv = viewports_[0].GetSourceUv();
+  glViewport(0, 0,
+             static_cast<GLsizei>(render_size_.width / 2 * source_uv.right),
+             static_cast<GLsizei>(render_size_.height * source_uv.top));
+  draw_list_.Clear();
+  // Until the meshes are in, the frame stays empty.
+  if (!meshes_loading_) {
+    if (see_through_mode_ != SHOW_SEE_THROUGH) {
+      SubmitRoom();
+    }
+
+    SubmitTarget();
+    controllers_.Submit(view, &draw_list_);
   }
-
-  DrawTarget(view_projection);
-  controllers_.Draw(view, view_projection);
-}
-
-void HelloVrBetaApp::DrawTarget(const gvr::Mat4f view_projection[2]) {
-  // If we're holding onto the target, attach its position to the controller.
-  if (target_held_ && controller_on_target_index_ >= 0) {
-    Controller& controller =
-        controllers_.GetController(controller_on_target_index_);
-    const gvr::Mat4f& laser_transform = controller.GetLaserTransform();
-    gvr::Vec3f laser_position = GetMatrixTranslation(laser_transform);
-    gvr::Vec3f offset =
-        MatrixVectorMul(laser_transform, {0.0f, 0.0f, -1.0f}) * kTargetRadius;
-    SetTargetPosition(laser_position + offset);
+  draw_list_.Cull(GetCullingFrustum(view));
+  // The left eye is close enough to the head for ordering the items.
+  draw_list_.Prepare(view[0]);
+  // Only what this frame draws is safe from eviction, so nothing is evicted
+  // before the scene is complete.
+  if (!meshes_loading_) {
+    GetResourceRegistry().EnforceBudget(kResourceBudgetBytes);
   }
-
-  shader_.Use();
-  shader_.SetModelViewProjection(model_target_, view_projection);
-
-  if (IsPointingAtTarget()) {
-    target_object_selected_texture_.Bind();
-  } else {
-    target_object_not_selected_texture_.Bind();
+  view_uniforms_.BeginFrame(view, projection);
+  // The matrices are in view_uniforms_.
+  draw_list_.Draw(nullptr, 2);
+  frame_draw_calls_ += draw_list_.GetDrawCallCount();
+  if (kShowProfilerOverlay) {
+    profiler_overlay_.Draw(profiler_);
   }
-  target_object_mesh_.Draw();
-
-  CheckGLError("Drawing target object");
 }
 
-void HelloVrBetaApp::DrawRoom(const gvr::Mat4f view_projection[2]) {
-  gvr::Mat4f model_room = GetTranslationMatrix({0.0f, 0.0f, 0.0f});
-
-  alpha_shader_.Use();
-  alpha_shader_.SetModelViewProjection(model_room, view_projection);
-  float alpha = see_through_mode_ == SHOW_TRANSLUCENT_SEE_THROUGH ? 0.7f : 1.0f;
-  alpha_shader_.SetAlpha(alpha);
+void HelloVrBetaApp::SubmitTarget() {
+  const gvr::Mat4f& model_target = scene_.GetWorldTransform(target_node_);
+  // A held target follows its controller through the scene graph, and its
+  // sound follows it.
+  if (target_held_) {
+    audio_player_.SetPosition(target_voice_,
+                              GetMatrixTranslation(model_target));
+  }
 
-  room_texture_.Bind();
-  room_.Draw();
+  // Both states share the texture, so the item only changes its layer.
+  const int layer = IsPointingAtTarget() ? kSelectedLayer : kNotSelectedLayer;
+  draw_list_.Add({shader_.GetDrawProgram(), &target_object_texture_, layer,
+                  &target_object_mesh_, model_target, BlendMode::kOpaque,
+                  nullptr, nullptr});
+}
 
-  CheckGLError("Drawing room");
+void HelloVrBetaApp::SubmitRoom() {
+  room_uniforms_.program = &alpha_shader_;
+  room_uniforms_.alpha =
+      see_through_mode_ == SHOW_TRANSLUCENT_SEE_THROUGH ? 0.7f : 1.0f;
+  // The baked room texture has partially transparent texels, so the room is
+  // blended even when it is fully opaque.
+  draw_list_.Add({alpha_shader_.GetDrawProgram(), &room_texture_, 0, &room_,
+                  scene_.GetWorldTransform(room_node_), BlendMode::kAlpha,
+                  &TexturedAlphaShaderProgram::SetItemUniforms,
+                  &room_uniforms_});
 }
 
 void HelloVrBetaApp::SetTargetPosition(const gvr::Vec3f& position) {
-  model_target_ = GetTranslationMatrix(position);
-  if (audio_source_id_ >= 0) {
-    gvr_audio_api_->SetSoundObjectPosition(audio_source_id_, position.x,
-                                           position.y, position.z);
-  }
+  // Placing the target drops it, if it was held.
+  target_held_ = false;
+  scene_.SetParent(target_node_, -1, GetTranslationMatrix(position));
+  audio_player_.SetPosition(target_voice_, position);
 }
 
 void HelloVrBetaApp::GenerateNewTargetPosition() {
@@ -421,37 +739,38 @@ void HelloVrBetaApp::GenerateNewTargetPosition() {
       {std::cos(angle) * distance, height, std::sin(angle) * distance});
 }
 
-bool HelloVrBetaApp::IsPointingAtTarget() {
-  bool result = false;
+void HelloVrBetaApp::UpdatePicking() {
+  picker_.Clear();
+  ray_controller_indices_.clear();
+  controllers_.ForEachLaser(
+      [this](int index, const gvr::Vec3f& origin, const gvr::Vec3f& direction) {
+        picker_.AddRay(origin, direction);
+        ray_controller_indices_.push_back(index);
+      });
+  picker_.AddTarget(
+      GetMatrixTranslation(scene_.GetWorldTransform(target_node_)),
+      kTargetRadius);
+  picker_.Pick();
+
   if (target_held_) {
-    // consider a held target active.
-    return true;
+    // The target stays with the controller that holds it.
+    return;
   }
   controller_on_target_index_ = -1;
-  controllers_.ForEachLaser(
-      [&](int index, const gvr::Vec3f& origin, const gvr::Vec3f& direction) {
-        if (DoesRayIntersectSphere(origin, direction,
-                                   GetMatrixTranslation(model_target_),
-                                   kTargetRadius)) {
-          controller_on_target_index_ = index;
-          result = true;
-        }
-      });
-  return result;
+  float nearest_distance = 0.0f;
+  for (int ray = 0; ray < picker_.GetRayCount(); ++ray) {
+    const RayPicker::Hit& hit = picker_.GetHit(ray);
+    if (hit.target >= 0 && (controller_on_target_index_ < 0 ||
+                            hit.distance < nearest_distance)) {
+      controller_on_target_index_ = ray_controller_indices_[ray];
+      nearest_distance = hit.distance;
+    }
+  }
 }
 
-void HelloVrBetaApp::LoadAndPlayTargetObjectSound() {
-  // Preload sound files.
-  gvr_audio_api_->PreloadSoundfile(kObjectSoundFile);
-  gvr_audio_api_->PreloadSoundfile(kSuccessSoundFile);
-  // Create sound file handler from preloaded sound file.
-  audio_source_id_ = gvr_audio_api_->CreateSoundObject(kObjectSoundFile);
-  // Set sound object to current target position.
-  gvr_audio_api_->SetSoundObjectPosition(
-      audio_source_id_, model_target_.m[0][3], model_target_.m[1][3],
-      model_target_.m[2][3]);
-  // Trigger sound object playback.
-  gvr_audio_api_->PlaySound(audio_source_id_, /*looping_enabled=*/true);
+bool HelloVrBetaApp::IsPointingAtTarget() const {
+  // consider a held target active.
+  return target_held_ || controller_on_target_index_ >= 0;
 }
 
 }  // namespace ndk_hello_vr_beta
@@ -23,12 +23,27 @@
 
 #include <memory>
 #include <string>
-#include <thread>  // NOLINT
 #include <vector>
 
+#include "audio_player.h"  // NOLINT
+#include "benchmark_report.h"  // NOLINT
 #include "controllers.h"  // NOLINT
+#include "draw_list.h"  // NOLINT
+#include "frame_profiler.h"  // NOLINT
+#include "mesh_loader.h"  // NOLINT
+#include "micro_benchmarks.h"  // NOLINT
+#include "pose_predictor.h"  // NOLINT
+#include "pose_trace.h"  // NOLINT
+#include "profiler_overlay.h"  // NOLINT
+#include "ray_picker.h"  // NOLINT
+#include "resolution_controller.h"  // NOLINT
+#include "resource_registry.h"  // NOLINT
+#include "scene_graph.h"  // NOLINT
 #include "shader_program.h"  // NOLINT
+#include "texture_loader.h"  // NOLINT
 #include "util.h"  // NOLINT
+#include "view_frustum.h"  // NOLINT
+#include "view_uniforms.h"  // NOLINT
 #include "vr/gvr/capi/include/gvr.h"
 #include "vr/gvr/capi/include/gvr_audio.h"
 #include "vr/gvr/capi/include/gvr_controller.h"
@@ -49,15 +64,18 @@ class HelloVrBetaApp {
    * @param asset_mgr_obj The asset manager object.
    * @param gvr_api The (non-owned) gvr_context.
    * @param gvr_audio_api The (owned) gvr::AudioApi context.
+   * @param cache_dir A directory for compiled shader programs, or empty to
+   *     compile them on every surface creation; see ProgramCache.
    */
   HelloVrBetaApp(JNIEnv* env, jobject asset_mgr_obj, gvr_context* gvr_context,
-                 std::unique_ptr<gvr::AudioApi> gvr_audio_api);
+                 std::unique_ptr<gvr::AudioApi> gvr_audio_api,
+                 const std::string& cache_dir);
 
   ~HelloVrBetaApp();
 
   /**
    * Initializes any GL-related objects. This should be called on the rendering
-   * thread with a valid GL context.
+   * thread with a valid GL context, once for each new context.
    */
   void OnSurfaceCreated(JNIEnv* env);
 
@@ -76,24 +94,50 @@ class HelloVrBetaApp {
    */
   void OnResume();
 
+  /**
+   * Releases memory as the system asks for in ComponentCallbacks2's
+   * onTrimMemory(). This should be called on the rendering thread. GL
+   * objects are only evicted while the context is current, which it usually
+   * is not once the UI is hidden.
+   *
+   * @param level The trim level, such as TRIM_MEMORY_RUNNING_LOW.
+   */
+  void OnTrimMemory(int level);
+
+  /**
+   * Sets the refresh rate of the display, which the GPU time of a frame is
+   * budgeted against. This should be called on the rendering thread.
+   *
+   * @param refresh_rate The rate in Hz, as from Display.getRefreshRate().
+   */
+  void SetDisplayRefreshRate(float refresh_rate);
+
  private:
+  /**
+   * Picks the render scale of the frame, resizing the framebuffer if needed.
+   */
+  void UpdateRenderScale();
+
+  /**
+   * Records the estimated size of the swap chain buffer in the resource
+   * registry. Called whenever the buffer is created or resized.
+   */
+  void TrackSwapChainMemory();
+
   /**
    * Draws all world-space objects.
    */
-  void DrawWorld(const gvr::Mat4f view[2], const gvr::Mat4f view_projection[2]);
+  void DrawWorld(const gvr::Mat4f view[2], const gvr::Mat4f projection[2]);
 
   /**
-   * Draws the target object.
-   *
-   * We've set all of our transformation matrices. Now we simply pass them
-   * into the shader.
+   * Adds the target object to |draw_list_|.
    */
-  void DrawTarget(const gvr::Mat4f view_projection[2]);
+  void SubmitTarget();
 
   /**
-   * Draws the room.
+   * Adds the room to |draw_list_|.
    */
-  void DrawRoom(const gvr::Mat4f view_projection[2]);
+  void SubmitRoom();
 
   /**
    * Finds a new random position for the target object.
@@ -101,20 +145,24 @@ class HelloVrBetaApp {
   void GenerateNewTargetPosition();
 
   /**
-   * Checks if user is pointing or looking at the target object by calculating
-   * whether the angle between the user's gaze or controller orientation and the
-   * vector pointing towards the object is lower than some threshold.
+   * Casts the rays of all lasers against the target and records the
+   * controller whose laser hits it nearest in |controller_on_target_index_|.
+   * Runs once per frame, after the controllers have been updated.
+   */
+  void UpdatePicking();
+
+  /**
+   * Returns whether a laser pointed at the target in the last UpdatePicking()
+   * call. A held target is always pointed at.
    *
    * @return true if the user is pointing at the target object.
    */
-  bool IsPointingAtTarget();
+  bool IsPointingAtTarget() const;
 
   /**
-   * Preloads the target object sound sample and starts the spatialized playback
-   * at the current target location. This method is executed from a separate
-   * thread to avoid any delay during construction and app initialization.
+   * Handles the controller events of the frame, then clears them.
    */
-  void LoadAndPlayTargetObjectSound();
+  void HandleControllerEvents();
 
   /**
    * Generate a new target if the controller is pointing at it.
@@ -142,13 +190,51 @@ class HelloVrBetaApp {
   void SetTargetPosition(const gvr::Vec3f& position);
   float GetFloorOffset();
 
+  /**
+   * Reads the head pose for |target_time| and moves it up by the floor
+   * offset.
+   */
+  gvr::Mat4f GetHeadView(const gvr::ClockTimePoint& target_time,
+                         float floor_offset);
+
+  /**
+   * Computes the view and projection matrices of both eyes.
+   */
+  void ComputeViews(const gvr::Mat4f& head_view, gvr::Mat4f view[2],
+                    gvr::Mat4f projection[2]) const;
+
+  /**
+   * Returns the volume seen by either eye with the given view matrices, with
+   * some margin, for culling the world-space objects.
+   */
+  ViewFrustum GetCullingFrustum(const gvr::Mat4f view[2]) const;
+
+  // Caches the eye-from-head matrices. These only change with the viewer
+  // profile, so this is called again after refreshing it.
+  void RefreshEyeFromHeadMatrices();
+
+  /**
+   * Returns the frame of |pose_trace_| that the current frame replays, or -1
+   * if it uses the tracked head pose.
+   */
+  int64_t GetReplayFrame() const;
+
+  /**
+   * Records the pose or the measurements of the frame that just ended, as
+   * selected by kBenchmarkMode, and writes the report at the end of a replay.
+   */
+  void UpdateBenchmark(const gvr::Mat4f& head_view);
+
   gvr_context* context_;
 
   std::unique_ptr<gvr::GvrApi> gvr_api_;
   std::unique_ptr<gvr::AudioApi> gvr_audio_api_;
   std::unique_ptr<gvr::BufferViewportList> viewport_list_;
   std::array<gvr::BufferViewport, 2> viewports_;
+  gvr::Mat4f eye_from_head_[2];
   std::unique_ptr<gvr::SwapChain> swapchain_;
+  // The context that the GL objects were created in.
+  EGLContext gl_context_;
 
   gvr_beta_see_through_config* see_through_config_;
   enum SeeThroughMode {
@@ -159,26 +245,76 @@ class HelloVrBetaApp {
   int see_through_mode_;
   int see_through_effect_;
 
+  // The world transforms of the room, the target and the controllers, which
+  // picking, culling and the draw list read. A held target is a child of
+  // the laser of the controller that holds it. Declared before
+  // |controllers_|, which add their nodes to it.
+  SceneGraph scene_;
+  int room_node_;
+  int target_node_;
+
   Controllers controllers_;
   int controller_on_target_index_;
   bool target_held_;
 
+  // Holds a ray for each shown laser and the results of the frame.
+  RayPicker picker_;
+  // The controller index of each ray in |picker_|.
+  std::vector<int> ray_controller_indices_;
+
   TexturedMesh room_;
   Texture room_texture_;
   TexturedMesh target_object_mesh_;
-  Texture target_object_not_selected_texture_;
-  Texture target_object_selected_texture_;
-
-  TexturedShaderProgram shader_;
+  // An array texture with a layer for each selection state.
+  Texture target_object_texture_;
+
+  // Declared after all the meshes and textures, including those of
+  // |controllers_|, so that they are destroyed before them.
+  std::unique_ptr<MeshLoader> mesh_loader_;
+  std::unique_ptr<TextureLoader> texture_loader_;
+  // Whether meshes queued by OnSurfaceCreated() are still loading. The world
+  // is left out of the frames until they are done.
+  bool meshes_loading_;
+
+  TexturedArrayShaderProgram shader_;
   TexturedAlphaShaderProgram alpha_shader_;
-
-  gvr::Mat4f model_target_;
+  TexturedAlphaShaderProgram::ItemUniforms room_uniforms_;
+
+  // The world-space objects of the current frame.
+  DrawList draw_list_;
+
+  FrameProfiler profiler_;
+  PosePredictor pose_predictor_;
+  // Holds the view-projection matrices for the shaders.
+  ViewUniforms view_uniforms_;
+  ProfilerOverlay profiler_overlay_;
+  ResolutionController resolution_controller_;
+  // The time between refreshes of the display, in nanoseconds.
+  float frame_budget_ns_;
+
+  // The state of a benchmark run; see kBenchmarkMode.
+  const std::string cache_dir_;
+  PoseTrace pose_trace_;
+  BenchmarkReport benchmark_report_;
+  // The profiler frame that replays the first pose of |pose_trace_|, or -1
+  // if no replay is running.
+  int64_t replay_start_frame_;
+  // The draw calls of |draw_list_| in the current frame.
+  size_t frame_draw_calls_;
+  // The calls issued by the GL state cache up to the end of the last frame.
+  uint32_t last_gl_calls_;
+
+  // The render target size recommended by GVR, and the actual size of the
+  // scene buffer, which follows the render scale on large, sustained changes.
+  // Only part of the buffer may be rendered in a given frame.
+  gvr::Sizei recommended_render_size_;
   gvr::Sizei render_size_;
 
-  gvr::AudioSourceId audio_source_id_;
-  gvr::AudioSourceId success_source_id_;
-
-  std::thread audio_initialization_thread_;
+  // Preloads the sounds and plays them off the render thread. Declared after
+  // |gvr_audio_api_| so that it stops first.
+  AudioPlayer audio_player_;
+  // The voice of the looping target sound.
+  int target_voice_;
 
   jobject java_asset_mgr_;
   AAssetManager* asset_mgr_;
@@ -17,6 +17,7 @@
 #include <jni.h>
 
 #include <memory>
+#include <string>
 
 #include "hello_vr_beta_app.h"  // NOLINT
 #include "vr/gvr/capi/include/gvr.h"
@@ -42,14 +43,18 @@ extern "C" {
 
 JNI_METHOD(jlong, nativeOnCreate)
 (JNIEnv *env, jclass clazz, jobject class_loader, jobject android_context,
- jobject asset_mgr, jlong native_gvr_api) {
+ jobject asset_mgr, jlong native_gvr_api, jstring cache_dir) {
   std::unique_ptr<gvr::AudioApi> audio_context(new gvr::AudioApi);
   audio_context->Init(env, android_context, class_loader,
                       GVR_AUDIO_RENDERING_BINAURAL_HIGH_QUALITY);
 
+  const char *cache_dir_chars = env->GetStringUTFChars(cache_dir, nullptr);
+  const std::string cache_dir_string(cache_dir_chars);
+  env->ReleaseStringUTFChars(cache_dir, cache_dir_chars);
+
   return jptr(new ndk_hello_vr_beta::HelloVrBetaApp(
       env, asset_mgr, reinterpret_cast<gvr_context *>(native_gvr_api),
-      std::move(audio_context)));
+      std::move(audio_context), cache_dir_string));
 }
 
 JNI_METHOD(void, nativeOnDestroy)
@@ -71,4 +76,14 @@ JNI_METHOD(void, nativeOnPause)
 JNI_METHOD(void, nativeOnResume)
 (JNIEnv *env, jobject obj, jlong native_app) { native(native_app)->OnResume(); }
 
+JNI_METHOD(void, nativeOnTrimMemory)
+(JNIEnv *env, jobject obj, jlong native_app, jint level) {
+  native(native_app)->OnTrimMemory(level);
+}
+
+JNI_METHOD(void, nativeSetDisplayRefreshRate)
+(JNIEnv *env, jobject obj, jlong native_app, jfloat refresh_rate) {
+  native(native_app)->SetDisplayRefreshRate(refresh_rate);
+}
+
 }  // extern "C"
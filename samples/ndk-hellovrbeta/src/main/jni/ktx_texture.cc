@@ -0,0 +1,173 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ktx_texture.h"  // NOLINT
+
+#include <string.h>  // Needed for memcmp and memcpy
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ndk_hello_vr_beta {
+
+namespace {
+
+constexpr uint8_t kKtxIdentifier[12] = {0xAB, 'K',  'T',  'X', ' ',  '1',
+                                        '1',  0xBB, '\r', '\n', 0x1A, '\n'};
+// Reads back as 0x01020304 from files written on a machine of the other
+// endianness.
+constexpr uint32_t kKtxEndianness = 0x04030201;
+
+struct KtxHeader {
+  uint8_t identifier[12];
+  uint32_t endianness;
+  uint32_t gl_type;
+  uint32_t gl_type_size;
+  uint32_t gl_format;
+  uint32_t gl_internal_format;
+  uint32_t gl_base_internal_format;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t number_of_array_elements;
+  uint32_t number_of_faces;
+  uint32_t number_of_mipmap_levels;
+  uint32_t bytes_of_key_value_data;
+};
+
+static_assert(sizeof(KtxHeader) == 64, "Unexpected header padding");
+
+struct BlockFormat {
+  GLenum format;
+  uint32_t block_width;
+  uint32_t block_height;
+  uint32_t block_size;
+};
+
+constexpr BlockFormat kBlockFormats[] = {
+    {GL_COMPRESSED_RGB8_ETC2, 4, 4, 8},
+    {GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, 4, 4, 8},
+    {GL_COMPRESSED_RGBA8_ETC2_EAC, 4, 4, 16},
+    {GL_COMPRESSED_RGBA_ASTC_4x4_KHR, 4, 4, 16},
+    {GL_COMPRESSED_RGBA_ASTC_5x4_KHR, 5, 4, 16},
+    {GL_COMPRESSED_RGBA_ASTC_5x5_KHR, 5, 5, 16},
+    {GL_COMPRESSED_RGBA_ASTC_6x5_KHR, 6, 5, 16},
+    {GL_COMPRESSED_RGBA_ASTC_6x6_KHR, 6, 6, 16},
+    {GL_COMPRESSED_RGBA_ASTC_8x5_KHR, 8, 5, 16},
+    {GL_COMPRESSED_RGBA_ASTC_8x6_KHR, 8, 6, 16},
+    {GL_COMPRESSED_RGBA_ASTC_8x8_KHR, 8, 8, 16},
+    {GL_COMPRESSED_RGBA_ASTC_10x5_KHR, 10, 5, 16},
+    {GL_COMPRESSED_RGBA_ASTC_10x6_KHR, 10, 6, 16},
+    {GL_COMPRESSED_RGBA_ASTC_10x8_KHR, 10, 8, 16},
+    {GL_COMPRESSED_RGBA_ASTC_10x10_KHR, 10, 10, 16},
+    {GL_COMPRESSED_RGBA_ASTC_12x10_KHR, 12, 10, 16},
+    {GL_COMPRESSED_RGBA_ASTC_12x12_KHR, 12, 12, 16},
+};
+
+const BlockFormat* FindBlockFormat(GLenum format) {
+  for (const BlockFormat& block_format : kBlockFormats) {
+    if (block_format.format == format) {
+      return &block_format;
+    }
+  }
+  return nullptr;
+}
+
+uint32_t GetFullMipCount(uint32_t width, uint32_t height) {
+  uint32_t count = 1;
+  for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+    ++count;
+  }
+  return count;
+}
+
+}  // anonymous namespace
+
+bool IsAstcFormat(GLenum format) {
+  return format >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR &&
+         format <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR;
+}
+
+bool ParseKtx(const char* data, size_t size, TextureImage* image,
+              std::string* error) {
+  KtxHeader header;
+  if (size < sizeof(header)) {
+    *error = "KTX file too small.";
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.identifier, kKtxIdentifier, sizeof(kKtxIdentifier)) != 0) {
+    *error = "Not a KTX 1.1 file.";
+    return false;
+  }
+  if (header.endianness != kKtxEndianness) {
+    *error = "KTX file has the wrong endianness.";
+    return false;
+  }
+  if (header.pixel_depth > 1 || header.number_of_array_elements != 0 ||
+      header.number_of_faces != 1 || header.pixel_width == 0 ||
+      header.pixel_height == 0) {
+    *error = "KTX file is not a 2D texture.";
+    return false;
+  }
+  const BlockFormat* block_format = FindBlockFormat(header.gl_internal_format);
+  if (header.gl_type != 0 || block_format == nullptr) {
+    *error = "KTX file does not use a supported compressed format.";
+    return false;
+  }
+  const uint32_t level_count = std::max(header.number_of_mipmap_levels, 1u);
+  if (level_count != 1 &&
+      level_count != GetFullMipCount(header.pixel_width, header.pixel_height)) {
+    *error = "KTX file has an incomplete mip chain.";
+    return false;
+  }
+
+  std::vector<TextureImage::Level> levels(level_count);
+  uint64_t offset =
+      sizeof(header) + static_cast<uint64_t>(header.bytes_of_key_value_data);
+  for (uint32_t i = 0; i < level_count; ++i) {
+    TextureImage::Level& level = levels[i];
+    level.width = static_cast<int>(std::max(header.pixel_width >> i, 1u));
+    level.height = static_cast<int>(std::max(header.pixel_height >> i, 1u));
+    const uint64_t blocks_x = (level.width + block_format->block_width - 1) /
+                              block_format->block_width;
+    const uint64_t blocks_y = (level.height + block_format->block_height - 1) /
+                              block_format->block_height;
+
+    uint32_t image_size;
+    if (offset + sizeof(image_size) > size) {
+      *error = "KTX file is truncated.";
+      return false;
+    }
+    memcpy(&image_size, data + offset, sizeof(image_size));
+    offset += sizeof(image_size);
+    if (image_size != blocks_x * blocks_y * block_format->block_size ||
+        offset + image_size > size) {
+      *error = "KTX file has an invalid level size.";
+      return false;
+    }
+    level.data.assign(data + offset, data + offset + image_size);
+    // Each level is padded to a multiple of 4 bytes.
+    offset += (image_size + 3) & ~3u;
+  }
+
+  image->compressed_format = block_format->format;
+  image->levels = std::move(levels);
+  return true;
+}
+
+}  // namespace ndk_hello_vr_beta
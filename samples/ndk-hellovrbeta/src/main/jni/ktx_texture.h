@@ -0,0 +1,50 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_KTX_TEXTURE_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_KTX_TEXTURE_H_  // NOLINT
+
+#include <cstddef>
+#include <string>
+
+#include "util.h"  // NOLINT
+
+namespace ndk_hello_vr_beta {
+
+// Returns true if |format| is one of the ASTC LDR formats, which need
+// GL_KHR_texture_compression_astc_ldr. The other formats accepted by
+// ParseKtx() are ETC2 formats, which are core in OpenGL ES 3.0.
+bool IsAstcFormat(GLenum format);
+
+// Parses a KTX 1.1 file holding a block compressed 2D texture.
+//
+// The texture must use an ETC2 (RGB8, RGB8 with punchthrough alpha or
+// RGBA8 EAC) or ASTC LDR internal format, and must contain either a single
+// level or a full mip chain, since compressed textures cannot have their mip
+// levels generated by GL. Cube maps, arrays and 3D textures are not
+// supported.
+//
+// @param data The file contents.
+// @param size The number of bytes in |data|.
+// @param image Receives the compressed levels.
+// @param error Receives a description of the problem if parsing fails.
+// @return true if the file was parsed successfully.
+bool ParseKtx(const char* data, size_t size, TextureImage* image,
+              std::string* error);
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_KTX_TEXTURE_H_  // NOLINT
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_MESH_FORMAT_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_MESH_FORMAT_H_  // NOLINT
+
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the precompiled .mesh files produced by the mesh_converter tool
+// in samples/tools. This file has no Android or OpenGL dependencies so that
+// the tool can share it.
+//
+// A .mesh file is a MeshFileHeader followed by the vertex data and the index
+// data at the offsets given in the header. The vertex data is already
+// interleaved and the index data already has the width used for drawing, so
+// both blobs can be handed to glBufferData as-is. All values are
+// little-endian, which matches every Android ABI.
+
+namespace ndk_hello_vr_beta {
+
+constexpr uint32_t kMeshFileMagic = 0x314D5648;  // "HVM1"
+constexpr uint32_t kMeshFileVersion = 1;
+
+// Set when UVs are stored as half floats instead of floats.
+constexpr uint32_t kMeshFlagHalfFloatUv = 1 << 0;
+// Set when indices are 32 bits wide instead of 16 bits.
+constexpr uint32_t kMeshFlag32BitIndices = 1 << 1;
+
+// Offsets of the blobs are aligned to this many bytes.
+constexpr uint32_t kMeshDataAlignment = 16;
+
+struct MeshFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t flags;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  // Size of one vertex in bytes.
+  uint32_t vertex_stride;
+  // Byte offsets from the start of the file.
+  uint32_t vertex_data_offset;
+  uint32_t index_data_offset;
+  // Axis-aligned bounds of the vertex positions.
+  float bounds_min[3];
+  float bounds_max[3];
+};
+
+static_assert(sizeof(MeshFileHeader) == 56, "Unexpected header padding");
+
+// Vertex layout without kMeshFlagHalfFloatUv.
+struct MeshVertex {
+  float position[3];
+  float uv[2];
+};
+
+// Vertex layout with kMeshFlagHalfFloatUv.
+struct MeshVertexHalfUv {
+  float position[3];
+  uint16_t uv[2];
+};
+
+// Returns the size in bytes of one index in a file with the given flags.
+inline size_t GetMeshIndexSize(uint32_t flags) {
+  return (flags & kMeshFlag32BitIndices) ? sizeof(uint32_t)
+                                         : sizeof(uint16_t);
+}
+
+// Returns the vertex stride in bytes for a file with the given flags.
+inline size_t GetMeshVertexStride(uint32_t flags) {
+  return (flags & kMeshFlagHalfFloatUv) ? sizeof(MeshVertexHalfUv)
+                                        : sizeof(MeshVertex);
+}
+
+// Checks that |header| is well formed and that everything it describes fits
+// in a file of |file_size| bytes.
+inline bool IsValidMeshFileHeader(const MeshFileHeader& header,
+                                  size_t file_size) {
+  if (header.magic != kMeshFileMagic || header.version != kMeshFileVersion ||
+      header.vertex_stride != GetMeshVertexStride(header.flags)) {
+    return false;
+  }
+  const uint64_t vertex_end =
+      static_cast<uint64_t>(header.vertex_data_offset) +
+      static_cast<uint64_t>(header.vertex_count) * header.vertex_stride;
+  const uint64_t index_end =
+      static_cast<uint64_t>(header.index_data_offset) +
+      static_cast<uint64_t>(header.index_count) *
+          GetMeshIndexSize(header.flags);
+  return header.vertex_data_offset >= sizeof(MeshFileHeader) &&
+         header.index_data_offset >= vertex_end && index_end <= file_size &&
+         header.index_count % 3 == 0;
+}
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_MESH_FORMAT_H_  // NOLINT
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_MICRO_BENCHMARKS_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_MICRO_BENCHMARKS_H_  // NOLINT
+
+#include <android/asset_manager.h>
+
+#include <string>
+
+namespace ndk_hello_vr_beta {
+
+// Times the math, picking and mesh loading routines of the sample in tight
+// loops, so that changes to them, such as the kernels of simd_math.h, can be
+// compared between builds and between the ABIs of the same device.
+//
+// Each routine is repeated until it has run for a fixed time, and its mean
+// time per call is reported in one line of JSON, e.g.
+//   {"abi":"arm64-v8a","MatrixMul":{"ns":18.2,"iterations":4194304},...}
+//
+// Runs on the calling thread and blocks it for about a second. The results
+// are logged and written to |report_path|.
+//
+// @param asset_mgr The asset manager to read the mesh files from.
+// @param report_path The file to write the JSON to.
+// @return false if the report could not be written.
+bool RunMicroBenchmarks(AAssetManager* asset_mgr,
+                        const std::string& report_path);
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_MICRO_BENCHMARKS_H_  // NOLINT
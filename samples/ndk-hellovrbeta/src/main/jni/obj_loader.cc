@@ -0,0 +1,491 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "obj_loader.h"  // NOLINT
+
+#include <string.h>  // Needed for memchr
+#include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <limits>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <unordered_map>
+
+#include "thread_pool.h"  // NOLINT
+
+namespace ndk_hello_vr_beta {
+
+namespace {
+
+// Files smaller than this are parsed on the calling thread; splitting them
+// costs more in thread startup than it saves.
+constexpr size_t kParallelParseThreshold = 256 * 1024;
+constexpr unsigned int kMaxParseThreads = 4;
+
+// Exponents of larger magnitude are rejected. Any float overflows or
+// underflows long before, but this keeps the exponent arithmetic in range.
+constexpr int64_t kMaxExponent = 9999;
+
+constexpr int32_t kNoIndex = -1;
+// Face indices of larger magnitude are rejected.
+constexpr int64_t kMaxIndex = std::numeric_limits<int32_t>::max();
+
+// Flags marking which indices of a corner are relative to the number of
+// elements that precede the chunk it was parsed from.
+constexpr uint8_t kRelativePosition = 1 << 0;
+constexpr uint8_t kRelativeUv = 1 << 1;
+constexpr uint8_t kRelativeNormal = 1 << 2;
+
+// One corner of a triangle, as zero-based indices into the position, UV and
+// normal lists. Missing components are kNoIndex.
+struct Corner {
+  int32_t position;
+  int32_t uv;
+  int32_t normal;
+};
+
+struct CornerHash {
+  size_t operator()(const Corner& corner) const {
+    uint64_t hash = static_cast<uint32_t>(corner.position);
+    hash = hash * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(corner.uv);
+    hash = hash * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(corner.normal);
+    return static_cast<size_t>(hash ^ (hash >> 32));
+  }
+};
+
+struct CornerEqual {
+  bool operator()(const Corner& a, const Corner& b) const {
+    return a.position == b.position && a.uv == b.uv && a.normal == b.normal;
+  }
+};
+
+// The output of parsing one line-aligned chunk of the file.
+struct ObjChunk {
+  std::vector<float> positions;
+  std::vector<float> uvs;
+  std::vector<float> normals;
+  // 3 corners per triangle, and the matching kRelative* flags.
+  std::vector<Corner> corners;
+  std::vector<uint8_t> relative_flags;
+  bool has_relative_indices = false;
+  std::string error;
+};
+
+inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+inline void SkipSpaces(const char** p, const char* end) {
+  while (*p < end && IsSpace(**p)) ++*p;
+}
+
+// Parses a decimal integer with an optional sign. Fails if its magnitude is
+// larger than |max_magnitude|, which must fit in an int32_t.
+bool ParseInt(const char** p, const char* end, int64_t max_magnitude,
+              int32_t* out) {
+  const char* s = *p;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+')) {
+    negative = *s == '-';
+    ++s;
+  }
+  if (s == end || !IsDigit(*s)) return false;
+  int64_t value = 0;
+  while (s < end && IsDigit(*s)) {
+    value = value * 10 + (*s - '0');
+    if (value > max_magnitude) return false;
+    ++s;
+  }
+  *out = static_cast<int32_t>(negative ? -value : value);
+  *p = s;
+  return true;
+}
+
+// Parses a floating point number of the form [+-]digits[.digits][e[+-]digits]
+// without consulting the locale, unlike strtof and sscanf.
+bool ParseFloat(const char** p, const char* end, float* out) {
+  static constexpr double kPowersOfTen[] = {
+      1e0, 1e1, 1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+      1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char* s = *p;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+')) {
+    negative = *s == '-';
+    ++s;
+  }
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+  while (s < end && IsDigit(*s)) {
+    // Digits past what fits in the mantissa only scale the value.
+    if (mantissa < 1000000000000000000ull) {
+      mantissa = mantissa * 10 + (*s - '0');
+    } else {
+      ++exponent;
+    }
+    ++digits;
+    ++s;
+  }
+  if (s < end && *s == '.') {
+    ++s;
+    while (s < end && IsDigit(*s)) {
+      if (mantissa < 1000000000000000000ull) {
+        mantissa = mantissa * 10 + (*s - '0');
+        --exponent;
+      }
+      ++digits;
+      ++s;
+    }
+  }
+  if (digits == 0) return false;
+  if (s < end && (*s == 'e' || *s == 'E')) {
+    const char* exponent_start = s + 1;
+    int32_t explicit_exponent = 0;
+    if (!ParseInt(&exponent_start, end, kMaxExponent, &explicit_exponent)) {
+      return false;
+    }
+    exponent += explicit_exponent;
+    s = exponent_start;
+  }
+  double value = static_cast<double>(mantissa);
+  const int max_power = sizeof(kPowersOfTen) / sizeof(kPowersOfTen[0]) - 1;
+  while (exponent > 0) {
+    const int step = std::min(exponent, max_power);
+    value *= kPowersOfTen[step];
+    exponent -= step;
+  }
+  while (exponent < 0) {
+    const int step = std::min(-exponent, max_power);
+    value /= kPowersOfTen[step];
+    exponent += step;
+  }
+  *out = static_cast<float>(negative ? -value : value);
+  *p = s;
+  return true;
+}
+
+// Parses |count| whitespace-separated floats and appends them to |out|.
+bool ParseFloats(const char* p, const char* end, int count,
+                 std::vector<float>* out) {
+  for (int i = 0; i < count; ++i) {
+    SkipSpaces(&p, end);
+    float value;
+    if (!ParseFloat(&p, end, &value)) return false;
+    out->push_back(value);
+  }
+  return true;
+}
+
+// Converts a one-based (or negative, relative) .obj index into a zero-based
+// index local to the chunk. Relative indices are flagged so they can be
+// rebased once the sizes of the preceding chunks are known.
+bool ResolveIndex(int32_t index, size_t local_count, uint8_t relative_flag,
+                  int32_t* out, uint8_t* flags) {
+  if (index > 0) {
+    *out = index - 1;
+    return true;
+  }
+  if (index < 0) {
+    *out = static_cast<int32_t>(local_count) + index;
+    *flags |= relative_flag;
+    return true;
+  }
+  return false;
+}
+
+// Parses the corners of an 'f' record (without the leading 'f') and appends
+// the triangulated face to |chunk|.
+bool ParseFace(const char* p, const char* end, std::vector<Corner>* polygon,
+               std::vector<uint8_t>* polygon_flags, ObjChunk* chunk) {
+  polygon->clear();
+  polygon_flags->clear();
+  while (true) {
+    SkipSpaces(&p, end);
+    if (p == end) break;
+    Corner corner = {kNoIndex, kNoIndex, kNoIndex};
+    uint8_t flags = 0;
+    int32_t index;
+    if (!ParseInt(&p, end, kMaxIndex, &index) ||
+        !ResolveIndex(index, chunk->positions.size() / 3, kRelativePosition,
+                      &corner.position, &flags)) {
+      return false;
+    }
+    if (p < end && *p == '/') {
+      ++p;
+      if (p < end && *p != '/') {
+        if (!ParseInt(&p, end, kMaxIndex, &index) ||
+            !ResolveIndex(index, chunk->uvs.size() / 2, kRelativeUv,
+                          &corner.uv, &flags)) {
+          return false;
+        }
+      }
+      if (p < end && *p == '/') {
+        ++p;
+        if (!ParseInt(&p, end, kMaxIndex, &index) ||
+            !ResolveIndex(index, chunk->normals.size() / 3, kRelativeNormal,
+                          &corner.normal, &flags)) {
+          return false;
+        }
+      }
+    }
+    if (p < end && !IsSpace(*p)) return false;
+    polygon->push_back(corner);
+    polygon_flags->push_back(flags);
+  }
+  if (polygon->size() < 3) return false;
+
+  for (size_t i = 2; i < polygon->size(); ++i) {
+    const size_t fan[3] = {0, i - 1, i};
+    for (size_t corner : fan) {
+      chunk->corners.push_back((*polygon)[corner]);
+      chunk->relative_flags.push_back((*polygon_flags)[corner]);
+      chunk->has_relative_indices |= (*polygon_flags)[corner] != 0;
+    }
+  }
+  return true;
+}
+
+// Calls |function| with the bounds of each line in [begin, end), without the
+// trailing '\n' or '\r\n'. Stops early if |function| returns false.
+template <typename Function>
+bool ForEachLine(const char* begin, const char* end, Function function) {
+  const char* line = begin;
+  while (line < end) {
+    const char* newline = static_cast<const char*>(
+        memchr(line, '\n', static_cast<size_t>(end - line)));
+    const char* line_end = newline ? newline : end;
+    const char* content_end = line_end;
+    if (content_end > line && content_end[-1] == '\r') --content_end;
+    if (!function(line, content_end)) return false;
+    line = line_end + 1;
+  }
+  return true;
+}
+
+// The workers that parse all chunks but the first, which the calling thread
+// parses. Shared by all parses, so that no threads are started per file.
+ThreadPool& GetParsePool() {
+  static ThreadPool pool(kMaxParseThreads - 1);
+  return pool;
+}
+
+void ParseChunk(const char* begin, const char* end, ObjChunk* chunk) {
+  // Count the records first so the output only needs to be allocated once.
+  size_t position_count = 0;
+  size_t uv_count = 0;
+  size_t normal_count = 0;
+  size_t face_count = 0;
+  ForEachLine(begin, end, [&](const char* line, const char* line_end) {
+    if (line_end - line >= 2) {
+      if (line[0] == 'v' && IsSpace(line[1])) {
+        ++position_count;
+      } else if (line[0] == 'v' && line[1] == 't') {
+        ++uv_count;
+      } else if (line[0] == 'v' && line[1] == 'n') {
+        ++normal_count;
+      } else if (line[0] == 'f' && IsSpace(line[1])) {
+        ++face_count;
+      }
+    }
+    return true;
+  });
+  chunk->positions.reserve(position_count * 3);
+  chunk->uvs.reserve(uv_count * 2);
+  chunk->normals.reserve(normal_count * 3);
+  // Most faces in the sample assets are quads, i.e. two triangles.
+  chunk->corners.reserve(face_count * 6);
+  chunk->relative_flags.reserve(face_count * 6);
+
+  std::vector<Corner> polygon;
+  std::vector<uint8_t> polygon_flags;
+  ForEachLine(begin, end, [&](const char* line, const char* line_end) {
+    if (line_end - line < 2) return true;
+    if (line[0] == 'v' && line[1] == 'n') {
+      if (!ParseFloats(line + 2, line_end, 3, &chunk->normals)) {
+        chunk->error =
+            "Format of 'vn float float float' required for each normal line";
+        return false;
+      }
+    } else if (line[0] == 'v' && line[1] == 't') {
+      if (!ParseFloats(line + 2, line_end, 2, &chunk->uvs)) {
+        chunk->error =
+            "Format of 'vt float float' required for each texture uv line";
+        return false;
+      }
+    } else if (line[0] == 'v' && IsSpace(line[1])) {
+      if (!ParseFloats(line + 1, line_end, 3, &chunk->positions)) {
+        chunk->error =
+            "Format of 'v float float float' required for each vertex line";
+        return false;
+      }
+    } else if (line[0] == 'f' && IsSpace(line[1])) {
+      if (!ParseFace(line + 1, line_end, &polygon, &polygon_flags, chunk)) {
+        chunk->error =
+            "Format of 'f int/int/int int/int/int int/int/int "
+            "(int/int/int)' or 'f int//int int//int int//int (int//int)' "
+            "required for each face";
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+}  // anonymous namespace
+
+bool ParseObj(const char* data, size_t size, bool keep_normals, ObjMesh* mesh,
+              std::string* error) {
+  // Split the file into line-aligned chunks, one per thread.
+  unsigned int thread_count = 1;
+  if (size >= kParallelParseThreshold) {
+    thread_count = std::max(
+        1u, std::min(kMaxParseThreads, std::thread::hardware_concurrency()));
+  }
+  std::vector<const char*> bounds;
+  bounds.push_back(data);
+  const char* end = data + size;
+  for (unsigned int i = 1; i < thread_count; ++i) {
+    const char* split = std::max(bounds.back(), data + size * i / thread_count);
+    const char* newline = static_cast<const char*>(
+        memchr(split, '\n', static_cast<size_t>(end - split)));
+    if (newline == nullptr) break;
+    bounds.push_back(newline + 1);
+  }
+  bounds.push_back(end);
+
+  const size_t chunk_count = bounds.size() - 1;
+  std::vector<ObjChunk> chunks(chunk_count);
+  std::mutex mutex;
+  std::condition_variable chunks_done;
+  size_t pending_chunks = chunk_count - 1;
+  for (size_t i = 1; i < chunk_count; ++i) {
+    GetParsePool().Post([&, i] {
+      ParseChunk(bounds[i], bounds[i + 1], &chunks[i]);
+      // Notified under the lock, so that the waiter can't return and destroy
+      // the condition variable first.
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--pending_chunks == 0) {
+        chunks_done.notify_one();
+      }
+    });
+  }
+  ParseChunk(bounds[0], bounds[1], &chunks[0]);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    chunks_done.wait(lock, [&pending_chunks] { return pending_chunks == 0; });
+  }
+
+  // Concatenate the attribute lists in file order.
+  size_t total_positions = 0;
+  size_t total_uvs = 0;
+  size_t total_normals = 0;
+  size_t total_corners = 0;
+  for (const ObjChunk& chunk : chunks) {
+    if (!chunk.error.empty()) {
+      *error = chunk.error;
+      return false;
+    }
+    total_positions += chunk.positions.size();
+    total_uvs += chunk.uvs.size();
+    total_normals += chunk.normals.size();
+    total_corners += chunk.corners.size();
+  }
+  std::vector<float> positions;
+  std::vector<float> uvs;
+  std::vector<float> normals;
+  positions.reserve(total_positions);
+  uvs.reserve(total_uvs);
+  normals.reserve(total_normals);
+
+  // Corners whose (position, uv, normal) triple has been seen before reuse the
+  // vertex that was emitted for it.
+  std::unordered_map<Corner, uint32_t, CornerHash, CornerEqual> vertex_ids;
+  vertex_ids.reserve(total_corners);
+  mesh->positions.clear();
+  mesh->uvs.clear();
+  mesh->normals.clear();
+  mesh->indices.clear();
+  mesh->indices.reserve(total_corners);
+
+  bool some_corners_have_uv = false;
+  bool some_corners_lack_uv = false;
+  bool some_corners_have_normal = false;
+  bool some_corners_lack_normal = false;
+  for (const ObjChunk& chunk : chunks) {
+    const int32_t position_base = static_cast<int32_t>(positions.size() / 3);
+    const int32_t uv_base = static_cast<int32_t>(uvs.size() / 2);
+    const int32_t normal_base = static_cast<int32_t>(normals.size() / 3);
+    positions.insert(positions.end(), chunk.positions.begin(),
+                     chunk.positions.end());
+    uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+    normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+
+    for (size_t i = 0; i < chunk.corners.size(); ++i) {
+      Corner corner = chunk.corners[i];
+      if (chunk.has_relative_indices) {
+        const uint8_t flags = chunk.relative_flags[i];
+        if (flags & kRelativePosition) corner.position += position_base;
+        if (flags & kRelativeUv) corner.uv += uv_base;
+        if (flags & kRelativeNormal) corner.normal += normal_base;
+      }
+      // Relative indices are resolved against the elements seen so far, but
+      // absolute ones may refer to any element in the file.
+      if (corner.position < 0 ||
+          static_cast<size_t>(corner.position) >= total_positions / 3 ||
+          corner.uv >= static_cast<int32_t>(total_uvs / 2) ||
+          corner.normal >= static_cast<int32_t>(total_normals / 3) ||
+          (corner.uv < 0 && corner.uv != kNoIndex) ||
+          (corner.normal < 0 && corner.normal != kNoIndex)) {
+        *error = "Obj face index out of range.";
+        return false;
+      }
+      some_corners_have_uv |= corner.uv != kNoIndex;
+      some_corners_lack_uv |= corner.uv == kNoIndex;
+      some_corners_have_normal |= corner.normal != kNoIndex;
+      some_corners_lack_normal |= corner.normal == kNoIndex;
+      if (!keep_normals) corner.normal = kNoIndex;
+
+      auto inserted = vertex_ids.emplace(
+          corner, static_cast<uint32_t>(vertex_ids.size()));
+      mesh->indices.push_back(inserted.first->second);
+      if (inserted.second) {
+        mesh->positions.push_back(positions[corner.position * 3]);
+        mesh->positions.push_back(positions[corner.position * 3 + 1]);
+        mesh->positions.push_back(positions[corner.position * 3 + 2]);
+        if (corner.uv != kNoIndex) {
+          mesh->uvs.push_back(uvs[corner.uv * 2]);
+          mesh->uvs.push_back(uvs[corner.uv * 2 + 1]);
+        }
+        if (corner.normal != kNoIndex) {
+          mesh->normals.push_back(normals[corner.normal * 3]);
+          mesh->normals.push_back(normals[corner.normal * 3 + 1]);
+          mesh->normals.push_back(normals[corner.normal * 3 + 2]);
+        }
+      }
+    }
+  }
+
+  if (some_corners_have_normal && some_corners_lack_normal) {
+    *error = "Obj normal indices does not equal to vertex indices.";
+    return false;
+  }
+  if (some_corners_have_uv && some_corners_lack_uv) {
+    *error = "Obj UV indices does not equal to vertex indices.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ndk_hello_vr_beta
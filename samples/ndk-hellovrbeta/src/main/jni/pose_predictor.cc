@@ -0,0 +1,80 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pose_predictor.h"  // NOLINT
+
+#include <algorithm>
+
+#include "vr/gvr/capi/include/gvr.h"
+
+namespace ndk_hello_vr_beta {
+
+namespace {
+
+// The compositor picks a submitted frame up at the next vsync and scans it
+// out during the following period, so on average the middle of the frame is
+// shown this many periods after Submit().
+constexpr float kSubmitToDisplayVsyncs = 1.5f;
+
+constexpr float kDefaultVsyncPeriodNanos = 1e9f / 60.0f;
+
+// Weight of a new measurement in the smoothed values.
+constexpr float kSmoothing = 0.05f;
+
+// Acquire intervals outside of this range of the current period estimate are
+// dropped frames or stalls, not vsync.
+constexpr float kMinVsyncRatio = 0.5f;
+constexpr float kMaxVsyncRatio = 1.3f;
+
+}  // anonymous namespace
+
+PosePredictor::PosePredictor()
+    : vsync_period_ns_(kDefaultVsyncPeriodNanos),
+      acquire_to_submit_ns_(0.0f),
+      last_acquire_ns_(0) {}
+
+int64_t PosePredictor::Now() {
+  return gvr::GvrApi::GetTimePointNow().monotonic_system_time_nanos;
+}
+
+void PosePredictor::OnFrameAcquired() {
+  const int64_t now = Now();
+  if (last_acquire_ns_ != 0) {
+    const float interval = static_cast<float>(now - last_acquire_ns_);
+    if (interval > vsync_period_ns_ * kMinVsyncRatio &&
+        interval < vsync_period_ns_ * kMaxVsyncRatio) {
+      vsync_period_ns_ += kSmoothing * (interval - vsync_period_ns_);
+    }
+  }
+  last_acquire_ns_ = now;
+}
+
+void PosePredictor::OnFrameSubmitted() {
+  const float duration = static_cast<float>(Now() - last_acquire_ns_);
+  acquire_to_submit_ns_ += kSmoothing * (duration - acquire_to_submit_ns_);
+}
+
+gvr::ClockTimePoint PosePredictor::GetTargetTime() const {
+  gvr::ClockTimePoint target_time = gvr::GvrApi::GetTimePointNow();
+  const float elapsed = static_cast<float>(
+      target_time.monotonic_system_time_nanos - last_acquire_ns_);
+  const float until_submit = std::max(acquire_to_submit_ns_ - elapsed, 0.0f);
+  target_time.monotonic_system_time_nanos += static_cast<int64_t>(
+      until_submit + kSubmitToDisplayVsyncs * vsync_period_ns_);
+  return target_time;
+}
+
+}  // namespace ndk_hello_vr_beta
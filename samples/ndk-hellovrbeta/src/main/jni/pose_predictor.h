@@ -0,0 +1,63 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_POSE_PREDICTOR_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_POSE_PREDICTOR_H_  // NOLINT
+
+#include <cstdint>
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+namespace ndk_hello_vr_beta {
+
+// Predicts when the frame that is being rendered will be on the display, as
+// the target time for GvrApi::GetHeadSpaceFromStartSpaceTransform().
+//
+// The prediction is the rest of the frame's CPU time until Submit(), as
+// measured over the last frames, plus the time from Submit() until the
+// frame is scanned out. The latter is a number of vsync periods, with the
+// period measured from the rate at which AcquireFrame() returns.
+//
+// Must be used on the GL thread.
+class PosePredictor {
+ public:
+  PosePredictor();
+
+  // Call right after AcquireFrame() returns.
+  void OnFrameAcquired();
+
+  // Call right before Frame::Submit().
+  void OnFrameSubmitted();
+
+  // Returns the predicted display time of the current frame for a pose that
+  // is read now.
+  gvr::ClockTimePoint GetTargetTime() const;
+
+ private:
+  static int64_t Now();
+
+  // Smoothed estimates, in nanoseconds.
+  float vsync_period_ns_;
+  float acquire_to_submit_ns_;
+  int64_t last_acquire_ns_;
+
+  PosePredictor(const PosePredictor&) = delete;
+  PosePredictor& operator=(const PosePredictor&) = delete;
+};
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_POSE_PREDICTOR_H_  // NOLINT
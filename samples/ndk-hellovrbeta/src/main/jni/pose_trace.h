@@ -0,0 +1,63 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_POSE_TRACE_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_POSE_TRACE_H_  // NOLINT
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+namespace ndk_hello_vr_beta {
+
+// A recording of the head pose of each frame, which lets a benchmark run
+// replay the same head motion every time instead of depending on whoever
+// wears the headset.
+//
+// The file holds a small header followed by one row-major 4x4 float matrix
+// per frame, in the byte order of the device that recorded it.
+class PoseTrace {
+ public:
+  PoseTrace();
+
+  // Appends the pose of the next frame.
+  void Append(const gvr::Mat4f& head_view);
+
+  // Returns the pose of |frame|, which must be less than GetFrameCount().
+  const gvr::Mat4f& GetPose(size_t frame) const { return poses_[frame]; }
+
+  size_t GetFrameCount() const { return poses_.size(); }
+
+  void Clear();
+
+  // Replaces the poses with the content of the file at |path|.
+  //
+  // @return false if the file is missing or not a pose trace.
+  bool Load(const std::string& path);
+
+  // Writes the poses to |path| through a temporary file, so that an
+  // interrupted write leaves no partial trace behind.
+  bool Save(const std::string& path) const;
+
+ private:
+  std::vector<gvr::Mat4f> poses_;
+};
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_POSE_TRACE_H_  // NOLINT
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "profiler_overlay.h"  // NOLINT
+
+#include <algorithm>
+
+#include "gl_state_cache.h"  // NOLINT
+#include "util.h"            // NOLINT
+
+namespace ndk_hello_vr_beta {
+
+namespace {
+
+// The graph covers this rectangle in normalized device coordinates.
+constexpr float kGraphLeft = -0.4f;
+constexpr float kGraphRight = 0.4f;
+constexpr float kGraphBottom = -0.6f;
+constexpr float kGraphTop = -0.3f;
+
+// The frame time at the top of the graph. Longer frames overshoot it by up
+// to half the graph height.
+constexpr float kFrameBudgetNanos = 1e9f / 60.0f;
+constexpr float kMaxBarHeight = 1.5f;
+
+// x, y, r, g, b, a.
+constexpr int kFloatsPerVertex = 6;
+
+constexpr float kCpuColor[4] = {0.2f, 0.9f, 0.2f, 0.8f};
+constexpr float kGpuColor[4] = {1.0f, 0.6f, 0.1f, 0.8f};
+constexpr float kBudgetLineColor[4] = {1.0f, 1.0f, 1.0f, 0.8f};
+constexpr float kBackgroundColor[4] = {0.0f, 0.0f, 0.0f, 0.5f};
+
+}  // anonymous namespace
+
+void ProfilerOverlay::Initialize() {
+  program_.Link();
+  position_attrib_ = program_.GetPositionAttribute();
+  color_attrib_ = program_.GetColorAttribute();
+  initialized_ = true;
+  CheckGLError("Profiler overlay program");
+}
+
+void ProfilerOverlay::AddBar(float left, float right, float bottom, float top,
+                             const float color[4]) {
+  const auto to_y = [](float height) {
+    return kGraphBottom + (kGraphTop - kGraphBottom) *
+                              std::min(std::max(height, 0.0f), kMaxBarHeight);
+  };
+  const float y0 = to_y(bottom);
+  const float y1 = to_y(top);
+  // Two counter-clockwise triangles.
+  const float corners[6][2] = {{left, y0}, {right, y0}, {right, y1},
+                               {left, y0}, {right, y1}, {left, y1}};
+  for (const auto& corner : corners) {
+    vertices_.insert(vertices_.end(), corner, corner + 2);
+    vertices_.insert(vertices_.end(), color, color + 4);
+  }
+}
+
+void ProfilerOverlay::Draw(const FrameProfiler& profiler) {
+  if (!initialized_) {
+    return;
+  }
+  vertices_.clear();
+  AddBar(kGraphLeft, kGraphRight, 0.0f, kMaxBarHeight, kBackgroundColor);
+
+  // Oldest frame on the left; each frame gets a CPU and a GPU bar.
+  const float frame_width =
+      (kGraphRight - kGraphLeft) / FrameProfiler::kHistorySize;
+  FrameTimings timings;
+  for (int frames_ago = 0; frames_ago < FrameProfiler::kHistorySize;
+       ++frames_ago) {
+    if (!profiler.GetTimings(frames_ago, &timings)) {
+      break;
+    }
+    const float right = kGraphRight - frames_ago * frame_width;
+    const float middle = right - frame_width * 0.5f;
+    const float left = right - frame_width;
+    AddBar(left, middle, 0.0f, timings.cpu_frame_ns / kFrameBudgetNanos,
+           kCpuColor);
+    int64_t gpu_ns = 0;
+    bool has_gpu_timing = false;
+    for (const int64_t pass_ns : timings.gpu_pass_ns) {
+      if (pass_ns >= 0) {
+        gpu_ns += pass_ns;
+        has_gpu_timing = true;
+      }
+    }
+    if (has_gpu_timing) {
+      AddBar(middle, right, 0.0f, gpu_ns / kFrameBudgetNanos, kGpuColor);
+    }
+  }
+
+  // A thin line at the frame budget.
+  AddBar(kGraphLeft, kGraphRight, 0.99f, 1.01f, kBudgetLineColor);
+
+  GlStateCache& gl_state = GetGlStateCache();
+  gl_state.SetCapability(GL_DEPTH_TEST, false);
+  gl_state.SetCapability(GL_BLEND, true);
+  gl_state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  program_.Use();
+
+  const GLsizei stride = kFloatsPerVertex * sizeof(float);
+  glVertexAttribPointer(position_attrib_, 2, GL_FLOAT, GL_FALSE, stride,
+                        vertices_.data());
+  glVertexAttribPointer(color_attrib_, 4, GL_FLOAT, GL_FALSE, stride,
+                        vertices_.data() + 2);
+  glEnableVertexAttribArray(position_attrib_);
+  glEnableVertexAttribArray(color_attrib_);
+  glDrawArrays(GL_TRIANGLES, 0,
+               static_cast<GLsizei>(vertices_.size() / kFloatsPerVertex));
+  glDisableVertexAttribArray(position_attrib_);
+  glDisableVertexAttribArray(color_attrib_);
+
+  gl_state.SetCapability(GL_DEPTH_TEST, true);
+  CheckGLError("Drawing profiler overlay");
+}
+
+}  // namespace ndk_hello_vr_beta
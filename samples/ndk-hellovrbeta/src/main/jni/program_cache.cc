@@ -0,0 +1,265 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "program_cache.h"  // NOLINT
+
+#include <GLES3/gl3.h>
+#include <cstdio>
+#include <cstring>
+
+#include "util.h"  // NOLINT
+
+namespace ndk_hello_vr_beta {
+
+namespace {
+
+constexpr uint32_t kCacheFileMagic = 0x31435048;  // "HPC1"
+
+// Each cache file is this header followed by the program binary.
+struct CacheFileHeader {
+  uint32_t magic;
+  uint32_t binary_format;
+  uint32_t binary_length;
+  uint32_t reserved;
+  uint64_t key;
+};
+
+constexpr uint64_t kFnvOffsetBasis = 0xCBF29CE484222325ull;
+constexpr uint64_t kFnvPrime = 0x100000001B3ull;
+
+/**
+ * Converts a string into an OpenGL ES shader.
+ *
+ * @param type The type of shader (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER).
+ * @param shader_source The source code of the shader.
+ * @return The shader object handler, or 0 if there's an error.
+ */
+GLuint LoadGLShader(GLenum type, const char* shader_source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &shader_source, nullptr);
+  glCompileShader(shader);
+
+  // Get the compilation status.
+  GLint compile_status;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
+
+  // If the compilation failed, delete the shader and show an error.
+  if (compile_status == 0) {
+    GLint info_len = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_len);
+    if (info_len == 0) {
+      return 0;
+    }
+
+    std::vector<char> info_string(info_len);
+    glGetShaderInfoLog(shader, info_string.size(), nullptr, info_string.data());
+    LOGE("Could not compile shader of type %d: %s", type, info_string.data());
+    glDeleteShader(shader);
+    return 0;
+  } else {
+    return shader;
+  }
+}
+
+// Adds |size| bytes to a 64-bit FNV-1a hash.
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * kFnvPrime;
+  }
+  return hash;
+}
+
+// Adds a string and its terminator, so that consecutive strings can't run
+// into each other.
+uint64_t HashString(const char* string, uint64_t hash) {
+  return HashBytes(string, strlen(string) + 1, hash);
+}
+
+uint64_t HashGLString(GLenum name, uint64_t hash) {
+  const char* string = reinterpret_cast<const char*>(glGetString(name));
+  return HashString(string != nullptr ? string : "", hash);
+}
+
+}  // anonymous namespace
+
+ProgramCache::ProgramCache() {}
+
+void ProgramCache::SetDirectory(const std::string& directory) {
+  directory_ = directory;
+}
+
+GLuint ProgramCache::CreateProgram(
+    const char* vertex_source, const char* fragment_source,
+    const std::vector<AttribLocation>& attrib_locations) {
+  if (directory_.empty()) {
+    return Compile(vertex_source, fragment_source, attrib_locations,
+                   /*retrievable=*/false);
+  }
+  const uint64_t key =
+      ComputeKey(vertex_source, fragment_source, attrib_locations);
+  GLuint program = Load(key);
+  if (program != 0) {
+    return program;
+  }
+  program = Compile(vertex_source, fragment_source, attrib_locations,
+                    /*retrievable=*/true);
+  if (program != 0) {
+    Store(key, program);
+  }
+  return program;
+}
+
+uint64_t ProgramCache::ComputeKey(
+    const char* vertex_source, const char* fragment_source,
+    const std::vector<AttribLocation>& attrib_locations) {
+  uint64_t hash = kFnvOffsetBasis;
+  hash = HashGLString(GL_RENDERER, hash);
+  hash = HashGLString(GL_VERSION, hash);
+  hash = HashString(vertex_source, hash);
+  hash = HashString(fragment_source, hash);
+  for (const AttribLocation& attrib : attrib_locations) {
+    hash = HashBytes(&attrib.location, sizeof(attrib.location), hash);
+    hash = HashString(attrib.name, hash);
+  }
+  return hash;
+}
+
+std::string ProgramCache::GetPath(uint64_t key) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.program",
+           static_cast<unsigned long long>(key));  // NOLINT
+  return directory_ + name;
+}
+
+GLuint ProgramCache::Load(uint64_t key) const {
+  FILE* file = fopen(GetPath(key).c_str(), "rb");
+  if (file == nullptr) {
+    return 0;
+  }
+  CacheFileHeader header;
+  std::vector<char> binary;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+               header.magic == kCacheFileMagic && header.key == key &&
+               header.binary_length > 0;
+  if (valid) {
+    binary.resize(header.binary_length);
+    valid = fread(binary.data(), binary.size(), 1, file) == 1;
+  }
+  fclose(file);
+  if (!valid) {
+    return 0;
+  }
+
+  const GLuint program = glCreateProgram();
+  glProgramBinary(program, header.binary_format, binary.data(),
+                  static_cast<GLsizei>(binary.size()));
+  GLint link_status = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+  if (link_status == 0) {
+    // The driver can reject a binary even if its version strings match.
+    LOGW("Cached program %016llx was rejected; recompiling",
+         static_cast<unsigned long long>(key));  // NOLINT
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+void ProgramCache::Store(uint64_t key, GLuint program) const {
+  GLint binary_length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+  if (binary_length <= 0) {
+    return;
+  }
+  std::vector<char> binary(binary_length);
+  GLenum binary_format = 0;
+  glGetProgramBinary(program, binary_length, &binary_length, &binary_format,
+                     binary.data());
+  if (binary_length <= 0) {
+    return;
+  }
+
+  CacheFileHeader header = {};
+  header.magic = kCacheFileMagic;
+  header.binary_format = binary_format;
+  header.binary_length = static_cast<uint32_t>(binary_length);
+  header.key = key;
+
+  // Write to a temporary file first, so that an interrupted write never
+  // leaves a truncated entry behind.
+  const std::string path = GetPath(key);
+  const std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    LOGW("Could not create %s", temp_path.c_str());
+    return;
+  }
+  const bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                       fwrite(binary.data(), binary_length, 1, file) == 1;
+  if (fclose(file) != 0 || !written ||
+      rename(temp_path.c_str(), path.c_str()) != 0) {
+    LOGW("Could not write %s", path.c_str());
+    remove(temp_path.c_str());
+  }
+}
+
+GLuint ProgramCache::Compile(
+    const char* vertex_source, const char* fragment_source,
+    const std::vector<AttribLocation>& attrib_locations, bool retrievable) {
+  const GLuint vertex_shader = LoadGLShader(GL_VERTEX_SHADER, vertex_source);
+  const GLuint fragment_shader =
+      LoadGLShader(GL_FRAGMENT_SHADER, fragment_source);
+  if (vertex_shader == 0 || fragment_shader == 0) {
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    return 0;
+  }
+
+  const GLuint program = glCreateProgram();
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  for (const AttribLocation& attrib : attrib_locations) {
+    glBindAttribLocation(program, attrib.location, attrib.name);
+  }
+  if (retrievable) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  glLinkProgram(program);
+  // The shaders are freed together with the program.
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+
+  GLint link_status = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+  if (link_status == 0) {
+    GLint info_len = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_len);
+    std::vector<char> info_string(info_len + 1, '\0');
+    glGetProgramInfoLog(program, info_len, nullptr, info_string.data());
+    LOGE("Could not link program: %s", info_string.data());
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+ProgramCache& GetProgramCache() {
+  static ProgramCache cache;
+  return cache;
+}
+
+}  // namespace ndk_hello_vr_beta
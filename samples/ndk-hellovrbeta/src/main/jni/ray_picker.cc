@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ray_picker.h"  // NOLINT
+
+#include <cmath>
+#include <limits>
+
+namespace ndk_hello_vr_beta {
+
+void RayPicker::Clear() {
+  rays_.clear();
+  hits_.clear();
+  center_x_.clear();
+  center_y_.clear();
+  center_z_.clear();
+  radius_squared_.clear();
+}
+
+int RayPicker::AddRay(const gvr::Vec3f& origin, const gvr::Vec3f& direction) {
+  const float length =
+      std::sqrt(direction.x * direction.x + direction.y * direction.y +
+                direction.z * direction.z);
+  const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+  rays_.push_back(
+      {origin,
+       {direction.x * scale, direction.y * scale, direction.z * scale}});
+  hits_.push_back({-1, 0.0f});
+  return static_cast<int>(rays_.size()) - 1;
+}
+
+int RayPicker::AddTarget(const gvr::Vec3f& center, float radius) {
+  center_x_.push_back(center.x);
+  center_y_.push_back(center.y);
+  center_z_.push_back(center.z);
+  radius_squared_.push_back(radius * radius);
+  return static_cast<int>(center_x_.size()) - 1;
+}
+
+void RayPicker::Pick() {
+  const size_t target_count = center_x_.size();
+  distances_.resize(target_count);
+  const float miss = std::numeric_limits<float>::infinity();
+  for (size_t ray = 0; ray < rays_.size(); ++ray) {
+    const gvr::Vec3f& origin = rays_[ray].origin;
+    const gvr::Vec3f& direction = rays_[ray].direction;
+    const float* center_x = center_x_.data();
+    const float* center_y = center_y_.data();
+    const float* center_z = center_z_.data();
+    const float* radius_squared = radius_squared_.data();
+    float* distances = distances_.data();
+    for (size_t i = 0; i < target_count; ++i) {
+      const float to_center_x = center_x[i] - origin.x;
+      const float to_center_y = center_y[i] - origin.y;
+      const float to_center_z = center_z[i] - origin.z;
+      // The distance along the ray to the point closest to the center, and
+      // the squared distance of that point to the center.
+      const float along = to_center_x * direction.x +
+                          to_center_y * direction.y +
+                          to_center_z * direction.z;
+      const float off_squared = to_center_x * to_center_x +
+                                to_center_y * to_center_y +
+                                to_center_z * to_center_z - along * along;
+      const float inside_squared = radius_squared[i] - off_squared;
+      const bool hit = along >= 0.0f && inside_squared > 0.0f;
+      distances[i] =
+          hit ? along - std::sqrt(std::fmax(inside_squared, 0.0f)) : miss;
+    }
+
+    Hit& nearest = hits_[ray];
+    nearest = {-1, miss};
+    for (size_t i = 0; i < target_count; ++i) {
+      if (distances[i] < nearest.distance) {
+        nearest = {static_cast<int>(i), distances[i]};
+      }
+    }
+  }
+}
+
+}  // namespace ndk_hello_vr_beta
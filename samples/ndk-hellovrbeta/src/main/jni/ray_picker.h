@@ -0,0 +1,82 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_RAY_PICKER_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_RAY_PICKER_H_  // NOLINT
+
+#include <vector>
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+namespace ndk_hello_vr_beta {
+
+// Finds the nearest target that each pointing ray hits, for all rays at once.
+//
+// The rays and targets are set once per frame and Pick() tests every ray
+// against every target. The results then stay valid for the rest of the
+// frame, so everything that asks what a laser points at sees the same answer.
+// Targets are bounding spheres stored as separate arrays of each component,
+// which keeps the inner loop free of branches so that the compiler can
+// vectorize it.
+class RayPicker {
+ public:
+  // The result of Pick() for one ray.
+  struct Hit {
+    // The index of the nearest target hit, or -1 if the ray misses them all.
+    int target;
+    // The distance along the ray to the surface of that target.
+    float distance;
+  };
+
+  // Removes all rays and targets.
+  void Clear();
+
+  // Adds a ray and returns its index. |direction| doesn't need to be
+  // normalized.
+  int AddRay(const gvr::Vec3f& origin, const gvr::Vec3f& direction);
+
+  // Adds a bounding sphere and returns its index.
+  int AddTarget(const gvr::Vec3f& center, float radius);
+
+  // Tests all rays against all targets. Targets behind the origin of a ray
+  // are never hit, even if the origin is inside them.
+  void Pick();
+
+  int GetRayCount() const { return static_cast<int>(hits_.size()); }
+
+  // Returns the hit of ray |ray| from the last Pick() call.
+  const Hit& GetHit(int ray) const { return hits_[ray]; }
+
+ private:
+  struct Ray {
+    gvr::Vec3f origin;
+    gvr::Vec3f direction;
+  };
+
+  std::vector<Ray> rays_;
+  std::vector<Hit> hits_;
+
+  std::vector<float> center_x_;
+  std::vector<float> center_y_;
+  std::vector<float> center_z_;
+  std::vector<float> radius_squared_;
+  // The distance of the ray to each target, reused for every ray.
+  std::vector<float> distances_;
+};
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_RAY_PICKER_H_  // NOLINT
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_RESOLUTION_CONTROLLER_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_RESOLUTION_CONTROLLER_H_  // NOLINT
+
+#include <atomic>
+#include <cstdint>
+
+#include "frame_profiler.h"  // NOLINT
+#include "vr/gvr/capi/include/gvr_types.h"
+
+namespace ndk_hello_vr_beta {
+
+// Picks the resolution of the scene each frame so that the GPU keeps up with
+// the display.
+//
+// The render scale is a factor applied to both dimensions of the recommended
+// render target size. It follows the GPU time measured by a FrameProfiler,
+// and is capped further while the device reports thermal throttling. The
+// scene is rendered into the lower left part of the swap chain buffer and
+// only that part is given to GVR through BufferViewport::SetSourceUv(), so
+// changing the scale costs nothing. The buffer itself only follows the scale
+// after a large change that lasted for several seconds.
+//
+// Must be used on the GL thread.
+class ResolutionController {
+ public:
+  ResolutionController();
+  ~ResolutionController();
+
+  // Forgets the history, e.g. after the swap chain has been recreated at the
+  // full recommended size.
+  void Reset();
+
+  // Picks the scale of the next frame.
+  //
+  // @param frame_budget_ns The time between display refreshes, in nanoseconds,
+  //     which the GPU load targets are relative to.
+  // @return true if the swap chain buffer should be resized to
+  //     GetBufferSize().
+  bool Update(const FrameProfiler& profiler, float frame_budget_ns);
+
+  // The scale at which to render the next frame, relative to the
+  // recommended size.
+  float GetRenderScale() const { return render_scale_; }
+
+  // The size the swap chain buffer should have.
+  gvr::Sizei GetBufferSize(const gvr::Sizei& recommended_size) const;
+
+  // Returns |uv| restricted to the part of the buffer that is rendered at
+  // the current scale. |uv| is relative to the whole buffer.
+  gvr::Rectf ScaleSourceUv(const gvr::Rectf& uv) const;
+
+ private:
+  // Returns the highest scale allowed by the thermal status.
+  float GetThermalScaleLimit() const;
+
+  float render_scale_;
+  float buffer_scale_;
+  // Smoothed GPU time per frame, in nanoseconds, or 0 if nothing has been
+  // measured at the current scale yet.
+  float smoothed_gpu_ns_;
+  int64_t last_measured_frame_;
+  // Frames before this one were rendered at a different scale.
+  int64_t first_frame_at_scale_;
+  // The number of consecutive frames for which the buffer had the wrong
+  // size for the render scale.
+  int frames_buffer_too_large_;
+  int frames_buffer_too_small_;
+
+  // Opaque AThermalManager, or null if the thermal API is unavailable.
+  void* thermal_manager_;
+  // The latest AThermalStatus, set from a binder thread.
+  std::atomic<int> thermal_status_;
+
+  static void OnThermalStatusChanged(void* data, int status);
+
+  ResolutionController(const ResolutionController&) = delete;
+  ResolutionController& operator=(const ResolutionController&) = delete;
+};
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_RESOLUTION_CONTROLLER_H_  // NOLINT
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "resource_registry.h"  // NOLINT
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "util.h"  // NOLINT
+
+namespace ndk_hello_vr_beta {
+
+namespace {
+
+constexpr const char* kKindNames[ResourceRegistry::kKindCount] = {
+    "meshes", "textures", "buffers", "caches"};
+
+bool IsEvictableKind(ResourceKind kind) {
+  return kind == ResourceKind::kMesh || kind == ResourceKind::kTexture;
+}
+
+double ToMegabytes(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+}  // anonymous namespace
+
+size_t ResourceRegistry::Totals::GetCpuBytes() const {
+  size_t bytes = 0;
+  for (size_t kind_bytes : cpu_bytes) {
+    bytes += kind_bytes;
+  }
+  return bytes;
+}
+
+size_t ResourceRegistry::Totals::GetGpuBytes() const {
+  size_t bytes = 0;
+  for (size_t kind_bytes : gpu_bytes) {
+    bytes += kind_bytes;
+  }
+  return bytes;
+}
+
+ResourceRegistry::ResourceRegistry() : frame_(0) {}
+
+void ResourceRegistry::BeginFrame() { ++frame_; }
+
+void ResourceRegistry::Track(const void* resource, ResourceKind kind,
+                             const std::string& name, size_t cpu_bytes,
+                             size_t gpu_bytes) {
+  auto entry = entries_.find(resource);
+  if (entry == entries_.end()) {
+    entry = entries_
+                .emplace(resource, Entry{kind, name, 0, 0, frame_, false,
+                                         nullptr, nullptr})
+                .first;
+  }
+  entry->second.kind = kind;
+  entry->second.name = name;
+  entry->second.cpu_bytes = cpu_bytes;
+  entry->second.gpu_bytes = gpu_bytes;
+}
+
+void ResourceRegistry::SetEvictable(const void* resource,
+                                    std::function<void()> evict,
+                                    std::function<void()> reload) {
+  auto entry = entries_.find(resource);
+  if (entry == entries_.end()) {
+    // The resource may become evictable before its first upload.
+    entry = entries_
+                .emplace(resource, Entry{ResourceKind::kMesh, std::string(), 0,
+                                         0, frame_, false, nullptr, nullptr})
+                .first;
+  }
+  entry->second.evicted = false;
+  entry->second.evict = std::move(evict);
+  entry->second.reload = std::move(reload);
+}
+
+void ResourceRegistry::Untrack(const void* resource) {
+  entries_.erase(resource);
+}
+
+void ResourceRegistry::MarkUsed(const void* resource) {
+  const auto entry = entries_.find(resource);
+  if (entry == entries_.end()) {
+    return;
+  }
+  entry->second.last_used_frame = frame_;
+  if (entry->second.evicted) {
+    entry->second.evicted = false;
+    // Reloading may register the resource again, which replaces the
+    // function while it runs, so it runs from a copy.
+    const std::function<void()> reload = entry->second.reload;
+    reload();
+  }
+}
+
+size_t ResourceRegistry::EnforceBudget(size_t gpu_budget_bytes) {
+  size_t gpu_bytes = 0;
+  std::vector<std::pair<int64_t, Entry*>> candidates;
+  for (auto& resource_entry : entries_) {
+    Entry& entry = resource_entry.second;
+    if (!IsEvictableKind(entry.kind)) {
+      continue;
+    }
+    gpu_bytes += entry.gpu_bytes;
+    // Resources without GPU memory, such as meshes that are still loading,
+    // have nothing to evict.
+    if (entry.evict && !entry.evicted && entry.gpu_bytes > 0 &&
+        entry.last_used_frame < frame_) {
+      candidates.emplace_back(entry.last_used_frame, &entry);
+    }
+  }
+  if (gpu_bytes <= gpu_budget_bytes) {
+    return 0;
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const std::pair<int64_t, Entry*>& a,
+               const std::pair<int64_t, Entry*>& b) {
+              return a.first < b.first;
+            });
+  size_t evicted_count = 0;
+  for (const auto& candidate : candidates) {
+    if (gpu_bytes <= gpu_budget_bytes) {
+      break;
+    }
+    Entry& entry = *candidate.second;
+    const size_t entry_bytes = entry.gpu_bytes;
+    // Evicting updates the entry through Track(), which never adds entries,
+    // so |candidates| stays valid.
+    entry.evict();
+    entry.evicted = true;
+    gpu_bytes = gpu_bytes - entry_bytes + entry.gpu_bytes;
+    LOGD("Evicted %s, which was last used %lld frames ago.",
+         entry.name.c_str(),
+         static_cast<long long>(frame_ - entry.last_used_frame));
+    ++evicted_count;
+  }
+  return evicted_count;
+}
+
+ResourceRegistry::Totals ResourceRegistry::GetTotals() const {
+  Totals totals = {};
+  for (const auto& resource_entry : entries_) {
+    const Entry& entry = resource_entry.second;
+    const int kind = static_cast<int>(entry.kind);
+    totals.cpu_bytes[kind] += entry.cpu_bytes;
+    totals.gpu_bytes[kind] += entry.gpu_bytes;
+    if (entry.evicted) {
+      ++totals.evicted_count;
+    }
+  }
+  return totals;
+}
+
+void ResourceRegistry::LogTotals(const char* reason) const {
+  const Totals totals = GetTotals();
+  std::string kinds;
+  for (int kind = 0; kind < kKindCount; ++kind) {
+    char line[96];
+    snprintf(line, sizeof(line), ", %s %.1f/%.1f", kKindNames[kind],
+             ToMegabytes(totals.cpu_bytes[kind]),
+             ToMegabytes(totals.gpu_bytes[kind]));
+    kinds += line;
+  }
+  LOGD("Memory (%s): CPU/GPU MB %.1f/%.1f%s, %zu evicted.", reason,
+       ToMegabytes(totals.GetCpuBytes()), ToMegabytes(totals.GetGpuBytes()),
+       kinds.c_str(), totals.evicted_count);
+}
+
+ResourceRegistry& GetResourceRegistry() {
+  static ResourceRegistry registry;
+  return registry;
+}
+
+}  // namespace ndk_hello_vr_beta
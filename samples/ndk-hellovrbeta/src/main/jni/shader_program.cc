@@ -14,7 +14,9 @@
  */
 
 #include "shader_program.h"  // NOLINT
+#include "program_cache.h"   // NOLINT
 #include "util.h"            // NOLINT
+#include "view_uniforms.h"   // NOLINT
 
 namespace ndk_hello_vr_beta {
 
@@ -23,7 +25,9 @@ namespace {
 // Multiview vertex shaders use transforms defined by arrays of mat4 uniforms,
 // using gl_ViewID_OVR to determine the array index.
 
-// Simple shaders to render .obj files without any lighting.
+// Simple shaders to render .obj files without any lighting. The model matrix
+// is an attribute so that copies of a mesh can be drawn with instancing; see
+// DrawList.
 constexpr const char* kTexturedMeshVertexShader =
     // The following shader is for multiview rendering.
     R"glsl(#version 320 es
@@ -31,15 +35,16 @@ constexpr const char* kTexturedMeshVertexShader =
 
     layout(num_views=2) in;
 
-    uniform mat4 u_MVP[2];
+    )glsl" HELLOVRBETA_VIEW_UNIFORMS_GLSL R"glsl(
+    in mat4 a_Model;
     in vec4 a_Position;
     in vec2 a_UV;
     out vec2 v_UV;
 
     void main() {
-      mat4 mvp = u_MVP[gl_ViewID_OVR];
+      mat4 vp = u_VP[gl_ViewID_OVR];
       v_UV = a_UV;
-      gl_Position = mvp * a_Position;
+      gl_Position = vp * (a_Model * a_Position);
     })glsl";
 
 constexpr const char* kTexturedMeshFragmentShader =
@@ -56,6 +61,42 @@ constexpr const char* kTexturedMeshFragmentShader =
       FragColor = texture(u_Texture, vec2(v_UV.x, 1.0 - v_UV.y));
     })glsl";
 
+// The same shaders for array textures, which pick their layer with a
+// per-instance attribute.
+constexpr const char* kTexturedArrayMeshVertexShader =
+    R"glsl(#version 320 es
+    #extension GL_OVR_multiview2 : enable
+
+    layout(num_views=2) in;
+
+    )glsl" HELLOVRBETA_VIEW_UNIFORMS_GLSL R"glsl(
+    in mat4 a_Model;
+    in float a_TextureLayer;
+    in vec4 a_Position;
+    in vec2 a_UV;
+    out vec3 v_UV;
+
+    void main() {
+      mat4 vp = u_VP[gl_ViewID_OVR];
+      v_UV = vec3(a_UV, a_TextureLayer);
+      gl_Position = vp * (a_Model * a_Position);
+    })glsl";
+
+constexpr const char* kTexturedArrayMeshFragmentShader =
+    R"glsl(#version 320 es
+
+    precision mediump float;
+    precision mediump sampler2DArray;
+    in vec3 v_UV;
+    out vec4 FragColor;
+    uniform sampler2DArray u_Texture;
+
+    void main() {
+      // The y coordinate of this sample's textures is reversed compared to
+      // what OpenGL expects, so we invert the y coordinate.
+      FragColor = texture(u_Texture, vec3(v_UV.x, 1.0 - v_UV.y, v_UV.z));
+    })glsl";
+
 constexpr const char* kTexturedAlphaMeshFragmentShader =
     R"glsl(#version 320 es
 
@@ -102,65 +143,52 @@ constexpr const char* kTexturedMeshAlphaFragmentShader =
       FragColor.a = FragColor.a * a_Alpha;
     })glsl";
 
-/**
- * Converts a string into an OpenGL ES shader.
- *
- * @param type The type of shader (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER).
- * @param shader_source The source code of the shader.
- * @return The shader object handler, or 0 if there's an error.
- */
-GLuint LoadGLShader(GLenum type, const char* shader_source) {
-  GLuint shader = glCreateShader(type);
-  glShaderSource(shader, 1, &shader_source, nullptr);
-  glCompileShader(shader);
-
-  // Get the compilation status.
-  GLint compile_status;
-  glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
-
-  // If the compilation failed, delete the shader and show an error.
-  if (compile_status == 0) {
-    GLint info_len = 0;
-    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_len);
-    if (info_len == 0) {
-      return 0;
-    }
+constexpr const char* kOverlayVertexShader =
+    R"glsl(#version 300 es
+    #extension GL_OVR_multiview2 : enable
 
-    std::vector<char> info_string(info_len);
-    glGetShaderInfoLog(shader, info_string.size(), nullptr, info_string.data());
-    LOGE("Could not compile shader of type %d: %s", type, info_string.data());
-    glDeleteShader(shader);
-    return 0;
-  } else {
-    return shader;
-  }
-}
+    layout(num_views=2) in;
 
-}  // anonymous namespace
+    in vec2 a_Position;
+    in vec4 a_Color;
+    out vec4 v_Color;
 
-void ShaderProgram::Link(const char* vertex, const char* fragment) {
-  program_ = glCreateProgram();
+    void main() {
+      v_Color = a_Color;
+      gl_Position = vec4(a_Position, 0.0, 1.0);
+    })glsl";
 
-  const int vertex_shader = LoadGLShader(GL_VERTEX_SHADER, vertex);
-  const int fragment_shader = LoadGLShader(GL_FRAGMENT_SHADER, fragment);
+constexpr const char* kOverlayFragmentShader =
+    R"glsl(#version 300 es
+
+    precision mediump float;
+    in vec4 v_Color;
+    out vec4 FragColor;
 
-  glAttachShader(program_, vertex_shader);
-  glAttachShader(program_, fragment_shader);
-  glLinkProgram(program_);
+    void main() {
+      FragColor = v_Color;
+    })glsl";
+
+}  // anonymous namespace
+
+void ShaderProgram::Link(const char* vertex, const char* fragment) {
+  program_ = GetProgramCache().CreateProgram(
+      vertex, fragment,
+      {{kModelMatrixAttribLocation, "a_Model"},
+       {kTextureLayerAttribLocation, "a_TextureLayer"}});
   glUseProgram(program_);
+  ViewUniforms::AttachToProgram(program_);
 }
 
 void TexturedShaderProgram::Link() {
   ShaderProgram::Link(kTexturedMeshVertexShader, kTexturedMeshFragmentShader);
-  mode_view_projection_ = glGetUniformLocation(program_, "u_MVP");
+  InitializeDrawProgram();
 }
 
-void TexturedShaderProgram::SetModelViewProjection(
-    const gvr::Mat4f& model, const gvr::Mat4f view_projection[2]) const {
-  gvr::Mat4f model_view_projection[2] = {MatrixMul(view_projection[0], model),
-                                         MatrixMul(view_projection[1], model)};
-  glUniformMatrix4fv(mode_view_projection_, 2, GL_FALSE,
-                     MatrixPairToGLArray(model_view_projection).data());
+void TexturedShaderProgram::InitializeDrawProgram() {
+  draw_program_.program = program_;
+  draw_program_.view_projection_uniform =
+      glGetUniformLocation(program_, "u_VP");
 }
 
 GLuint TexturedShaderProgram::GetPositionAttribute() const {
@@ -171,10 +199,16 @@ GLuint TexturedShaderProgram::GetUVAttribute() const {
   return glGetAttribLocation(program_, "a_UV");
 }
 
+void TexturedArrayShaderProgram::Link() {
+  ShaderProgram::Link(kTexturedArrayMeshVertexShader,
+                      kTexturedArrayMeshFragmentShader);
+  InitializeDrawProgram();
+}
+
 void TexturedAlphaShaderProgram::Link() {
   ShaderProgram::Link(kTexturedMeshVertexShader,
                       kTexturedAlphaMeshFragmentShader);
-  mode_view_projection_ = glGetUniformLocation(program_, "u_MVP");
+  InitializeDrawProgram();
   alpha_ = glGetUniformLocation(program_, "a_Alpha");
 }
 
@@ -182,10 +216,16 @@ void TexturedAlphaShaderProgram::SetAlpha(float alpha) const {
   glUniform1f(alpha_, alpha);
 }
 
+void TexturedAlphaShaderProgram::SetItemUniforms(const void* item_uniforms) {
+  const ItemUniforms* uniforms =
+      static_cast<const ItemUniforms*>(item_uniforms);
+  uniforms->program->SetAlpha(uniforms->alpha);
+}
+
 void ControllerShaderProgram::Link() {
   ShaderProgram::Link(kTexturedMeshVertexShader,
                       kTexturedMeshAlphaFragmentShader);
-  mode_view_projection_ = glGetUniformLocation(program_, "u_MVP");
+  InitializeDrawProgram();
   alpha_ = glGetUniformLocation(program_, "a_Alpha");
   battery_uv_rect_ = glGetUniformLocation(program_, "a_BatteryUVRect");
   battery_offset_ = glGetUniformLocation(program_, "a_BatteryOffset");
@@ -200,4 +240,24 @@ void ControllerShaderProgram::SetBatteryOffset(const gvr::Vec2f& offset) const {
   glUniform2f(battery_offset_, offset.x, offset.y);
 }
 
+void ControllerShaderProgram::SetItemUniforms(const void* item_uniforms) {
+  const ItemUniforms* uniforms =
+      static_cast<const ItemUniforms*>(item_uniforms);
+  uniforms->program->SetAlpha(uniforms->alpha);
+  uniforms->program->SetBatteryUVRect(uniforms->battery_uv_rect);
+  uniforms->program->SetBatteryOffset(uniforms->battery_offset);
+}
+
+void OverlayShaderProgram::Link() {
+  ShaderProgram::Link(kOverlayVertexShader, kOverlayFragmentShader);
+}
+
+GLuint OverlayShaderProgram::GetPositionAttribute() const {
+  return glGetAttribLocation(program_, "a_Position");
+}
+
+GLuint OverlayShaderProgram::GetColorAttribute() const {
+  return glGetAttribLocation(program_, "a_Color");
+}
+
 }  // namespace ndk_hello_vr_beta
@@ -19,6 +19,8 @@
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
 
+#include "draw_list.h"       // NOLINT
+#include "gl_state_cache.h"  // NOLINT
 #include "vr/gvr/capi/include/gvr.h"
 
 namespace ndk_hello_vr_beta {
@@ -28,7 +30,7 @@ namespace ndk_hello_vr_beta {
  */
 class ShaderProgram {
  public:
-  void Use() const { glUseProgram(program_); }
+  void Use() const { GetGlStateCache().UseProgram(program_); }
 
  protected:
   void Link(const char* vertex, const char* fragment);
@@ -43,11 +45,23 @@ class TexturedShaderProgram : public ShaderProgram {
   GLuint GetPositionAttribute() const;
   GLuint GetUVAttribute() const;
 
-  void SetModelViewProjection(const gvr::Mat4f& model,
-                              const gvr::Mat4f view_projection[2]) const;
+  // The program and its view-projection uniform, for drawing through a
+  // DrawList.
+  const DrawProgram* GetDrawProgram() const { return &draw_program_; }
 
  protected:
-  GLuint mode_view_projection_;
+  void InitializeDrawProgram();
+
+  DrawProgram draw_program_ = {0, -1};
+};
+
+/**
+ * Samples the layer of an array texture given by DrawItem::texture_layer; see
+ * Texture::InitializeArray().
+ */
+class TexturedArrayShaderProgram : public TexturedShaderProgram {
+ public:
+  void Link();
 };
 
 class TexturedAlphaShaderProgram : public TexturedShaderProgram {
@@ -56,6 +70,16 @@ class TexturedAlphaShaderProgram : public TexturedShaderProgram {
 
   void SetAlpha(float alpha) const;
 
+  // Per-item uniform values, for DrawItem::uniform_data.
+  struct ItemUniforms {
+    const TexturedAlphaShaderProgram* program;
+    float alpha;
+  };
+
+  // Sets the uniforms from an ItemUniforms; a DrawItem::set_uniforms
+  // callback.
+  static void SetItemUniforms(const void* item_uniforms);
+
  protected:
   GLuint alpha_;
 };
@@ -67,11 +91,35 @@ class ControllerShaderProgram : public TexturedAlphaShaderProgram {
   void SetBatteryUVRect(const gvr::Rectf& uv) const;
   void SetBatteryOffset(const gvr::Vec2f& offset) const;
 
+  // Per-item uniform values, for DrawItem::uniform_data.
+  struct ItemUniforms {
+    const ControllerShaderProgram* program;
+    float alpha;
+    gvr::Rectf battery_uv_rect;
+    gvr::Vec2f battery_offset;
+  };
+
+  // Sets the uniforms from an ItemUniforms; a DrawItem::set_uniforms
+  // callback.
+  static void SetItemUniforms(const void* item_uniforms);
+
  protected:
   GLuint battery_uv_rect_;
   GLuint battery_offset_;
 };
 
+/**
+ * Draws untextured, vertex-colored 2D geometry given in normalized device
+ * coordinates, identically in both views.
+ */
+class OverlayShaderProgram : public ShaderProgram {
+ public:
+  void Link();
+
+  GLuint GetPositionAttribute() const;
+  GLuint GetColorAttribute() const;
+};
+
 }  // namespace ndk_hello_vr_beta
 
 #endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_SHADER_PROGRAM_H_  // NOLINT
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_SIMD_MATH_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_SIMD_MATH_H_  // NOLINT
+
+// 4x4 matrix kernels for the per-frame path, using NEON on ARM, SSE on x86
+// and plain C++ elsewhere.
+//
+// Matrices are 16 floats in row-major order, the layout of gvr::Mat4f. Each
+// kernel performs the same multiplications and additions in the same order
+// as the scalar code, so all three implementations give identical results
+// (barring FMA contraction by the compiler). Outputs must not overlap the
+// inputs.
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HELLOVRBETA_SIMD_NEON 1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define HELLOVRBETA_SIMD_SSE 1
+#endif
+
+namespace ndk_hello_vr_beta {
+
+#if defined(HELLOVRBETA_SIMD_NEON)
+
+typedef float32x4_t SimdVec4;
+
+inline SimdVec4 SimdLoad(const float* values) { return vld1q_f32(values); }
+inline void SimdStore(float* values, SimdVec4 v) { vst1q_f32(values, v); }
+inline SimdVec4 SimdSplat(float value) { return vdupq_n_f32(value); }
+inline SimdVec4 SimdAdd(SimdVec4 a, SimdVec4 b) { return vaddq_f32(a, b); }
+inline SimdVec4 SimdMul(SimdVec4 a, SimdVec4 b) { return vmulq_f32(a, b); }
+
+// Loads a row-major matrix as its four columns.
+inline void SimdLoadColumns(const float* matrix, SimdVec4 columns[4]) {
+  // The de-interleaving load picks every fourth element, i.e. a column.
+  const float32x4x4_t loaded = vld4q_f32(matrix);
+  columns[0] = loaded.val[0];
+  columns[1] = loaded.val[1];
+  columns[2] = loaded.val[2];
+  columns[3] = loaded.val[3];
+}
+
+#elif defined(HELLOVRBETA_SIMD_SSE)
+
+typedef __m128 SimdVec4;
+
+inline SimdVec4 SimdLoad(const float* values) { return _mm_loadu_ps(values); }
+inline void SimdStore(float* values, SimdVec4 v) { _mm_storeu_ps(values, v); }
+inline SimdVec4 SimdSplat(float value) { return _mm_set1_ps(value); }
+inline SimdVec4 SimdAdd(SimdVec4 a, SimdVec4 b) { return _mm_add_ps(a, b); }
+inline SimdVec4 SimdMul(SimdVec4 a, SimdVec4 b) { return _mm_mul_ps(a, b); }
+
+// Loads a row-major matrix as its four columns.
+inline void SimdLoadColumns(const float* matrix, SimdVec4 columns[4]) {
+  columns[0] = _mm_loadu_ps(matrix);
+  columns[1] = _mm_loadu_ps(matrix + 4);
+  columns[2] = _mm_loadu_ps(matrix + 8);
+  columns[3] = _mm_loadu_ps(matrix + 12);
+  _MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+}
+
+#endif
+
+// out = a * b.
+inline void MultiplyMat4(const float* a, const float* b, float* out) {
+#if defined(HELLOVRBETA_SIMD_NEON) || defined(HELLOVRBETA_SIMD_SSE)
+  const SimdVec4 b0 = SimdLoad(b);
+  const SimdVec4 b1 = SimdLoad(b + 4);
+  const SimdVec4 b2 = SimdLoad(b + 8);
+  const SimdVec4 b3 = SimdLoad(b + 12);
+  // Each row of the result is a linear combination of the rows of |b|.
+  for (int i = 0; i < 4; ++i) {
+    const float* row = a + i * 4;
+    SimdVec4 result = SimdMul(b0, SimdSplat(row[0]));
+    result = SimdAdd(result, SimdMul(b1, SimdSplat(row[1])));
+    result = SimdAdd(result, SimdMul(b2, SimdSplat(row[2])));
+    result = SimdAdd(result, SimdMul(b3, SimdSplat(row[3])));
+    SimdStore(out + i * 4, result);
+  }
+#else
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      float result = a[i * 4] * b[j];
+      for (int k = 1; k < 4; ++k) {
+        result += a[i * 4 + k] * b[k * 4 + j];
+      }
+      out[i * 4 + j] = result;
+    }
+  }
+#endif
+}
+
+// out = matrix * vec, for a 4-element column vector.
+inline void MultiplyMat4Vec4(const float* matrix, const float* vec,
+                             float* out) {
+#if defined(HELLOVRBETA_SIMD_NEON) || defined(HELLOVRBETA_SIMD_SSE)
+  SimdVec4 columns[4];
+  SimdLoadColumns(matrix, columns);
+  SimdVec4 result = SimdMul(columns[0], SimdSplat(vec[0]));
+  result = SimdAdd(result, SimdMul(columns[1], SimdSplat(vec[1])));
+  result = SimdAdd(result, SimdMul(columns[2], SimdSplat(vec[2])));
+  result = SimdAdd(result, SimdMul(columns[3], SimdSplat(vec[3])));
+  SimdStore(out, result);
+#else
+  for (int i = 0; i < 4; ++i) {
+    float result = matrix[i * 4] * vec[0];
+    for (int k = 1; k < 4; ++k) {
+      result += matrix[i * 4 + k] * vec[k];
+    }
+    out[i] = result;
+  }
+#endif
+}
+
+// Stores the transpose of |matrix| to |out|, which turns a row-major matrix
+// into the column-major layout expected by glUniformMatrix4fv().
+inline void TransposeMat4(const float* matrix, float* out) {
+#if defined(HELLOVRBETA_SIMD_NEON) || defined(HELLOVRBETA_SIMD_SSE)
+  SimdVec4 columns[4];
+  SimdLoadColumns(matrix, columns);
+  SimdStore(out, columns[0]);
+  SimdStore(out + 4, columns[1]);
+  SimdStore(out + 8, columns[2]);
+  SimdStore(out + 12, columns[3]);
+#else
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      out[j * 4 + i] = matrix[i * 4 + j];
+    }
+  }
+#endif
+}
+
+// Computes the inverse of an affine |matrix| whose upper 3x3 part is
+// orthonormal, in the form used by GetOrthoInverse(): the rotation is
+// transposed and the translation column negated.
+inline void OrthoInverseMat4(const float* matrix, float* out) {
+#if defined(HELLOVRBETA_SIMD_NEON) || defined(HELLOVRBETA_SIMD_SSE)
+  SimdVec4 columns[4];
+  SimdLoadColumns(matrix, columns);
+  SimdStore(out, columns[0]);
+  SimdStore(out + 4, columns[1]);
+  SimdStore(out + 8, columns[2]);
+#else
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      out[i * 4 + j] = matrix[j * 4 + i];
+    }
+  }
+#endif
+  for (int i = 0; i < 3; ++i) {
+    out[i * 4 + 3] = -matrix[i * 4 + 3];
+  }
+  out[12] = 0.0f;
+  out[13] = 0.0f;
+  out[14] = 0.0f;
+  out[15] = 1.0f;
+}
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_SIMD_MATH_H_  // NOLINT
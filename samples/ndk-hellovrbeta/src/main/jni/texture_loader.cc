@@ -0,0 +1,361 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "texture_loader.h"  // NOLINT
+
+#include <android/asset_manager_jni.h>
+#include <android/bitmap.h>
+#include <string.h>  // Needed for memcpy
+#include <algorithm>
+#include <utility>
+
+#include "ktx_texture.h"        // NOLINT
+#include "resource_registry.h"  // NOLINT
+
+namespace ndk_hello_vr_beta {
+
+namespace {
+
+// Decoding is mostly bound by inflating the PNG data, so a couple of workers
+// keep the startup textures flowing without competing with the GL thread.
+constexpr size_t kDecodeThreadCount = 2;
+
+// Clears a pending Java exception, returning whether there was one.
+bool ClearException(JNIEnv* env) {
+  if (env->ExceptionCheck()) {
+    env->ExceptionClear();
+    return true;
+  }
+  return false;
+}
+
+jclass FindGlobalClass(JNIEnv* env, const char* name) {
+  jclass local_class = env->FindClass(name);
+  HELLOVRBETA_CHECK(local_class != nullptr);
+  jclass global_class = static_cast<jclass>(env->NewGlobalRef(local_class));
+  env->DeleteLocalRef(local_class);
+  return global_class;
+}
+
+// Appends box-filtered levels to |image| until a 1x1 level is reached. The
+// decoded pixels have premultiplied alpha, so averaging them directly is
+// correct.
+void GenerateMipChain(TextureImage* image) {
+  while (image->levels.back().width > 1 || image->levels.back().height > 1) {
+    const TextureImage::Level& src = image->levels.back();
+    TextureImage::Level dst;
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.data.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+    const size_t src_row_size = static_cast<size_t>(src.width) * 4;
+    const size_t dst_row_size = static_cast<size_t>(dst.width) * 4;
+    for (int y = 0; y < dst.height; ++y) {
+      const int y0 = std::min(y * 2, src.height - 1);
+      const int y1 = std::min(y * 2 + 1, src.height - 1);
+      const uint8_t* row0 = &src.data[y0 * src_row_size];
+      const uint8_t* row1 = &src.data[y1 * src_row_size];
+      uint8_t* out = &dst.data[y * dst_row_size];
+      for (int x = 0; x < dst.width; ++x) {
+        const int x0 = std::min(x * 2, src.width - 1) * 4;
+        const int x1 = std::min(x * 2 + 1, src.width - 1) * 4;
+        for (int c = 0; c < 4; ++c) {
+          out[x * 4 + c] = static_cast<uint8_t>(
+              (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) /
+              4);
+        }
+      }
+    }
+    image->levels.push_back(std::move(dst));
+  }
+}
+
+}  // anonymous namespace
+
+TextureLoader::TextureLoader(JNIEnv* env, jobject java_asset_mgr)
+    : java_vm_(nullptr),
+      java_asset_mgr_(env->NewGlobalRef(java_asset_mgr)),
+      asset_mgr_(AAssetManager_fromJava(env, java_asset_mgr_)),
+      formats_queried_(false),
+      astc_supported_(false),
+      etc2_supported_(false),
+      pending_count_(0),
+      cache_bytes_(0) {
+  HELLOVRBETA_CHECK(env->GetJavaVM(&java_vm_) == JNI_OK);
+
+  bitmap_factory_class_ =
+      FindGlobalClass(env, "android/graphics/BitmapFactory");
+  bitmap_factory_options_class_ =
+      FindGlobalClass(env, "android/graphics/BitmapFactory$Options");
+  jclass asset_manager_class =
+      env->FindClass("android/content/res/AssetManager");
+  jclass input_stream_class = env->FindClass("java/io/InputStream");
+  jclass bitmap_class = env->FindClass("android/graphics/Bitmap");
+  jclass bitmap_config_class =
+      env->FindClass("android/graphics/Bitmap$Config");
+
+  asset_manager_open_method_ = env->GetMethodID(
+      asset_manager_class, "open", "(Ljava/lang/String;)Ljava/io/InputStream;");
+  input_stream_close_method_ =
+      env->GetMethodID(input_stream_class, "close", "()V");
+  decode_stream_method_ = env->GetStaticMethodID(
+      bitmap_factory_class_, "decodeStream",
+      "(Ljava/io/InputStream;Landroid/graphics/Rect;"
+      "Landroid/graphics/BitmapFactory$Options;)Landroid/graphics/Bitmap;");
+  options_constructor_ =
+      env->GetMethodID(bitmap_factory_options_class_, "<init>", "()V");
+  options_preferred_config_field_ =
+      env->GetFieldID(bitmap_factory_options_class_, "inPreferredConfig",
+                      "Landroid/graphics/Bitmap$Config;");
+  bitmap_recycle_method_ = env->GetMethodID(bitmap_class, "recycle", "()V");
+  jfieldID argb_8888_field = env->GetStaticFieldID(
+      bitmap_config_class, "ARGB_8888", "Landroid/graphics/Bitmap$Config;");
+  jobject argb_8888 =
+      env->GetStaticObjectField(bitmap_config_class, argb_8888_field);
+  bitmap_config_argb_8888_ = env->NewGlobalRef(argb_8888);
+
+  env->DeleteLocalRef(argb_8888);
+  env->DeleteLocalRef(bitmap_config_class);
+  env->DeleteLocalRef(bitmap_class);
+  env->DeleteLocalRef(input_stream_class);
+  env->DeleteLocalRef(asset_manager_class);
+
+  thread_pool_.reset(new ThreadPool(kDecodeThreadCount,
+                                    [this] { AttachWorkerThread(); },
+                                    [this] { DetachWorkerThread(); }));
+}
+
+TextureLoader::~TextureLoader() {
+  thread_pool_.reset();
+  GetResourceRegistry().Untrack(this);
+
+  JNIEnv* env = nullptr;
+  if (java_vm_->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) !=
+      JNI_OK) {
+    LOGE("TextureLoader destroyed on a thread without a JNI environment.");
+    return;
+  }
+  env->DeleteGlobalRef(bitmap_config_argb_8888_);
+  env->DeleteGlobalRef(bitmap_factory_options_class_);
+  env->DeleteGlobalRef(bitmap_factory_class_);
+  env->DeleteGlobalRef(java_asset_mgr_);
+}
+
+void TextureLoader::Load(const std::string& path, Texture* texture,
+                         int layer) {
+  // The loader may be created before there is a GL context, so support for
+  // compressed formats is queried here, on the GL thread.
+  if (!formats_queried_) {
+    astc_supported_ = HasGLExtension("GL_KHR_texture_compression_astc_ldr");
+    // ETC2 is core in OpenGL ES 3.0, which multiview already requires.
+    etc2_supported_ = true;
+    formats_queried_ = true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto image = images_.find(path);
+    if (image != images_.end()) {
+      decoded_images_.push_back({texture, layer, image->second});
+      return;
+    }
+    ++pending_count_;
+  }
+  thread_pool_->Post(
+      [this, path, texture, layer] { DecodeTask(path, texture, layer); });
+}
+
+bool TextureLoader::ProcessUploads(size_t byte_budget) {
+  size_t uploaded_bytes = 0;
+  while (uploaded_bytes < byte_budget) {
+    DecodedImage decoded;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (decoded_images_.empty()) {
+        break;
+      }
+      decoded = std::move(decoded_images_.front());
+      decoded_images_.pop_front();
+    }
+    if (!decoded.image) {
+      continue;
+    }
+    decoded.texture->Upload(*decoded.image, decoded.layer);
+    for (const TextureImage::Level& level : decoded.image->levels) {
+      uploaded_bytes += level.data.size();
+    }
+  }
+  CheckGLError("TextureLoader::ProcessUploads");
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  GetResourceRegistry().Track(this, ResourceKind::kCache, "decoded images",
+                              cache_bytes_, 0);
+  return pending_count_ > 0 || !decoded_images_.empty();
+}
+
+void TextureLoader::ClearCache() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    images_.clear();
+    cache_bytes_ = 0;
+  }
+  GetResourceRegistry().Track(this, ResourceKind::kCache, "decoded images", 0,
+                              0);
+}
+
+void TextureLoader::AttachWorkerThread() {
+  JNIEnv* env = nullptr;
+  HELLOVRBETA_CHECK(java_vm_->AttachCurrentThread(&env, nullptr) == JNI_OK);
+}
+
+void TextureLoader::DetachWorkerThread() { java_vm_->DetachCurrentThread(); }
+
+void TextureLoader::DecodeTask(const std::string& path, Texture* texture,
+                               int layer) {
+  std::shared_ptr<TextureImage> image(new TextureImage);
+  if (!LoadCompressed(path, image.get()) && !DecodePng(path, image.get())) {
+    LOGE("Couldn't load texture %s.", path.c_str());
+    image.reset();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (image && images_.emplace(path, image).second) {
+    for (const TextureImage::Level& level : image->levels) {
+      cache_bytes_ += level.data.size();
+    }
+  }
+  decoded_images_.push_back({texture, layer, image});
+  --pending_count_;
+}
+
+bool TextureLoader::LoadCompressed(const std::string& path,
+                                   TextureImage* image) {
+  const std::string base_path = path.substr(0, path.rfind('.'));
+  const struct {
+    bool supported;
+    bool astc;
+    const char* suffix;
+  } variants[] = {
+      // ASTC gives better quality for the same size, so it is preferred.
+      {astc_supported_, true, ".astc.ktx"},
+      {etc2_supported_, false, ".etc2.ktx"},
+  };
+  for (const auto& variant : variants) {
+    if (!variant.supported) {
+      continue;
+    }
+    const std::string ktx_path = base_path + variant.suffix;
+    AAsset* asset =
+        AAssetManager_open(asset_mgr_, ktx_path.c_str(), AASSET_MODE_BUFFER);
+    if (asset == nullptr) {
+      continue;
+    }
+    const char* data = static_cast<const char*>(AAsset_getBuffer(asset));
+    std::string error = "Couldn't read the file.";
+    bool success =
+        data != nullptr &&
+        ParseKtx(data, static_cast<size_t>(AAsset_getLength(asset)), image,
+                 &error);
+    AAsset_close(asset);
+    if (success && IsAstcFormat(image->compressed_format) != variant.astc) {
+      error = "Unexpected compressed format.";
+      success = false;
+    }
+    if (success) {
+      return true;
+    }
+    LOGE("Ignoring %s: %s", ktx_path.c_str(), error.c_str());
+  }
+  return false;
+}
+
+bool TextureLoader::DecodePng(const std::string& path, TextureImage* image) {
+  JNIEnv* env = nullptr;
+  java_vm_->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6);
+
+  bool success = false;
+  // Worker threads never return to Java, so local references have to be
+  // released explicitly. The frame takes care of that.
+  if (env->PushLocalFrame(16) == 0) {
+    success = DecodeBitmap(env, path, image);
+    env->PopLocalFrame(nullptr);
+  } else {
+    ClearException(env);
+  }
+  if (success) {
+    GenerateMipChain(image);
+  }
+  return success;
+}
+
+bool TextureLoader::DecodeBitmap(JNIEnv* env, const std::string& path,
+                                 TextureImage* image) {
+  jstring j_path = env->NewStringUTF(path.c_str());
+  jobject image_stream = env->CallObjectMethod(
+      java_asset_mgr_, asset_manager_open_method_, j_path);
+  if (ClearException(env) || image_stream == nullptr) {
+    LOGE("Java exception while opening %s", path.c_str());
+    return false;
+  }
+
+  // Ask for ARGB_8888 so that every image, including grayscale ones, can be
+  // uploaded as RGBA.
+  jobject options =
+      env->NewObject(bitmap_factory_options_class_, options_constructor_);
+  env->SetObjectField(options, options_preferred_config_field_,
+                      bitmap_config_argb_8888_);
+  jobject bitmap = env->CallStaticObjectMethod(
+      bitmap_factory_class_, decode_stream_method_, image_stream, nullptr,
+      options);
+  const bool decode_failed = ClearException(env) || bitmap == nullptr;
+  env->CallVoidMethod(image_stream, input_stream_close_method_);
+  ClearException(env);
+  if (decode_failed) {
+    LOGE("Java exception while decoding %s", path.c_str());
+    return false;
+  }
+
+  AndroidBitmapInfo info;
+  void* pixels = nullptr;
+  bool success = false;
+  if (AndroidBitmap_getInfo(env, bitmap, &info) ==
+          ANDROID_BITMAP_RESULT_SUCCESS &&
+      info.format == ANDROID_BITMAP_FORMAT_RGBA_8888 &&
+      AndroidBitmap_lockPixels(env, bitmap, &pixels) ==
+          ANDROID_BITMAP_RESULT_SUCCESS) {
+    TextureImage::Level level;
+    level.width = static_cast<int>(info.width);
+    level.height = static_cast<int>(info.height);
+    const size_t row_size = static_cast<size_t>(info.width) * 4;
+    level.data.resize(row_size * info.height);
+    for (uint32_t y = 0; y < info.height; ++y) {
+      memcpy(&level.data[y * row_size],
+             static_cast<const uint8_t*>(pixels) + y * info.stride, row_size);
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+    image->compressed_format = 0;
+    image->levels.clear();
+    image->levels.push_back(std::move(level));
+    success = true;
+  } else {
+    LOGE("Unsupported bitmap for %s", path.c_str());
+  }
+
+  // Release the Java pixel memory now instead of waiting for the GC.
+  env->CallVoidMethod(bitmap, bitmap_recycle_method_);
+  ClearException(env);
+  return success;
+}
+
+}  // namespace ndk_hello_vr_beta
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_TEXTURE_LOADER_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_TEXTURE_LOADER_H_  // NOLINT
+
+#include <android/asset_manager.h>
+#include <jni.h>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "thread_pool.h"  // NOLINT
+#include "util.h"         // NOLINT
+
+namespace ndk_hello_vr_beta {
+
+// Loads textures from the app's assets without blocking the GL thread.
+//
+// Images are decoded and their mip chains generated on worker threads. The
+// results are queued and uploaded by ProcessUploads() on the GL thread, so a
+// frame only pays for the glTexImage2D calls that fit in its budget.
+//
+// For an image "name.png", the loader first looks for block compressed
+// variants named "name.astc.ktx" and "name.etc2.ktx" (see ParseKtx()), and
+// uses the first one the GL context supports. These are uploaded as-is with
+// their offline-built mip chains. Like the decoded PNGs, they should have
+// premultiplied alpha. Tools such as astcenc, etcpack or PVRTexTool can
+// produce them as KTX 1.1 files.
+//
+// The loader must be destroyed before the textures it loads into.
+class TextureLoader {
+ public:
+  // @param env The JNI environment of the calling thread.
+  // @param java_asset_mgr The Java AssetManager to load images from.
+  TextureLoader(JNIEnv* env, jobject java_asset_mgr);
+
+  ~TextureLoader();
+
+  // Queues the image at |path| to be decoded and uploaded into |layer| of
+  // |texture|; see Texture::Upload(). Must be called on the GL thread.
+  //
+  // Decoded images are kept, so loading a path again, such as after the GL
+  // context was lost or the texture was evicted, skips straight to the
+  // upload.
+  void Load(const std::string& path, Texture* texture, int layer);
+
+  // Uploads decoded images. Must be called on the GL thread, typically once
+  // per frame.
+  //
+  // @param byte_budget Stop after this many bytes of pixel data have been
+  //     uploaded. At least one image is uploaded if one is ready.
+  // @return True if some loads have not been uploaded yet.
+  bool ProcessUploads(size_t byte_budget);
+
+  // Drops the decoded images that are kept for reloads, such as when the
+  // system is low on memory. Later loads decode their images again. Must be
+  // called on the GL thread.
+  void ClearCache();
+
+ private:
+  struct DecodedImage {
+    Texture* texture;
+    int layer;
+    // Null if the image could not be loaded.
+    std::shared_ptr<const TextureImage> image;
+  };
+
+  void AttachWorkerThread();
+  void DetachWorkerThread();
+  void DecodeTask(const std::string& path, Texture* texture, int layer);
+  bool LoadCompressed(const std::string& path, TextureImage* image);
+  bool DecodePng(const std::string& path, TextureImage* image);
+  bool DecodeBitmap(JNIEnv* env, const std::string& path,
+                    TextureImage* image);
+
+  JavaVM* java_vm_;
+  jobject java_asset_mgr_;
+  AAssetManager* asset_mgr_;
+
+  // Compressed format support of the GL context, queried on the first Load().
+  bool formats_queried_;
+  bool astc_supported_;
+  bool etc2_supported_;
+
+  // The classes, methods and fields used for decoding, looked up once instead
+  // of for every image.
+  jclass bitmap_factory_class_;
+  jclass bitmap_factory_options_class_;
+  jmethodID asset_manager_open_method_;
+  jmethodID input_stream_close_method_;
+  jmethodID decode_stream_method_;
+  jmethodID options_constructor_;
+  jfieldID options_preferred_config_field_;
+  jmethodID bitmap_recycle_method_;
+  jobject bitmap_config_argb_8888_;
+
+  std::mutex mutex_;
+  std::deque<DecodedImage> decoded_images_;
+  size_t pending_count_;
+  // Every image decoded since the last ClearCache(), by path, and their size.
+  std::unordered_map<std::string, std::shared_ptr<const TextureImage>>
+      images_;
+  size_t cache_bytes_;
+
+  // Reset first on destruction, so that the workers are stopped before the
+  // references above are released.
+  std::unique_ptr<ThreadPool> thread_pool_;
+
+  TextureLoader(const TextureLoader&) = delete;
+  TextureLoader& operator=(const TextureLoader&) = delete;
+};
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_TEXTURE_LOADER_H_  // NOLINT
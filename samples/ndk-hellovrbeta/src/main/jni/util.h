@@ -19,6 +19,7 @@
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <GLES3/gl3.h>
 #include <android/asset_manager.h>
 #include <android/log.h>
 #include <errno.h>
@@ -91,6 +92,10 @@ gvr::Mat4f GetOrthoInverse(const gvr::Mat4f& mat);
 gvr::Mat4f ProjectionMatrixFromView(const gvr::Rectf& fov, float z_near,
                                     float z_far);
 
+// Widens a field of view in degrees by |degrees| on every side. Each side
+// stays below 90 degrees, so that the result still has a projection matrix.
+gvr::Rectf WidenFov(const gvr::Rectf& fov, float degrees);
+
 // Converts the quaternion describing the controller's orientation to a
 // rotation matrix.
 gvr::Mat4f ControllerQuatToMatrix(const gvr::ControllerQuat& quat);
@@ -98,9 +103,23 @@ gvr::Mat4f ControllerQuatToMatrix(const gvr::ControllerQuat& quat);
 // Generates a random floating point number between |min| and |max|.
 float RandomUniformFloat(float min, float max);
 
+// Returns true if the current GL context advertises the named extension.
+bool HasGLExtension(const char* extension);
+
 // Checks for OpenGL errors, and crashes if one has occurred.  Note that this
-// can be an expensive call, so real applications should call this rarely.
+// can be an expensive call, because glGetError() waits for the GL command
+// stream, so it compiles to nothing in release builds (NDEBUG).
+#ifdef NDEBUG
+inline void CheckGLError(const char* label) {}
+#else
 void CheckGLError(const char* label);
+#endif
+
+// Tells the driver that the depth and stencil contents of the bound
+// framebuffer are not needed after the draws so far, so that a tiled GPU can
+// skip storing them to memory. Call after the last draw into a buffer, right
+// before Frame::Unbind().
+void DiscardDepthStencil();
 
 // Computes a texture size that has approximately half as many pixels. This is
 // equivalent to scaling each dimension by approximately sqrt(2)/2.
@@ -110,49 +129,230 @@ bool DoesRayIntersectSphere(const gvr::Vec3f& ray_origin,
                             const gvr::Vec3f& ray_direction,
                             const gvr::Vec3f& sphere_center, float radius);
 
+// The geometry of a mesh file as read by TexturedMesh::Parse(), in one of
+// the vertex layouts of mesh_format.h. It holds no GL objects, so it can be
+// built on any thread.
+struct MeshData {
+  MeshData();
+  ~MeshData();
+
+  std::string name;
+
+  // Interleaved vertices and the indices. They point into |storage| or into
+  // the memory-mapped |asset|.
+  const void* vertex_data;
+  size_t vertex_count;
+  GLsizei vertex_stride;
+  GLenum uv_type;
+  const void* index_data;
+  size_t index_count;
+  GLenum index_type;
+  gvr::Vec3f bounds_min;
+  gvr::Vec3f bounds_max;
+
+  std::vector<uint8_t> storage;
+  // Closed on destruction.
+  AAsset* asset;
+
+  MeshData(const MeshData&) = delete;
+  MeshData& operator=(const MeshData&) = delete;
+};
+
 class TexturedMesh {
  public:
   TexturedMesh();
 
-  // Initializes the mesh from a .obj file.
+  ~TexturedMesh();
+
+  // Initializes the mesh from a .obj file, or from a precompiled .mesh file
+  // (see mesh_format.h) if the path ends in ".mesh". This is Parse()
+  // followed by the Initialize() overload below.
   //
   // @return True if initialization was successful.
   bool Initialize(AAssetManager* asset_mgr,
-                  const std::string& obj_file_path, GLuint position_attrib,
+                  const std::string& file_path, GLuint position_attrib,
+                  GLuint uv_attrib);
+
+  // Reads and parses a .obj or .mesh file into |data|. Makes no GL calls, so
+  // it may run on any thread.
+  //
+  // @return True if the file could be read and is valid.
+  static bool Parse(AAssetManager* asset_mgr, const std::string& file_path,
+                    MeshData* data);
+
+  // Initializes the mesh from parsed geometry. Must be called on the GL
+  // thread.
+  //
+  // The geometry is uploaded once into an interleaved vertex buffer and an
+  // index buffer, captured in a vertex array object, and |data| may be
+  // released afterwards.
+  void Initialize(const MeshData& data, GLuint position_attrib,
                   GLuint uv_attrib);
 
   // Draws the mesh. The u_MVP uniform should be set before calling this using
   // glUniformMatrix4fv(), and a texture should be bound to GL_TEXTURE0.
   void Draw() const;
 
+  // Binds the mesh's vertex array object for DrawBound(). Attribute state set
+  // afterwards is captured by it.
+  void Bind() const;
+
+  // Draws |instance_count| instances of the mesh, which must be bound with
+  // Bind().
+  void DrawBound(GLsizei instance_count) const;
+
+  // Restores the default vertex array binding after Bind().
+  void Unbind() const;
+
+  // Deletes the GL buffers, such as when ResourceRegistry evicts the mesh.
+  // The bounds are kept, and the mesh draws nothing until it is initialized
+  // again.
+  void Release();
+
+  // Drops the names of the GL buffers without deleting them, because their
+  // context is gone. Like Release(), the mesh draws nothing until it is
+  // initialized again.
+  void Forget();
+
+  // Whether the mesh has been initialized and not released since.
+  bool IsLoaded() const { return index_count_ > 0; }
+
+  // Axis-aligned bounds of the vertex positions, in model space.
+  const gvr::Vec3f& GetBoundsMin() const { return bounds_min_; }
+  const gvr::Vec3f& GetBoundsMax() const { return bounds_max_; }
+
+  // A sphere around the vertex positions, in model space. It is centered on
+  // the axis-aligned bounds, for culling.
+  const gvr::Vec3f& GetBoundingSphereCenter() const {
+    return bounding_sphere_center_;
+  }
+  float GetBoundingSphereRadius() const { return bounding_sphere_radius_; }
+
  private:
-  std::vector<GLfloat> vertices_;
-  std::vector<GLfloat> uv_;
-  std::vector<GLushort> indices_;
+  static bool ParseMeshFile(AAssetManager* asset_mgr,
+                            const std::string& mesh_file_path,
+                            MeshData* data);
+
+  // Creates the vertex array object and GL buffers from interleaved vertex
+  // data in one of the layouts of mesh_format.h and from the index data.
+  void Upload(const void* vertex_data, size_t vertex_count,
+              GLsizei vertex_stride, GLenum uv_type, const void* index_data,
+              size_t index_count, GLenum index_type, const std::string& name);
+
+  // Computes the bounding sphere from the positions at the start of each
+  // vertex. The axis-aligned bounds must already be set.
+  void ComputeBoundingSphere(const void* vertex_data, size_t vertex_count,
+                             GLsizei vertex_stride);
+
+  GLuint vertex_buffer_;
+  GLuint index_buffer_;
+  GLuint vertex_array_;
+  GLsizei index_count_;
+  GLenum index_type_;
   GLuint position_attrib_;
   GLuint uv_attrib_;
+  gvr::Vec3f bounds_min_;
+  gvr::Vec3f bounds_max_;
+  gvr::Vec3f bounding_sphere_center_;
+  float bounding_sphere_radius_;
+  // The file the mesh was loaded from, for ResourceRegistry.
+  std::string name_;
 };
 
+// The contents of a texture, either RGBA8 pixels or block compressed data.
+// Level 0 is the full image; any further entries are its mip levels.
+struct TextureImage {
+  struct Level {
+    int width;
+    int height;
+    std::vector<uint8_t> data;
+  };
+  // The compressed internal format, or 0 for RGBA8 pixels.
+  GLenum compressed_format = 0;
+  std::vector<Level> levels;
+};
+
+class TextureLoader;
+
 class Texture {
  public:
   Texture();
 
   ~Texture();
 
-  // Initializes the texture.
+  // Initializes the texture and queues |texture_path| on |loader|.
+  //
+  // The texture can be bound right away but samples as transparent black
+  // until the loader has uploaded the image. Load errors are logged by the
+  // loader.
+  //
+  // The texture registers with GetResourceRegistry(), which may evict it
+  // while it is not drawn and reload it through |loader| once it is, so
+  // |loader| must outlive it.
   //
   // After this is called the texture will be bound, replacing any previously
   // bound texture.
+  void Initialize(TextureLoader* loader, const std::string& texture_path);
+
+  // Initializes the texture as a GL_TEXTURE_2D_ARRAY with one layer for each
+  // of |layer_paths|, and queues them on |loader|. Requires OpenGL ES 3.0.
   //
-  // @return True if initialization was successful.
-  bool Initialize(JNIEnv* env, jobject java_asset_mgr,
-                  const std::string& texture_path);
+  // This packs the variants of an object, such as its selected and
+  // unselected looks, into one texture. Items then pick their variant with
+  // DrawItem::texture_layer instead of binding another texture, so that
+  // copies in different states can share an instanced draw call. All layers
+  // must have the same size, format and mip count; a layer that differs from
+  // the first one uploaded is left out with an error.
+  //
+  // Until a layer is uploaded its texels are zero, which is transparent black
+  // for uncompressed layers. After this is called the texture will be bound,
+  // replacing any previously bound texture.
+  void InitializeArray(TextureLoader* loader,
+                       const std::vector<std::string>& layer_paths);
+
+  // Replaces the contents of |layer| of the texture with |image|, including
+  // its mip levels. |layer| must be 0 unless the texture is an array. If an
+  // uncompressed |image| has a single level, the mip chain is generated by
+  // GL; a compressed one is sampled without mipmapping.
+  //
+  // After this is called the texture will be bound, replacing any previously
+  // bound texture.
+  void Upload(const TextureImage& image, int layer);
 
   // Binds the texture, replacing any previously bound texture.
   void Bind() const;
 
  private:
+  // Allocates or replaces the storage of every layer of an array texture with
+  // the size, format and levels of |image|, discarding the uploaded layers.
+  void AllocateArray(const TextureImage& image);
+
+  void InitializeLayers(TextureLoader* loader,
+                        const std::vector<std::string>& paths);
+
+  // Creates the GL texture with the placeholder image in every layer.
+  void CreateTexture();
+
+  // Replaces the texture with the placeholder, for ResourceRegistry.
+  void Evict();
+
+  // Queues every layer on |loader_|.
+  void Reload();
+
+  TextureLoader* loader_;
+  // The image of each layer.
+  std::vector<std::string> paths_;
   GLuint texture_id_;
+  // GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for InitializeArray().
+  GLenum target_;
+  GLsizei layer_count_;
+  // The format, level 0 size and level count of the storage of an array
+  // texture, once its first layer has been uploaded. The level count is 0
+  // while it holds the placeholder.
+  GLenum array_format_;
+  int array_width_;
+  int array_height_;
+  size_t array_level_count_;
 };
 
 }  // namespace ndk_hello_vr_beta
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HELLOVRBETA_APP_SRC_MAIN_JNI_VIEW_FRUSTUM_H_  // NOLINT
+#define HELLOVRBETA_APP_SRC_MAIN_JNI_VIEW_FRUSTUM_H_  // NOLINT
+
+#include "vr/gvr/capi/include/gvr_types.h"
+
+namespace ndk_hello_vr_beta {
+
+// The volume that either eye can see, for culling objects before they are
+// submitted to GL.
+//
+// It is the union of the two eye frusta, so an object is only culled when
+// neither eye can see it.
+class ViewFrustum {
+ public:
+  ViewFrustum();
+
+  // Sets the frusta from the view-projection matrices of both eyes. Objects
+  // are only visible if they are within the clip volume of one of them.
+  void Set(const gvr::Mat4f view_projection[2]);
+
+  // Returns true if a sphere may be visible to either eye. Spheres close to a
+  // corner of a frustum can be reported as visible when they are not.
+  //
+  // @param center The center of the sphere in world space.
+  // @param radius The radius of the sphere.
+  bool IsSphereVisible(const gvr::Vec3f& center, float radius) const;
+
+ private:
+  // A plane a * x + b * y + c * z + d = 0 with a unit normal that points into
+  // the frustum.
+  struct Plane {
+    float a;
+    float b;
+    float c;
+    float d;
+  };
+
+  static constexpr int kPlaneCount = 6;
+
+  Plane planes_[2][kPlaneCount];
+};
+
+}  // namespace ndk_hello_vr_beta
+
+#endif  // HELLOVRBETA_APP_SRC_MAIN_JNI_VIEW_FRUSTUM_H_  // NOLINT
@@ -313,6 +313,7 @@ public final class MonoscopicView extends GLSurfaceView {
       }
 
       Matrix.multiplyMM(viewProjectionMatrix, 0, projectionMatrix, 0, viewMatrix, 0);
+      scene.glUpdateVideoFrame();
       scene.glDrawFrame(viewProjectionMatrix, Type.MONOCULAR);
     }
 
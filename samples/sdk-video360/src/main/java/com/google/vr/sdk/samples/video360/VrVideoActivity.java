@@ -251,7 +251,10 @@ public class VrVideoActivity extends GvrActivity {
     }
 
     @Override
-    public void onNewFrame(HeadTransform headTransform) {}
+    public void onNewFrame(HeadTransform headTransform) {
+      // Both eyes show the same video frame.
+      scene.glUpdateVideoFrame();
+    }
 
     @Override
     public void onDrawEye(Eye eye) {
@@ -86,6 +86,9 @@ public final class Mesh {
   // Vertices for the mesh with 3D position + left 2D texture UV + right 2D texture UV.
   public final float[] vertices;
   private final FloatBuffer vertexBuffer;
+  // The vertices are uploaded once into this GL_ARRAY_BUFFER, so that drawing doesn't copy them
+  // from the Java heap every frame. Only valid if program != 0.
+  private int vertexBufferId;
 
   // Program related GL items. These are only valid if program != 0.
   private int program;
@@ -216,6 +219,19 @@ public final class Mesh {
     positionHandle = GLES20.glGetAttribLocation(program, "aPosition");
     texCoordsHandle = GLES20.glGetAttribLocation(program, "aTexCoords");
     textureHandle = GLES20.glGetUniformLocation(program, "uTexture");
+
+    int[] bufferIds = new int[1];
+    GLES20.glGenBuffers(1, bufferIds, 0);
+    vertexBufferId = bufferIds[0];
+    GLES20.glBindBuffer(GLES20.GL_ARRAY_BUFFER, vertexBufferId);
+    vertexBuffer.position(0);
+    GLES20.glBufferData(
+        GLES20.GL_ARRAY_BUFFER,
+        vertices.length * Utils.BYTES_PER_FLOAT,
+        vertexBuffer,
+        GLES20.GL_STATIC_DRAW);
+    GLES20.glBindBuffer(GLES20.GL_ARRAY_BUFFER, 0);
+    checkGlError();
   }
 
   /**
@@ -239,34 +255,35 @@ public final class Mesh {
     GLES20.glUniform1i(textureHandle, 0);
     checkGlError();
 
-    // Load position data.
-    vertexBuffer.position(0);
+    // Point at the position data in the vertex buffer.
+    GLES20.glBindBuffer(GLES20.GL_ARRAY_BUFFER, vertexBufferId);
     GLES20.glVertexAttribPointer(
         positionHandle,
         POSITION_COORDS_PER_VERTEX,
         GLES20.GL_FLOAT,
         false,
         VERTEX_STRIDE_BYTES,
-        vertexBuffer);
+        0);
     checkGlError();
 
-    // Load texture data. Eye.Type.RIGHT uses the left eye's data.
+    // Point at the texture data. Eye.Type.RIGHT uses the left eye's data.
     int textureOffset =
         (eyeType == Eye.Type.RIGHT) ? POSITION_COORDS_PER_VERTEX + 2 : POSITION_COORDS_PER_VERTEX;
-    vertexBuffer.position(textureOffset);
     GLES20.glVertexAttribPointer(
         texCoordsHandle,
         TEXTURE_COORDS_PER_VERTEX,
         GLES20.GL_FLOAT,
         false,
         VERTEX_STRIDE_BYTES,
-        vertexBuffer);
+        textureOffset * Utils.BYTES_PER_FLOAT);
     checkGlError();
 
     // Render.
     GLES20.glDrawArrays(GLES20.GL_TRIANGLE_STRIP, 0, vertices.length / CPV);
     checkGlError();
 
+    // The other objects in the scene use client-side vertex arrays.
+    GLES20.glBindBuffer(GLES20.GL_ARRAY_BUFFER, 0);
     GLES20.glDisableVertexAttribArray(positionHandle);
     GLES20.glDisableVertexAttribArray(texCoordsHandle);
   }
@@ -274,6 +291,7 @@ public final class Mesh {
   /** Cleans up the GL resources. */
   /* package */ void glShutdown() {
     if (program != 0) {
+      GLES20.glDeleteBuffers(1, new int[]{vertexBufferId}, 0);
       GLES20.glDeleteProgram(program);
       GLES20.glDeleteTextures(1, new int[]{textureId}, 0);
     }
@@ -219,7 +219,20 @@ public final class SceneRenderer {
   }
 
   /**
-   * Draws the scene with a given eye pose and type.
+   * Latches the newest video frame into the display texture, if the decoder produced one. Call
+   * this once per frame before drawing any eye. Latching inside the eye draws would let a frame
+   * that arrives between the two eyes show up in only one of them.
+   */
+  public void glUpdateVideoFrame() {
+    if (displayTexture != null && frameAvailable.compareAndSet(true, false)) {
+      displayTexture.updateTexImage();
+      checkGlError();
+    }
+  }
+
+  /**
+   * Draws the scene with a given eye pose and type. {@link #glUpdateVideoFrame()} should be called
+   * first in each frame.
    *
    * @param viewProjectionMatrix 16 element GL matrix.
    * @param eyeType an {@link com.google.vr.sdk.base.Eye.Type} value
@@ -239,11 +252,6 @@ public final class SceneRenderer {
     GLES20.glBlendFunc(GLES20.GL_SRC_ALPHA, GLES20.GL_ONE_MINUS_SRC_ALPHA);
     GLES20.glEnable(GLES20.GL_BLEND);
 
-    if (frameAvailable.compareAndSet(true, false)) {
-      displayTexture.updateTexImage();
-      checkGlError();
-    }
-
     displayMesh.glDraw(viewProjectionMatrix, eyeType);
     if (videoUiView != null) {
       canvasQuad.glDraw(viewProjectionMatrix, videoUiView.getAlpha());
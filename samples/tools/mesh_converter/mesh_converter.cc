@@ -0,0 +1,209 @@
+/*
+ * Copyright 2018 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Converts .obj files into the .mesh format described in mesh_format.h.
+//
+// Usage: mesh_converter [--half-float-uv] input.obj output.mesh
+//
+// --half-float-uv stores UVs as 16-bit floats, shrinking each vertex from 20
+// to 16 bytes. Half floats have an 11-bit mantissa, so only use this for
+// meshes whose textures are small enough for that precision.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "mesh_format.h"  // NOLINT
+#include "obj_loader.h"   // NOLINT
+
+namespace {
+
+using ndk_hello_vr::MeshFileHeader;
+using ndk_hello_vr::MeshVertex;
+using ndk_hello_vr::MeshVertexHalfUv;
+using ndk_hello_vr::ObjMesh;
+
+// Converts a float to an IEEE 754 half float, rounding to nearest even.
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127;
+  uint32_t mantissa = bits & 0x7FFFFF;
+
+  if (exponent == 128) {
+    // Infinity or NaN.
+    return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+  }
+  if (exponent > 15) {
+    // Too large; clamp to infinity.
+    return sign | 0x7C00;
+  }
+  if (exponent < -25) {
+    // Too small even for a subnormal half.
+    return sign;
+  }
+
+  int shift;
+  uint32_t half_bits;
+  if (exponent < -14) {
+    // Subnormal half: shift the implicit leading one into the mantissa.
+    mantissa |= 0x800000;
+    shift = -1 - exponent;
+    half_bits = 0;
+  } else {
+    shift = 13;
+    half_bits = static_cast<uint32_t>(exponent + 15) << 10;
+  }
+  const uint32_t round_bit = 1u << (shift - 1);
+  const uint32_t remainder = mantissa & ((1u << shift) - 1);
+  half_bits += mantissa >> shift;
+  if (remainder > round_bit || (remainder == round_bit && (half_bits & 1))) {
+    // Carrying into the exponent is the correct result here too.
+    ++half_bits;
+  }
+  return sign | static_cast<uint16_t>(half_bits);
+}
+
+uint32_t AlignUp(size_t value) {
+  const size_t alignment = ndk_hello_vr::kMeshDataAlignment;
+  return static_cast<uint32_t>((value + alignment - 1) / alignment *
+                               alignment);
+}
+
+template <typename T>
+void AppendBytes(const T* data, size_t count, std::vector<char>* out) {
+  const char* bytes = reinterpret_cast<const char*>(data);
+  out->insert(out->end(), bytes, bytes + count * sizeof(T));
+}
+
+bool Convert(const std::string& input_path, const std::string& output_path,
+             bool half_float_uv) {
+  std::ifstream input(input_path, std::ios::binary);
+  if (!input) {
+    fprintf(stderr, "Could not open %s\n", input_path.c_str());
+    return false;
+  }
+  const std::string contents((std::istreambuf_iterator<char>(input)),
+                             std::istreambuf_iterator<char>());
+
+  ObjMesh mesh;
+  std::string error;
+  if (!ndk_hello_vr::ParseObj(contents.data(), contents.size(),
+                              /*keep_normals=*/false, &mesh, &error)) {
+    fprintf(stderr, "Failed to parse %s: %s\n", input_path.c_str(),
+            error.c_str());
+    return false;
+  }
+
+  const size_t vertex_count = mesh.GetVertexCount();
+  const bool has_uv = !mesh.uvs.empty();
+  MeshFileHeader header = {};
+  header.magic = ndk_hello_vr::kMeshFileMagic;
+  header.version = ndk_hello_vr::kMeshFileVersion;
+  header.flags = 0;
+  if (half_float_uv) header.flags |= ndk_hello_vr::kMeshFlagHalfFloatUv;
+  if (vertex_count > 0x10000) {
+    header.flags |= ndk_hello_vr::kMeshFlag32BitIndices;
+  }
+  header.vertex_count = static_cast<uint32_t>(vertex_count);
+  header.index_count = static_cast<uint32_t>(mesh.indices.size());
+  header.vertex_stride =
+      static_cast<uint32_t>(ndk_hello_vr::GetMeshVertexStride(header.flags));
+  header.vertex_data_offset = AlignUp(sizeof(MeshFileHeader));
+  header.index_data_offset = AlignUp(header.vertex_data_offset +
+                                     vertex_count * header.vertex_stride);
+
+  for (int axis = 0; axis < 3; ++axis) {
+    header.bounds_min[axis] = vertex_count ? INFINITY : 0.0f;
+    header.bounds_max[axis] = vertex_count ? -INFINITY : 0.0f;
+  }
+  for (size_t i = 0; i < vertex_count; ++i) {
+    for (int axis = 0; axis < 3; ++axis) {
+      const float value = mesh.positions[i * 3 + axis];
+      header.bounds_min[axis] = std::fmin(header.bounds_min[axis], value);
+      header.bounds_max[axis] = std::fmax(header.bounds_max[axis], value);
+    }
+  }
+
+  std::vector<char> file;
+  AppendBytes(&header, 1, &file);
+  file.resize(header.vertex_data_offset, 0);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    const float u = has_uv ? mesh.uvs[i * 2] : 0.0f;
+    const float v = has_uv ? mesh.uvs[i * 2 + 1] : 0.0f;
+    if (half_float_uv) {
+      MeshVertexHalfUv vertex;
+      memcpy(vertex.position, &mesh.positions[i * 3], sizeof(vertex.position));
+      vertex.uv[0] = FloatToHalf(u);
+      vertex.uv[1] = FloatToHalf(v);
+      AppendBytes(&vertex, 1, &file);
+    } else {
+      MeshVertex vertex;
+      memcpy(vertex.position, &mesh.positions[i * 3], sizeof(vertex.position));
+      vertex.uv[0] = u;
+      vertex.uv[1] = v;
+      AppendBytes(&vertex, 1, &file);
+    }
+  }
+  file.resize(header.index_data_offset, 0);
+  if (header.flags & ndk_hello_vr::kMeshFlag32BitIndices) {
+    AppendBytes(mesh.indices.data(), mesh.indices.size(), &file);
+  } else {
+    const std::vector<uint16_t> short_indices(mesh.indices.begin(),
+                                              mesh.indices.end());
+    AppendBytes(short_indices.data(), short_indices.size(), &file);
+  }
+
+  if (!ndk_hello_vr::IsValidMeshFileHeader(header, file.size())) {
+    fprintf(stderr, "Internal error: generated an invalid header\n");
+    return false;
+  }
+
+  std::ofstream output(output_path, std::ios::binary);
+  output.write(file.data(), file.size());
+  if (!output) {
+    fprintf(stderr, "Could not write %s\n", output_path.c_str());
+    return false;
+  }
+  printf("%s: %zu vertices, %zu triangles, %zu bytes\n", output_path.c_str(),
+         vertex_count, mesh.indices.size() / 3, file.size());
+  return true;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  bool half_float_uv = false;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--half-float-uv") == 0) {
+      half_float_uv = true;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2) {
+    fprintf(stderr, "Usage: %s [--half-float-uv] input.obj output.mesh\n",
+            argv[0]);
+    return 2;
+  }
+  return Convert(paths[0], paths[1], half_float_uv) ? 0 : 1;
+}